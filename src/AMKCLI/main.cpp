@@ -10,6 +10,8 @@
 
 #include "SPCEnvironment.h"
 #include "ROMEnvironment.h"
+#include "CompileServer.h"
+#include "SongWatcher.h"
 
 namespace fs = std::filesystem;
 
@@ -39,7 +41,14 @@ int main (int argc, char** argv)
 	
 	options.add_options("SPC generation")
 		("m,mml", "Compile a MML file into SPC (can be set multiple times).", cxxopts::value<std::vector<std::string>>(), "<mml>")
-		("visualize", "Plot local song memory usage", cxxopts::value<bool>()->default_value("false"));
+		("archive", "Bundle every generated SPC into a single ZIP file", cxxopts::value<std::string>(), "<zip>")
+		("pack", "Store every generated SPC in a deduplicated SPC pack", cxxopts::value<std::string>(), "<pack>")
+		("expand_pack", "Expand the SPC files of a pack into the output folder", cxxopts::value<std::string>(), "<pack>")
+		("render_wav", "Also render this many seconds of every song into a WAV file", cxxopts::value<unsigned int>()->default_value("0"), "<seconds>")
+		("profile_driver", "Measure the driver's CPU load over this many seconds of every song", cxxopts::value<unsigned int>()->default_value("0"), "<seconds>")
+		("visualize", "Plot local song memory usage", cxxopts::value<bool>()->default_value("false"))
+		("watch", "Keep recompiling the MML files to SPC whenever they, their samples or the lists change", cxxopts::value<bool>()->default_value("false"))
+		("serve", "Keep the lists, samples and driver loaded and compile songs sent to this Unix socket", cxxopts::value<std::string>(), "<socket>");
 
 	options.add_options("ROM patching")
 		("r,rom", "Super Mario World ROM to be patched", cxxopts::value<std::string>(), "<path>")
@@ -49,13 +58,16 @@ int main (int argc, char** argv)
 
 	options.add_options("Advanced")
 		("d,driver", "Custom SPC driver folder", cxxopts::value<std::string>(), "<path>")
+		("sample_cache", "Cache parsed BRR samples in this file between builds", cxxopts::value<std::string>(), "<path>")
+		("time_report", "Time every build phase, write a Chrome trace to this file and a summary next to it", cxxopts::value<std::string>(), "<json>")
 		("aggressive", "Aggressive ROM space finding", cxxopts::value<bool>()->default_value("false"))
 		("bankopt_off", "Turn off bank optimizations", cxxopts::value<bool>()->default_value("false"))
 		("echocheck_off", "Turn off echo buffer bounds checking", cxxopts::value<bool>()->default_value("false"))
 		("dupcheck_off", "Turn off sample duplicate checking", cxxopts::value<bool>()->default_value("false"))
 		("sampleopt_off", "Turn off sample usage optimizations", cxxopts::value<bool>()->default_value("false"))
 		("hexvalid_off", "Turn off hex command validation", cxxopts::value<bool>()->default_value("false"))
-		("sa1_off", "Turn off SA1 addressing", cxxopts::value<bool>()->default_value("false"));
+		("sa1_off", "Turn off SA1 addressing", cxxopts::value<bool>()->default_value("false"))
+		("j,jobs", "Worker threads used to dump SPCs (0 = one per CPU thread)", cxxopts::value<unsigned int>()->default_value("0"), "<n>");
 
 	options.add_options("Template extraction")
 		("extract_lists", "Extract AMK lists template to a certain folder", cxxopts::value<std::string>(), "<path>")
@@ -105,6 +117,19 @@ int main (int argc, char** argv)
 	if (argp.count("extract_lists") || argp.count("extract_driver"))
 		exit(0);
 
+	// ==== SPC pack expansion ====
+	if (argp.count("expand_pack"))
+	{
+		fs::path pack_location = fs::path(argp["expand_pack"].as<std::string>());
+		fs::path output = (argp.count("output")) ? fs::path(argp["output"].as<std::string>()) : fs::current_path();
+
+		AddMusic::SPCPackReader pack (pack_location);
+		pack.expandAll(output);
+
+		std::cout << pack.size() << " SPC files were expanded at " << fs::absolute(output).string() << std::endl;
+		exit(0);
+	}
+
 	// ==== Advanced options ====
 	// Parsing the custom driver folder, if any.
 	if (argp.count("driver"))
@@ -121,6 +146,18 @@ int main (int argc, char** argv)
 	o.spc_options.optimizeSampleUsage = !argp["sampleopt_off"].as<bool>();
 	o.spc_options.validateHex = 		!argp["hexvalid_off"].as<bool>();
 	o.spc_options.allowSA1 = 			!argp["sa1_off"].as<bool>();
+	o.spc_options.jobs = 				argp["jobs"].as<unsigned int>();
+	o.spc_options.renderSeconds = 		argp["render_wav"].as<unsigned int>();
+	o.spc_options.profileSeconds = 		argp["profile_driver"].as<unsigned int>();
+	o.spc_options.visualize = 			argp["visualize"].as<bool>();
+	if (argp.count("sample_cache"))
+		o.spc_options.sampleCachePath = fs::path(argp["sample_cache"].as<std::string>());
+	if (argp.count("time_report"))
+		o.spc_options.timeReportPath = 	fs::path(argp["time_report"].as<std::string>());
+	if (argp.count("archive"))
+		o.spc_options.spcArchive = 		fs::path(argp["archive"].as<std::string>());
+	if (argp.count("pack"))
+		o.spc_options.spcPack = 		fs::path(argp["pack"].as<std::string>());
 
 	// Y/n prompt. Exits if "N" is answered.
 	auto prompt = [argp](const std::string& msg)
@@ -174,6 +211,17 @@ int main (int argc, char** argv)
 		exit(0);
 	}
 
+	// ==== Compile server ====
+	if (argp.count("serve"))
+	{
+		fs::path list_folder = (argp.count("list_folder")) ? fs::path(argp["list_folder"].as<std::string>()) : ".";
+
+		// Keeps running until a client sends SHUTDOWN. See CompileServer.h for the protocol.
+		AddMusic::CompileServer server (list_folder, o.spc_options);
+		server.serve(fs::path(argp["serve"].as<std::string>()));
+		exit(0);
+	}
+
 	// ==== MML compilation ====
 	if (argp.count("mml"))
 	{
@@ -194,6 +242,14 @@ int main (int argc, char** argv)
 			mml_paths.push_back(fs::path(mml_i));
 		}
 
+		// Keeps running until the process is stopped.
+		if (argp["watch"].as<bool>())
+		{
+			AddMusic::SongWatcher watcher (list_folder, mml_paths, output, o.spc_options);
+			watcher.watch();
+			exit(0);
+		}
+
 		// Instance a SPCEnvironment and make it work.
 		AddMusic::SPCEnvironment spc_env (list_folder, o.spc_options);
 		spc_env.generateSPCFiles(mml_paths, output);
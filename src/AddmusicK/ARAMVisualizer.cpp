@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <lodepng.h>
+
+#include "ARAMVisualizer.h"
+
+using namespace AddMusic;
+
+// Colors of the map, as listed in the readme.
+static constexpr uint8_t VARIABLES_COLOR[3] {0xFF, 0x00, 0x00};
+static constexpr uint8_t DRIVER_COLOR[3] {0xFF, 0xFF, 0x00};
+static constexpr uint8_t SONG_COLOR[3] {0x00, 0x80, 0x00};
+static constexpr uint8_t SAMPLE_TABLE_COLOR[3] {0x80, 0xFF, 0x80};
+static constexpr uint8_t ECHO_COLOR[3] {0x80, 0x00, 0x80};
+
+size_t ARAMVisualizer::pixelOf(int address)
+{
+	const int strip = address / (WIDTH * STRIP_HEIGHT);
+	const int column = (address / STRIP_HEIGHT) % WIDTH;
+	const int row = strip * STRIP_HEIGHT + address % STRIP_HEIGHT;
+	return row * WIDTH + column;
+}
+
+void ARAMVisualizer::_fill(std::vector<uint8_t>& image, int start, int end, const uint8_t color[3])
+{
+	start = std::max(start, 0);
+	end = std::min(end, 0x10000);
+	for (int address = start; address < end; address++)
+		std::copy_n(color, 3, image.begin() + pixelOf(address) * 3);
+}
+
+std::vector<uint8_t> ARAMVisualizer::render(const SpaceInfo& space, int programPos)
+{
+	std::vector<uint8_t> image (WIDTH * HEIGHT * 3, 0);
+
+	_fill(image, 0, programPos, VARIABLES_COLOR);
+	_fill(image, programPos, space.songStartPos, DRIVER_COLOR);
+	_fill(image, space.songStartPos, space.songEndPos, SONG_COLOR);
+	_fill(image, space.sampleTableStartPos, space.sampleTableEndPos, SAMPLE_TABLE_COLOR);
+
+	for (size_t i = 0; i < space.individualSampleStartPositions.size(); i++)
+	{
+		// Every other sample is a shade darker, so neighbours can be told apart.
+		const uint8_t shade = (i % 2) ? 0xA0 : 0xFF;
+		const uint8_t important[3] {0x00, shade, shade};
+		const uint8_t optional[3] {0x00, 0x00, shade};
+		_fill(image, space.individualSampleStartPositions[i], space.individualSampleEndPositions[i], space.individialSampleIsImportant[i] ? important : optional);
+	}
+
+	_fill(image, space.echoBufferStartPos, space.echoBufferEndPos, ECHO_COLOR);
+	return image;
+}
+
+void ARAMVisualizer::write(const fs::path& pngFile, const std::vector<uint8_t>& image)
+{
+	unsigned int error = lodepng::encode(pngFile.string(), image, WIDTH, HEIGHT, LCT_RGB);
+	if (error)
+		throw std::runtime_error("Could not write " + pngFile.string() + ": " + lodepng_error_text(error));
+}
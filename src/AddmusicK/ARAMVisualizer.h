@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "CompiledSong.h"
+
+namespace AddMusic
+{
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Draws how a local song fills the 64 KB of ARAM, as the -visualize
+ * option of the original AddmusicK did.
+ *
+ * Every byte is a pixel. ARAM is cut into 16 strips of 4 KB stacked from top
+ * to bottom, and each strip is 256 columns of 16 consecutive bytes, so the
+ * image is 256x256 pixels. Colors:
+ * - Red: variables, below the driver.
+ * - Yellow: driver code and data, global songs included.
+ * - Dark green: song data.
+ * - Light green: sample table (SRCN table).
+ * - Cyan: important samples. Blue: optional ones. The shade changes from
+ *   one sample to the next.
+ * - Purple: echo buffer.
+ * - Black: unused.
+ */
+class ARAMVisualizer
+{
+public:
+	static constexpr unsigned int WIDTH {256};
+	static constexpr unsigned int HEIGHT {256};
+	static constexpr unsigned int STRIP_HEIGHT {16};		// Bytes per column.
+
+	/**
+	 * @brief RGB pixels of the map of a linked local song. programPos is
+	 * where the driver program starts in ARAM.
+	 */
+	static std::vector<uint8_t> render(const SpaceInfo& space, int programPos);
+
+	/**
+	 * @brief Writes an image from render() as a PNG file.
+	 */
+	static void write(const fs::path& pngFile, const std::vector<uint8_t>& image);
+
+	/**
+	 * @brief Index of the pixel that shows an ARAM address.
+	 */
+	static size_t pixelOf(int address);
+
+private:
+	static void _fill(std::vector<uint8_t>& image, int start, int end, const uint8_t color[3]);
+};
+
+}
@@ -4,8 +4,10 @@
 #include <stdexcept>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
 
 namespace AddMusic {
 class MMLBase;
@@ -130,6 +132,16 @@ public:
 		getInstance()._verbosity_level = Levels::LEVEL_HIGHEST;
 	}
 
+	/**
+	 * Also appends every warning printed from now on to messages, until called
+	 * again with nullptr. Errors are not collected, as they are thrown anyway.
+	 */
+	static void capture(std::vector<std::string>* messages)
+	{
+		std::lock_guard<std::mutex> lock(getInstance()._print_mutex);
+		getInstance()._captured = messages;
+	}
+
 	// Different messaging levels. Designed for parser outputs to be referenced
 	// only by passing the "this" keyword, and the logger will print the file
 	// name and line.
@@ -154,6 +166,8 @@ private:
 	bool _show_level = true;
 	Levels _exception_level = Levels::ERROR;	// Minimum error level that will throw an exception.
 	Levels _verbosity_level = Levels::INFO;		// Minimum error level that will be printed.
+	std::mutex _print_mutex;					// Keeps lines printed from worker threads from interleaving.
+	std::vector<std::string>* _captured {nullptr};	// Where capture() collects warnings, if anywhere.
 
 	/**
 	 * Internal method that formats and prints the message or throw exceptions,
@@ -189,7 +203,12 @@ private:
 
 		// Print the message if it applies.
 		if (((int)lv >= (int)_vb_level) && ((int)lv < (int)_exc_level))
+		{
+			std::lock_guard<std::mutex> lock(getInstance()._print_mutex);
 			std::cerr << level_str << msg << std::endl;
+			if (getInstance()._captured && (int)lv >= (int)Levels::WARNING)
+				getInstance()._captured->push_back(level_str + msg);
+		}
 		
 		// Throw an exception if it applies.
 		if ((int)lv >= (int)_exc_level)
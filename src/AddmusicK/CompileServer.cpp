@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "AddmusicLogging.h"
+#include "CompileServer.h"
+
+using namespace AddMusic;
+
+/**
+ * Formats a response: its header line, one message per line and the SPC.
+ */
+static std::string response(bool ok, const std::vector<std::string>& messages, const std::vector<uint8_t>& SPC = {})
+{
+	std::string out = ok ? "OK " + std::to_string(SPC.size()) + " " : "ERROR ";
+	out += std::to_string(messages.size()) + "\n";
+	for (std::string message : messages)
+	{
+		std::replace(message.begin(), message.end(), '\n', ' ');
+		out += message + "\n";
+	}
+	out.append(SPC.begin(), SPC.end());
+	return out;
+}
+
+CompileServer::CompileServer(const fs::path& work_dir, EnvironmentOptions opts) :
+	work_dir(work_dir),
+	options(opts)
+{
+	_reload();
+}
+
+void CompileServer::_reload()
+{
+	// Only one environment can have the driver extracted at a time.
+	spc.reset();
+	spc = std::make_unique<SPCEnvironment>(work_dir, options);
+	spc->prepare();
+}
+
+std::string CompileServer::_compile(const fs::path& mmlFile, const std::string* text)
+{
+	std::vector<std::string> messages;
+	Logging::capture(&messages);
+	try
+	{
+		std::vector<uint8_t> SPC = spc->compileSPC(mmlFile, text);
+		Logging::capture(nullptr);
+		return response(true, messages, SPC);
+	}
+	catch (const std::exception& e)
+	{
+		Logging::capture(nullptr);
+		messages.push_back(e.what());
+		return response(false, messages);
+	}
+}
+
+std::string CompileServer::handle(const std::string& request, const std::function<std::string(size_t)>& readBytes, bool& stop)
+{
+	closeConnection = false;
+	const size_t space = request.find(' ');
+	const std::string command = request.substr(0, space);
+	const std::string argument = (space == std::string::npos) ? "" : request.substr(space + 1);
+
+	if (command == "PING")
+		return response(true, {});
+
+	if (command == "SHUTDOWN")
+	{
+		stop = true;
+		return response(true, {});
+	}
+
+	if (command == "RELOAD")
+	{
+		try
+		{
+			_reload();
+			return response(true, {});
+		}
+		catch (const std::exception& e)
+		{
+			return response(false, {e.what()});
+		}
+	}
+
+	if (command == "COMPILE" && !argument.empty())
+		return _compile(fs::absolute(argument), nullptr);
+
+	if (command == "COMPILE_TEXT")
+	{
+		// The MML follows the request line.
+		const size_t pathStart = argument.find(' ');
+		size_t length = 0;
+		try
+		{
+			length = std::stoul(argument.substr(0, pathStart));
+		}
+		catch (const std::exception&)
+		{
+			// Without a length, the MML that follows can't be told apart from the next request.
+			closeConnection = true;
+			return response(false, {"COMPILE_TEXT needs the length of the MML and a path."});
+		}
+
+		const std::string text = readBytes(length);
+		if (text.size() != length)
+			return response(false, {"The connection was closed before the whole MML was sent."});
+		if (pathStart == std::string::npos)
+			return response(false, {"COMPILE_TEXT needs the length of the MML and a path."});
+		return _compile(fs::absolute(argument.substr(pathStart + 1)), &text);
+	}
+
+	return response(false, {"Unknown request: " + request});
+}
+
+#ifdef _WIN32
+
+void CompileServer::serve(const fs::path& socketPath)
+{
+	throw std::runtime_error("The compile server needs Unix domain sockets, which this build does not support.");
+}
+
+#else
+
+void CompileServer::serve(const fs::path& socketPath)
+{
+	sockaddr_un address {};
+	address.sun_family = AF_UNIX;
+	if (socketPath.string().size() >= sizeof(address.sun_path))
+		throw std::runtime_error("The socket path " + socketPath.string() + " is too long.");
+	std::copy_n(socketPath.string().c_str(), socketPath.string().size() + 1, address.sun_path);
+
+	// A client hanging up must not take the server down with it.
+	std::signal(SIGPIPE, SIG_IGN);
+
+	// Only a socket left behind by an earlier server may be replaced, never a user's file.
+	if (fs::exists(fs::symlink_status(socketPath)))
+	{
+		if (!fs::is_socket(fs::symlink_status(socketPath)))
+			throw std::runtime_error(socketPath.string() + " already exists and is not a socket.");
+		fs::remove(socketPath);
+	}
+
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0 || bind(server, (sockaddr*)&address, sizeof(address)) != 0 || listen(server, 4) != 0)
+	{
+		if (server >= 0)
+			close(server);
+		throw std::runtime_error("Could not listen on " + socketPath.string() + ".");
+	}
+	Logging::info("Compiling songs sent to " + socketPath.string());
+
+	bool stop = false;
+	while (!stop)
+	{
+		int client = accept(server, nullptr, nullptr);
+		if (client < 0)
+			continue;
+
+		std::string pending;
+		auto receive = [&]()
+		{
+			char chunk[4096];
+			ssize_t received = read(client, chunk, sizeof(chunk));
+			if (received <= 0)
+				return false;
+			pending.append(chunk, received);
+			return true;
+		};
+		auto readBytes = [&](size_t length)
+		{
+			while (pending.size() < length && receive());
+			std::string bytes = pending.substr(0, length);
+			pending.erase(0, bytes.size());
+			return bytes;
+		};
+
+		while (!stop)
+		{
+			size_t end;
+			while ((end = pending.find('\n')) == std::string::npos && receive());
+			if (end == std::string::npos)
+				break;
+
+			std::string request = pending.substr(0, end);
+			pending.erase(0, end + 1);
+			if (!request.empty() && request.back() == '\r')
+				request.pop_back();
+			if (request.empty())
+				continue;
+
+			const std::string answer = handle(request, readBytes, stop);
+			size_t sent = 0;
+			while (sent < answer.size())
+			{
+				ssize_t written = write(client, answer.data() + sent, answer.size() - sent);
+				if (written <= 0)
+					break;
+				sent += written;
+			}
+			if (closeConnection)
+				break;
+		}
+		close(client);
+	}
+
+	close(server);
+	fs::remove(socketPath);
+}
+
+#endif
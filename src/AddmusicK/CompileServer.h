@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SPCEnvironment.h"
+
+namespace AddMusic
+{
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Keeps an SPCEnvironment prepared (lists, samples, driver, SFX and
+ * global songs) and compiles songs sent to it over a Unix domain socket, so
+ * that editors and previews don't pay for all that on every song.
+ *
+ * A client sends requests one after the other on a connection, and gets one
+ * response per request:
+ *
+ *	COMPILE <path>\n						Compiles the MML file at path.
+ *	COMPILE_TEXT <length> <path>\n<MML>	Compiles length bytes of MML. path names
+ *										the song, and its sample paths are
+ *										relative to it as if it was saved there.
+ *	RELOAD\n								Prepares the environment again, after
+ *										the lists, samples or driver changed.
+ *	PING\n
+ *	SHUTDOWN\n							Stops the server after answering.
+ *
+ *	OK <SPC size> <message count>\n<messages, one per line><SPC>
+ *	ERROR <message count>\n<messages, one per line>
+ *
+ * Messages are the warnings of the request, and the error that stopped it.
+ * PING, RELOAD and SHUTDOWN answer with an empty SPC. Requests are served one
+ * at a time, as the environment is not thread-safe.
+ */
+class CompileServer
+{
+public:
+	/**
+	 * @brief Prepares an environment for work_dir.
+	 */
+	CompileServer(const fs::path& work_dir, EnvironmentOptions opts = EnvironmentOptions());
+
+	/**
+	 * @brief Listens on socketPath until a client sends SHUTDOWN. A socket
+	 * left at socketPath is replaced, anything else there is an error. The
+	 * socket file is removed afterwards.
+	 */
+	void serve(const fs::path& socketPath);
+
+	/**
+	 * @brief Runs one request line, reading what follows it through
+	 * readBytes, and returns the response. Sets stop on SHUTDOWN.
+	 */
+	std::string handle(const std::string& request, const std::function<std::string(size_t)>& readBytes, bool& stop);
+
+	/**
+	 * @brief Whether the connection of the last request must be closed after
+	 * its response, as what follows the request could not be read.
+	 */
+	bool closesConnection() const { return closeConnection; }
+
+private:
+	std::string _compile(const fs::path& mmlFile, const std::string* text);
+	void _reload();
+
+	fs::path work_dir;
+	EnvironmentOptions options;
+	std::unique_ptr<SPCEnvironment> spc;
+	bool closeConnection {false};			// Set by handle() when the rest of the connection can't be trusted.
+};
+
+}
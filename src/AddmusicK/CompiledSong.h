@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "SongObject.h"
+
+namespace AddMusic
+{
+namespace fs = std::filesystem;
+
+struct SpaceInfo
+{
+	int songStartPos;
+	int songEndPos;
+	int sampleTableStartPos;
+	int sampleTableEndPos;
+	std::vector<int> individualSampleStartPositions;
+	std::vector<int> individualSampleEndPositions;
+	std::vector<bool> individialSampleIsImportant;
+	int importantSampleCount;
+	int echoBufferEndPos;
+	int echoBufferStartPos;
+};
+
+/**
+ * @brief Sizes and lengths a song is known by once compiled, as in its stats
+ * file. ARAM positions are only known after linking (see SpaceInfo).
+ */
+struct SongStats
+{
+	int channelSizes[9] {0};							// Channels 0 to 7 and the loop data, in bytes.
+	int pointersAndInstrumentsSize {0};
+	int samplesSize {0};								// Including the song's entries in the SRCN table.
+	int echoSize {0};
+	double channelTicks[8] {0};
+	bool knowsLength {false};
+	double introSeconds {0};
+	double mainSeconds {0};
+};
+
+/**
+ * @brief What is left of a song once its MML has been compiled: the song
+ * object, its samples, the SPC header info and its stats. It holds no parser
+ * state, so the Music instance that produced it can be dropped right away.
+ * Songs are only ever moved around, never copied.
+ */
+struct CompiledSong
+{
+	CompiledSong() = default;
+	CompiledSong(CompiledSong&&) = default;
+	CompiledSong& operator=(CompiledSong&&) = default;
+	CompiledSong(const CompiledSong&) = delete;
+	CompiledSong& operator=(const CompiledSong&) = delete;
+
+	// Defined by the song lists.
+	bool exists {false};
+	fs::path name;										// Source MML file.
+	std::string pathlessSongName;
+
+	// Output of the compilation.
+	int index {0};										// Song number.
+	SongObject object;									// Pointers, instruments and channel data, ready to be linked.
+	std::vector<unsigned short> mySamples;				// Samples used, in SRCN order.
+	int totalSize {0};
+	int minSize {0};									// Size the song is padded out to, or 0.
+	int echoBufferSize {0};
+	bool hasYoshiDrums {false};
+	std::string statStr;								// Printable stats.
+	SongStats stats;
+
+	// SPC header info
+	std::string title;
+	std::string author;
+	std::string game;
+	std::string comment;
+	unsigned int seconds {0};
+
+	// Defined when the song is linked.
+	int posInARAM {0};
+	std::vector<uint8_t> finalData;						// Linked song data, as uploaded to ARAM.
+	std::vector<int> sampleAddresses;					// ARAM address of each sample, in SRCN order. Only with resident samples.
+	SpaceInfo spaceInfo;
+};
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace AddMusic
+{
+namespace fs = std::filesystem;
+
+/**
+ * @brief Everything an SPCEnvironment would otherwise read from its work
+ * directory, held in memory: the three lists, the MML of songs and sound
+ * effects, and BRR and BNK files.
+ *
+ * Files are keyed by their path relative to the work directory, as the lists
+ * and songs refer to them: "music/song.txt", "1DF9/jump.txt",
+ * "samples/default/00 SMW @0.brr". A file missing here is still looked up
+ * on disk.
+ */
+struct InMemoryProject
+{
+	std::string songList;								// Contents of Addmusic_list.txt.
+	std::string sampleGroups;							// Contents of Addmusic_sample groups.txt.
+	std::string soundEffects;							// Contents of Addmusic_sound effects.txt.
+
+	std::map<fs::path, std::string> texts;				// Songs and sound effects.
+	std::map<fs::path, std::vector<uint8_t>> binaries;	// Samples and sample banks.
+};
+
+}
@@ -215,6 +215,31 @@ void Music::compile(SPCEnvironment* spc_)
 	pointersFirstPass();
 }
 
+CompiledSong Music::release()
+{
+	CompiledSong song;
+	song.exists = true;
+	song.name = name;
+	song.index = index;
+
+	song.object = std::move(object);
+	song.mySamples = std::move(mySamples);
+	song.totalSize = totalSize;
+	song.minSize = minSize;
+	song.echoBufferSize = echoBufferSize;
+	song.hasYoshiDrums = hasYoshiDrums;
+	song.statStr = std::move(statStr);
+	song.stats = stats;
+
+	song.title = std::move(title);
+	song.author = std::move(author);
+	song.game = std::move(game);
+	song.comment = std::move(comment);
+	song.seconds = seconds;
+
+	return song;
+}
+
 bool Music::doReplacement()
 {
 	static int r = 0;
@@ -2750,6 +2775,34 @@ bool sortTempoPair(const std::pair<double, int> &p1, const std::pair<double, int
 	return p1.first < p2.first;
 }
 
+void Music::spliceChannel(int ch, size_t at, std::initializer_list<uint8_t> bytes)
+{
+	// Splices recorded later at the same offset go first, as if each one was inserted into the data right away.
+	auto it = std::find_if(channelSplices.begin(), channelSplices.end(), [&](const ChannelSplice& splice)
+	{
+		return splice.channel > ch || (splice.channel == ch && splice.at >= at);
+	});
+	channelSplices.insert(it, ChannelSplice {ch, at, bytes});
+}
+
+size_t Music::channelSize(int ch) const
+{
+	size_t size = data[ch].size();
+	for (const ChannelSplice& splice : channelSplices)
+		if (splice.channel == ch)
+			size += splice.bytes.size();
+	return size;
+}
+
+size_t Music::channelOffset(int ch, size_t offset) const
+{
+	size_t spliced = offset;
+	for (const ChannelSplice& splice : channelSplices)
+		if (splice.channel == ch && splice.at <= offset)
+			spliced += splice.bytes.size();
+	return spliced;
+}
+
 void Music::pointersFirstPass()
 {
 	if (errorCount)
@@ -2760,49 +2813,30 @@ void Music::pointersFirstPass()
 
 	if (resizedChannel != -1)
 	{
-		int z = 0;
+		// These commands are only spliced into the channel when the song object is built, so the
+		// channel data is never shifted and the offsets recorded while parsing stay valid.
 		if (targetAMKVersion > 1)
-		{
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0x01);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0x06);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0xFA);
-			z += 3;
-		}
+			spliceChannel(resizedChannel, 0, {0xFA, 0x06, 0x01});
 		if (targetAMKVersion == 1)
-		{
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0x02);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0x7F);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0xFA);
-			z += 3;
-		}
+			spliceChannel(resizedChannel, 0, {0xFA, 0x7F, 0x02});
 		else if (songTargetProgram == 1)
-		{
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0x04);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0x7F);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0xFA);
-			z += 3;
-		}
+			spliceChannel(resizedChannel, 0, {0xFA, 0x7F, 0x04});
 		else if (songTargetProgram == 2)
-		{
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0x05);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0x7F);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0xFA);
-			z += 3;
-		}
+			spliceChannel(resizedChannel, 0, {0xFA, 0x7F, 0x05});
+
 		if (echoBufferSize > 0 || !echoBufferAllocVCMDIsSet || hasEchoBufferCommand) {
 			//Just put the VCMD in its default place: no need to move it around.
 			//In particular, the $F1 command means that echo writes have been enabled, meaning the special case is irrelevant.
-			data[resizedChannel].insert(data[resizedChannel].begin(), echoBufferSize);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0x04);
-			data[resizedChannel].insert(data[resizedChannel].begin(), 0xFA);
-			z += 3;
+			spliceChannel(resizedChannel, 0, {0xFA, 0x04, (uint8_t)echoBufferSize});
 		}
 		else
 		{
 			//Generate the echo buffer allocation command after the hot patch VCMD, but before all echo VCMDs and notes.
-			data[echoBufferAllocVCMDChannel].insert(data[echoBufferAllocVCMDChannel].begin()+echoBufferAllocVCMDLoc+3, echoBufferSize);
-			data[echoBufferAllocVCMDChannel].insert(data[echoBufferAllocVCMDChannel].begin()+echoBufferAllocVCMDLoc+3, 0x04);
-			data[echoBufferAllocVCMDChannel].insert(data[echoBufferAllocVCMDChannel].begin()+echoBufferAllocVCMDLoc+3, 0xFA);
+			//This goes straight into the channel data, three bytes past the marked location once the commands
+			//above are in front of it, and every pointer of the channel moves with it: songs have always been
+			//laid out this way, so it stays that way.
+			size_t inFront = channelSize(echoBufferAllocVCMDChannel) - data[echoBufferAllocVCMDChannel].size();
+			data[echoBufferAllocVCMDChannel].insert(data[echoBufferAllocVCMDChannel].begin()+echoBufferAllocVCMDLoc+3-inFront, {0xFA, 0x04, (uint8_t)echoBufferSize});
 			//The channel this command is inserted into gets its pointers recalibrated.
 			for (int a = 0; a < loopLocations[echoBufferAllocVCMDChannel].size(); a++) {
 				loopLocations[echoBufferAllocVCMDChannel][a] += 3;
@@ -2811,20 +2845,11 @@ void Music::pointersFirstPass()
 				phrasePointers[echoBufferAllocVCMDChannel][a] += 3;
 			}
 		}
-		//All pointers that were previously output must be recalibrated for the channel.
-		//This specifically involves phrase pointers, loop locations and remote gain positions.
-		//Why isn't this done sooner? Because we don't know whether some of these are even going to be in there in the first place.
-		for (int a = 0; a < loopLocations[resizedChannel].size(); a++) {
-			loopLocations[resizedChannel][a] += z;
-		}
-		for (int a = 0; a <= 1; a++) {
-			phrasePointers[resizedChannel][a] += z;
-		}
 	}
 
 	for (int z = 0; z < 8; z++)
 	{
-		if (data[z].size() != 0)
+		if (channelSize(z) != 0)
 		{
 			channel = z;
 			append(0);
@@ -2860,31 +2885,31 @@ void Music::pointersFirstPass()
 
 	pos = 0;	// Pos no longer means text file position.
 
-	if (data[0].size()) phrasePointers[0][0] = 0;
-	pos = data[0].size();
+	if (channelSize(0)) phrasePointers[0][0] = 0;
+	pos = channelSize(0);
 
-	if (data[1].size()) phrasePointers[1][0] = pos;
-	pos += data[1].size();
+	if (channelSize(1)) phrasePointers[1][0] = pos;
+	pos += channelSize(1);
 
-	if (data[2].size()) phrasePointers[2][0] = pos;
-	pos += data[2].size();
+	if (channelSize(2)) phrasePointers[2][0] = pos;
+	pos += channelSize(2);
 
-	if (data[3].size()) phrasePointers[3][0] = pos;
-	pos += data[3].size();
+	if (channelSize(3)) phrasePointers[3][0] = pos;
+	pos += channelSize(3);
 
-	if (data[4].size()) phrasePointers[4][0] = pos;
-	pos += data[4].size();
+	if (channelSize(4)) phrasePointers[4][0] = pos;
+	pos += channelSize(4);
 
-	if (data[5].size()) phrasePointers[5][0] = pos;
-	pos += data[5].size();
+	if (channelSize(5)) phrasePointers[5][0] = pos;
+	pos += channelSize(5);
 
-	if (data[6].size()) phrasePointers[6][0] = pos;
-	pos += data[6].size();
+	if (channelSize(6)) phrasePointers[6][0] = pos;
+	pos += channelSize(6);
 
-	if (data[7].size()) phrasePointers[7][0] = pos;
+	if (channelSize(7)) phrasePointers[7][0] = pos;
 
 	for (i = 0; i < 8; i++)
-		phrasePointers[i][1] += phrasePointers[i][0];
+		phrasePointers[i][1] = channelOffset(i, phrasePointers[i][1]) + phrasePointers[i][0];
 
 	playOnce = doesntLoop;
 
@@ -2897,83 +2922,73 @@ void Music::pointersFirstPass()
 
 	spaceForPointersAndInstrs += instrumentData.size();
 
-	allPointersAndInstrs.resize(spaceForPointersAndInstrs);// = alloc(spaceForPointersAndInstrs);
-	//for (i = 0; i < spaceForPointers; i++) allPointers[i] = 0x55;
+	// The song is emitted as a relocatable object: its pointers are offsets from the start of
+	// the song, each with a relocation, so the song can be linked at any ARAM position later on.
+	object = SongObject();
+	object.code.resize(spaceForPointersAndInstrs);
 
 	int add = (hasIntro ? 2 : 0) + (doesntLoop ? 0 : 2) + 4;
 
-	//memcpy(allPointersAndInstrs.data() + add, instrumentData.base, instrumentData.size());
-	for (i = 0; i < instrumentData.size(); i++)
-		allPointersAndInstrs[i + add] = instrumentData[i];
+	std::copy(instrumentData.begin(), instrumentData.end(), object.code.begin() + add);
 
-	allPointersAndInstrs[0] = (add + instrumentData.size()) & 0xFF;
-	allPointersAndInstrs[1] = ((add + instrumentData.size()) >> 8) & 0xFF;
+	object.setPointer(0, add + instrumentData.size());
+	if (hasIntro)
+		object.setPointer(2, add + instrumentData.size() + 16);
 
 	if (doesntLoop)
 	{
-		allPointersAndInstrs[add - 2] = 0xFF;	// Will be re-evaluated to 0000 when the pointers are adjusted later.
-		allPointersAndInstrs[add - 1] = 0xFF;
+		object.setWord(add - 2, 0x0000);	// End of the song.
 	}
 	else
 	{
-		allPointersAndInstrs[add - 4] = 0xFE;	// Will be re-evaluated to FF00 when the pointers are adjusted later.
-		allPointersAndInstrs[add - 3] = 0xFF;
-		if (hasIntro)
-		{
-			allPointersAndInstrs[add - 2] = 0xFD;	// Will be re-evaluated to 0002 + ARAMPos when the pointers are adjusted later.
-			allPointersAndInstrs[add - 1] = 0xFF;
-		}
-		else
-		{
-			allPointersAndInstrs[add - 2] = 0xFC;	// Will be re-evaluated to ARAMPos when the pointers are adjusted later.
-			allPointersAndInstrs[add - 1] = 0xFF;
-		}
+		object.setWord(add - 4, 0x00FF);	// Jump back to the main loop, which is the second phrase if there is an intro.
+		object.setPointer(add - 2, hasIntro ? 2 : 0);
 	}
-	if (hasIntro)
+
+	object.symbols["instruments"] = add;
+	add += instrumentData.size();
+	object.symbols["phrases"] = add;
+
+	for (int part = 0; part < (hasIntro ? 2 : 1); part++)
 	{
-		allPointersAndInstrs[2] = (add + instrumentData.size() + 16) & 0xFF;
-		allPointersAndInstrs[3] = (add + instrumentData.size() + 16) >> 8;
+		for (int c = 0; c < 8; c++)
+		{
+			if (channelSize(c) != 0)
+				object.setPointer(add + part * 16 + c * 2, phrasePointers[c][part] + spaceForPointersAndInstrs);
+			else
+				object.setWord(add + part * 16 + c * 2, 0x0000);
+		}
 	}
 
-	add += instrumentData.size();
-	allPointersAndInstrs[0 + add] = data[0].size() != 0 ? (phrasePointers[0][0] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-	allPointersAndInstrs[1 + add] = data[0].size() != 0 ? (phrasePointers[0][0] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-	allPointersAndInstrs[2 + add] = data[1].size() != 0 ? (phrasePointers[1][0] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-	allPointersAndInstrs[3 + add] = data[1].size() != 0 ? (phrasePointers[1][0] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-	allPointersAndInstrs[4 + add] = data[2].size() != 0 ? (phrasePointers[2][0] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-	allPointersAndInstrs[5 + add] = data[2].size() != 0 ? (phrasePointers[2][0] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-	allPointersAndInstrs[6 + add] = data[3].size() != 0 ? (phrasePointers[3][0] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-	allPointersAndInstrs[7 + add] = data[3].size() != 0 ? (phrasePointers[3][0] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-	allPointersAndInstrs[8 + add] = data[4].size() != 0 ? (phrasePointers[4][0] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-	allPointersAndInstrs[9 + add] = data[4].size() != 0 ? (phrasePointers[4][0] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-	allPointersAndInstrs[10 + add] = data[5].size() != 0 ? (phrasePointers[5][0] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-	allPointersAndInstrs[11 + add] = data[5].size() != 0 ? (phrasePointers[5][0] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-	allPointersAndInstrs[12 + add] = data[6].size() != 0 ? (phrasePointers[6][0] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-	allPointersAndInstrs[13 + add] = data[6].size() != 0 ? (phrasePointers[6][0] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-	allPointersAndInstrs[14 + add] = data[7].size() != 0 ? (phrasePointers[7][0] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-	allPointersAndInstrs[15 + add] = data[7].size() != 0 ? (phrasePointers[7][0] + spaceForPointersAndInstrs) >> 8 : 0xFF;
+	// Channel data goes right after, with the loop data last. Loop pointers are offsets into the loop data.
+	int loopDataPos = spaceForPointersAndInstrs;
+	for (int c = 0; c < 8; c++)
+		loopDataPos += channelSize(c);
 
-	if (hasIntro)
+	for (int c = 0; c < 9; c++)
 	{
-		allPointersAndInstrs[16 + add] = data[0].size() != 0 ? (phrasePointers[0][1] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-		allPointersAndInstrs[17 + add] = data[0].size() != 0 ? (phrasePointers[0][1] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-		allPointersAndInstrs[18 + add] = data[1].size() != 0 ? (phrasePointers[1][1] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-		allPointersAndInstrs[19 + add] = data[1].size() != 0 ? (phrasePointers[1][1] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-		allPointersAndInstrs[20 + add] = data[2].size() != 0 ? (phrasePointers[2][1] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-		allPointersAndInstrs[21 + add] = data[2].size() != 0 ? (phrasePointers[2][1] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-		allPointersAndInstrs[22 + add] = data[3].size() != 0 ? (phrasePointers[3][1] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-		allPointersAndInstrs[23 + add] = data[3].size() != 0 ? (phrasePointers[3][1] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-		allPointersAndInstrs[24 + add] = data[4].size() != 0 ? (phrasePointers[4][1] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-		allPointersAndInstrs[25 + add] = data[4].size() != 0 ? (phrasePointers[4][1] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-		allPointersAndInstrs[26 + add] = data[5].size() != 0 ? (phrasePointers[5][1] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-		allPointersAndInstrs[27 + add] = data[5].size() != 0 ? (phrasePointers[5][1] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-		allPointersAndInstrs[28 + add] = data[6].size() != 0 ? (phrasePointers[6][1] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-		allPointersAndInstrs[29 + add] = data[6].size() != 0 ? (phrasePointers[6][1] + spaceForPointersAndInstrs) >> 8 : 0xFF;
-		allPointersAndInstrs[30 + add] = data[7].size() != 0 ? (phrasePointers[7][1] + spaceForPointersAndInstrs) & 0xFF : 0xFB;
-		allPointersAndInstrs[31 + add] = data[7].size() != 0 ? (phrasePointers[7][1] + spaceForPointersAndInstrs) >> 8 : 0xFF;
+		size_t channelPos = object.code.size();
+		if (c == 8)
+			object.symbols["loopData"] = channelPos;
+		else if (channelSize(c) != 0)
+			object.symbols["channel" + std::to_string(c)] = channelPos;
+
+		size_t copied = 0;
+		for (const ChannelSplice& splice : channelSplices)
+		{
+			if (splice.channel != c)
+				continue;
+			object.code.insert(object.code.end(), data[c].begin() + copied, data[c].begin() + splice.at);
+			object.code.insert(object.code.end(), splice.bytes.begin(), splice.bytes.end());
+			copied = splice.at;
+		}
+		object.code.insert(object.code.end(), data[c].begin() + copied, data[c].end());
+
+		for (unsigned short location : loopLocations[c])
+			object.setPointer(channelPos + channelOffset(c, location), (data[c][location] | (data[c][location + 1] << 8)) + loopDataPos);
 	}
 
-	totalSize = data[0].size() + data[1].size() + data[2].size() + data[3].size() + data[4].size() + data[5].size() + data[6].size() + data[7].size() + data[8].size() + spaceForPointersAndInstrs;
+	totalSize = channelSize(0) + channelSize(1) + channelSize(2) + channelSize(3) + channelSize(4) + channelSize(5) + channelSize(6) + channelSize(7) + channelSize(8) + spaceForPointersAndInstrs;
 
 
 
@@ -3051,7 +3066,7 @@ void Music::pointersFirstPass()
 	//{
 	if (spc->options.verbose)
 	{
-		printf("\t#0: 0x%03X #1: 0x%03X #2: 0x%03X #3: 0x%03X Ptrs+Instrs: 0x%03X\n\t#4: 0x%03X #5: 0x%03X #6: 0x%03X #7: 0x%03X Loop:        0x%03X \n", (unsigned int)data[0].size(), (unsigned int)data[1].size(), (unsigned int)data[2].size(), (unsigned int)data[3].size(), spaceForPointersAndInstrs, (unsigned int)data[4].size(), (unsigned int)data[5].size(), (unsigned int)data[6].size(), (unsigned int)data[7].size(), (unsigned int)data[8].size());
+		printf("\t#0: 0x%03X #1: 0x%03X #2: 0x%03X #3: 0x%03X Ptrs+Instrs: 0x%03X\n\t#4: 0x%03X #5: 0x%03X #6: 0x%03X #7: 0x%03X Loop:        0x%03X \n", (unsigned int)channelSize(0), (unsigned int)channelSize(1), (unsigned int)channelSize(2), (unsigned int)channelSize(3), spaceForPointersAndInstrs, (unsigned int)channelSize(4), (unsigned int)channelSize(5), (unsigned int)channelSize(6), (unsigned int)channelSize(7), (unsigned int)channelSize(8));
 
 		printf("Space used by echo: 0x%04X bytes.  Space used by samples: 0x%04X bytes.\n\n", echoBufferSize << 11, spaceUsedBySamples);
 	}
@@ -3059,21 +3074,32 @@ void Music::pointersFirstPass()
 	if (totalSize > minSize && minSize > 0)
 		std::cout << "File " << name << ", line " << line << ": Warning: Song was larger than it could pad out by 0x" << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << totalSize - minSize << " bytes." << std::dec << std::endl;
 
+	for (int ch = 0; ch < 9; ch++)
+		stats.channelSizes[ch] = channelSize(ch);
+	for (int ch = 0; ch < 8; ch++)
+		stats.channelTicks[ch] = channelLengths[ch];
+	stats.pointersAndInstrumentsSize = spaceForPointersAndInstrs;
+	stats.samplesSize = spaceUsedBySamples;
+	stats.echoSize = echoBufferSize << 11;
+	stats.knowsLength = knowsLength;
+	stats.introSeconds = introSeconds;
+	stats.mainSeconds = mainSeconds;
+
 	std::stringstream statStrStream;
 
-	statStrStream << "CHANNEL 0 SIZE:				0x" << hex4 << data[0].size() << "\n";
-	statStrStream << "CHANNEL 1 SIZE:				0x" << hex4 << data[1].size() << "\n";
-	statStrStream << "CHANNEL 2 SIZE:				0x" << hex4 << data[2].size() << "\n";
-	statStrStream << "CHANNEL 3 SIZE:				0x" << hex4 << data[3].size() << "\n";
-	statStrStream << "CHANNEL 4 SIZE:				0x" << hex4 << data[4].size() << "\n";
-	statStrStream << "CHANNEL 5 SIZE:				0x" << hex4 << data[5].size() << "\n";
-	statStrStream << "CHANNEL 6 SIZE:				0x" << hex4 << data[6].size() << "\n";
-	statStrStream << "CHANNEL 7 SIZE:				0x" << hex4 << data[7].size() << "\n";
-	statStrStream << "LOOP DATA SIZE:				0x" << hex4 << data[8].size() << "\n";
+	statStrStream << "CHANNEL 0 SIZE:				0x" << hex4 << channelSize(0) << "\n";
+	statStrStream << "CHANNEL 1 SIZE:				0x" << hex4 << channelSize(1) << "\n";
+	statStrStream << "CHANNEL 2 SIZE:				0x" << hex4 << channelSize(2) << "\n";
+	statStrStream << "CHANNEL 3 SIZE:				0x" << hex4 << channelSize(3) << "\n";
+	statStrStream << "CHANNEL 4 SIZE:				0x" << hex4 << channelSize(4) << "\n";
+	statStrStream << "CHANNEL 5 SIZE:				0x" << hex4 << channelSize(5) << "\n";
+	statStrStream << "CHANNEL 6 SIZE:				0x" << hex4 << channelSize(6) << "\n";
+	statStrStream << "CHANNEL 7 SIZE:				0x" << hex4 << channelSize(7) << "\n";
+	statStrStream << "LOOP DATA SIZE:				0x" << hex4 << channelSize(8) << "\n";
 	statStrStream << "POINTERS AND INSTRUMENTS SIZE:		0x" << hex4 << spaceForPointersAndInstrs << "\n";
 	statStrStream << "SAMPLES SIZE:				0x" << hex4 << spaceUsedBySamples << "\n";
 	statStrStream << "ECHO SIZE:				0x" << hex4 << (echoBufferSize << 11) << "\n";
-	statStrStream << "SONG TOTAL DATA SIZE:			0x" << hex4 << data[0].size() + data[1].size() + data[2].size() + data[3].size() + data[4].size() + data[5].size() + data[6].size() + data[7].size() + data[8].size() + spaceForPointersAndInstrs << "\n";
+	statStrStream << "SONG TOTAL DATA SIZE:			0x" << hex4 << channelSize(0) + channelSize(1) + channelSize(2) + channelSize(3) + channelSize(4) + channelSize(5) + channelSize(6) + channelSize(7) + channelSize(8) + spaceForPointersAndInstrs << "\n";
 	if (index > spc->highestGlobalSong)
 		statStrStream << "FREE ARAM (APPROXIMATE):		0x" << hex4 << 0x10000 - (echoBufferSize << 11) - spaceUsedBySamples - totalSize - spc->programUploadPos << "\n\n";
 	else
@@ -3474,7 +3500,7 @@ fs::path Music::_resolvePath(const fs::path &fileName)
 	for (auto& b_i : basedir_alternatives)
 	{
 		actualPath = b_i / fileName;
-		if (fs::exists(actualPath))
+		if (spc->_fileExists(actualPath))
 			return actualPath;
 	}
 
@@ -3484,11 +3510,31 @@ fs::path Music::_resolvePath(const fs::path &fileName)
 
 void Music::addSample(const fs::path &fileName, bool important)
 {
-	std::vector<uint8_t> sample_data;
 	fs::path actualPath = _resolvePath(fileName);
 
-	readBinaryFile(actualPath, sample_data);
+	// Samples already parsed in this build or a previous one don't need to be read again.
+	// Those of an in-memory project are read from memory, and have no file to stamp a cache entry with.
+	const bool cacheable = !spc->_inProject(actualPath);
+	const std::vector<SampleCache::CachedSample>* cached = cacheable ? spc->sampleCache.find(actualPath) : nullptr;
+	if (cached != nullptr && cached->size() == 1)
+	{
+		addSample(cached->front().data, actualPath.string(), important, true, cached->front().loopPoint);
+		return;
+	}
+
+	std::vector<uint8_t> sample_data;
+	spc->_readBinaryFile(actualPath, sample_data);
 	addSample(sample_data, actualPath.string(), important, false);
+
+	// The sample was validated by now.
+	SampleCache::CachedSample parsed;
+	if (sample_data.size() != 0)
+	{
+		parsed.loopPoint = (sample_data[1] << 8) | (sample_data[0]);
+		parsed.data.assign(sample_data.begin() + 2, sample_data.end());
+	}
+	if (cacheable)
+		spc->sampleCache.store(actualPath, {parsed});
 }
 
 void Music::addSample(const std::vector<uint8_t> &sample, const std::string &name, bool important, bool noLoopHeader, int loopPoint, bool isBNK)
@@ -3553,7 +3599,7 @@ void Music::addSample(const std::vector<uint8_t> &sample, const std::string &nam
 				for (int j = 0; j < spc->bankDefines[i]->samples.size(); j++)
 				{
 					fs::path p2 = "./samples/"+*(spc->bankDefines[i]->samples[j]);
-					if (fs::equivalent(p1, p2))
+					if (spc->_sameFile(p1, p2))
 					{
 						//Copy the important flag from the sample group definition.
 						newSample.important = spc->bankDefines[i]->importants[j];
@@ -3597,51 +3643,68 @@ int bankSampleCount = 0;			// Used to give unique names to sample bank brrs.
 
 void Music::addSampleBank(const fs::path &fileName)
 {
-	std::vector<uint8_t> bankFile;
 	fs::path actualPath = _resolvePath(fileName);
 
-	readBinaryFile(actualPath, bankFile);
-
-	if (bankFile.size() != 0x8000)
-		Logging::error("The specified bank file w` an illegal size.", this);
-	bankFile.erase(bankFile.begin(), bankFile.begin() + 12);
-	//Sample bankSamples[0x40];
-	Sample tempSample;
-	int currentSample = 0;
-	for (currentSample = 0; currentSample < 0x40; currentSample++)
+	std::vector<SampleCache::CachedSample> bankSamples;
+	const bool cacheable = !spc->_inProject(actualPath);
+	const std::vector<SampleCache::CachedSample>* cached = cacheable ? spc->sampleCache.find(actualPath) : nullptr;
+	if (cached != nullptr)
+		bankSamples = *cached;
+	else
 	{
-		unsigned short startPosition = bankFile[currentSample * 4 + 0] | (bankFile[currentSample * 4 + 1] << 8);
-		tempSample.loopPoint = (bankFile[currentSample * 4 + 2] | bankFile[currentSample * 4 + 3] << 8) - startPosition;
-		tempSample.data.clear();
-
-		if (startPosition == 0 && tempSample.loopPoint == 0)
-		{
-			addSample("EMPTY.brr", true);
-			continue;
-		}
-
-		startPosition -= 0x8000;
+		std::vector<uint8_t> bankFile;
+		spc->_readBinaryFile(actualPath, bankFile);
 
-		int pos = startPosition;
+		if (bankFile.size() != 0x8000)
+			Logging::error("The specified bank file w` an illegal size.", this);
+		bankFile.erase(bankFile.begin(), bankFile.begin() + 12);
 
-		while (pos < bankFile.size())
+		bankSamples.resize(0x40);
+		for (int currentSample = 0; currentSample < 0x40; currentSample++)
 		{
-			for (int i = 0; i < 9; i++)
+			SampleCache::CachedSample& tempSample = bankSamples[currentSample];
+			unsigned short startPosition = bankFile[currentSample * 4 + 0] | (bankFile[currentSample * 4 + 1] << 8);
+			tempSample.loopPoint = (bankFile[currentSample * 4 + 2] | bankFile[currentSample * 4 + 3] << 8) - startPosition;
+
+			if (startPosition == 0 && tempSample.loopPoint == 0)
 			{
-				tempSample.data.push_back(bankFile[pos]);
-				pos++;
+				tempSample.empty = true;
+				continue;
 			}
 
-			if ((tempSample.data[tempSample.data.size() - 9] & 1) == 1)
+			startPosition -= 0x8000;
+
+			int pos = startPosition;
+
+			while (pos < bankFile.size())
 			{
-				break;
+				for (int i = 0; i < 9; i++)
+				{
+					tempSample.data.push_back(bankFile[pos]);
+					pos++;
+				}
+
+				if ((tempSample.data[tempSample.data.size() - 9] & 1) == 1)
+				{
+					break;
+				}
 			}
 		}
+		if (cacheable)
+			spc->sampleCache.store(actualPath, bankSamples);
+	}
+
+	for (const SampleCache::CachedSample& tempSample : bankSamples)
+	{
+		if (tempSample.empty)
+		{
+			addSample("EMPTY.brr", true);
+			continue;
+		}
 
 		char temp[20];
 		sprintf(temp, "__SRCNBANKBRR%04X", bankSampleCount++);
-		tempSample.name = temp;
-		addSample(tempSample.data, tempSample.name, true, true, tempSample.loopPoint, true);
+		addSample(tempSample.data, temp, true, true, tempSample.loopPoint, true);
 	}
 }
 
@@ -3655,7 +3718,7 @@ int Music::getSample(const fs::path &sp_path)
 	while (it != spc->sampleToIndex.end())
 	{
 		fs::path p2 = it->first;
-		if (fs::equivalent(p1, p2))
+		if (spc->_sameFile(p1, p2))
 			return it->second;
 
 		//if ((std::string)it->first == (std::string)ftemp)
@@ -7,6 +7,7 @@
 #include <initializer_list>
 
 #include "MMLBase.h"
+#include "CompiledSong.h"
 
 namespace AddMusic
 {
@@ -32,20 +33,6 @@ struct Sample
 	bool isBNK {false}; 	// Samples generated from a BNK file have specific checks omitted from it due to using an auto-generated name.
 };
 
-struct SpaceInfo
-{
-	int songStartPos;
-	int songEndPos;
-	int sampleTableStartPos;
-	int sampleTableEndPos;
-	std::vector<int> individualSampleStartPositions;
-	std::vector<int> individualSampleEndPositions;
-	std::vector<bool> individialSampleIsImportant;
-	int importantSampleCount;
-	int echoBufferEndPos;
-	int echoBufferStartPos;
-};
-
 class Music : public MMLBase
 {
 	friend class SPCEnvironment;
@@ -56,6 +43,12 @@ public:
 
 	void compile(SPCEnvironment* spc_);
 
+	/**
+	 * @brief Moves the result of compile() out of the parser, which can be
+	 * discarded afterwards.
+	 */
+	CompiledSong release();
+
 private:
 	// =======================================================================
 	// PRIVATE ATTRIBUTES
@@ -68,7 +61,6 @@ private:
 	bool playOnce 					{false};
 	int totalSize 					{0};
 	int spaceForPointersAndInstrs 	{0};
-	bool exists 					{false};
 	int echoBufferSize 				{0};
 	bool hasEchoBufferCommand 		{false};
 	bool echoBufferAllocVCMDIsSet 	{false};
@@ -78,17 +70,27 @@ private:
 	bool hasYoshiDrums 				{false};
 	bool guessLength 				{true};
 
-	double introSeconds;
-	double mainSeconds;
+	double introSeconds 			{0};				// Stays 0 if the song has no intro.
+	double mainSeconds 				{0};
 
 	int tempoRatio					{1};
 	bool nextHexIsArpeggioNoteLength {false};
 
-	std::string pathlessSongName;
 	fs::path basepath;
 
 	std::vector<uint8_t> data[9];
 	std::vector<unsigned short> loopLocations[9];	// With remote loops, we can have remote loops in standard loops, so we need that ninth channel.
+
+	// Bytes the song needs in a channel that weren't parsed from it, such as the $FA hot patch and
+	// echo allocation VCMDs. They are spliced in when the song object is built, so neither the
+	// channel data nor the offsets recorded while parsing have to be shifted.
+	struct ChannelSplice
+	{
+		int channel;
+		size_t at;									// Offset into data[channel] the bytes go in front of.
+		std::vector<uint8_t> bytes;
+	};
+	std::vector<ChannelSplice> channelSplices;		// Sorted by channel and offset.
 	
 	// SPC header info
 	std::string title;
@@ -98,11 +100,8 @@ private:
 	
 	unsigned short loopPointers[0x10000];
 	
-	std::vector<uint8_t> allPointersAndInstrs;
+	SongObject object;						// Pointers, instruments and channel data, ready to be linked anywhere in ARAM.
 	std::vector<uint8_t> instrumentData;
-	std::vector<uint8_t> finalData;
-
-	SpaceInfo spaceInfo;
 
 	unsigned int introLength;
 	unsigned int mainLength;
@@ -116,10 +115,9 @@ private:
 	int echoBufferAllocVCMDChannel;						// Defined on markEchoBufferAllocVCMD
 
 	std::string statStr;								// Printable stats.
+	SongStats stats;									// The numbers behind statStr.
 
-	int minSize;										// Defined while parsing pad definition
-	
-	int posInARAM;										// Position in ARAM. Defined externally.
+	int minSize {0};									// Defined while parsing pad definition
 
 	int remoteDefinitionType 		{0};
 	bool inRemoteDefinition 		{false};
@@ -244,6 +242,10 @@ private:
 
 	int multiplyByTempoRatio(int); 		// Multiplies a value by tempoRatio. Errors out if it goes higher than 255.
 
+	void spliceChannel(int ch, size_t at, std::initializer_list<uint8_t> bytes);	// Records bytes to be spliced into data[ch] at offset at.
+	size_t channelSize(int ch) const;					// Size of a channel, splices included.
+	size_t channelOffset(int ch, size_t offset) const;	// Where an offset into data[ch] ends up once splices are in.
+
 	void pointersFirstPass();
 	void parseComment();
 	void parseQMarkDirective();
@@ -4,6 +4,8 @@
 #include "asarBinding.h"
 
 #include <AM405Remover.h>
+#include <cstring>
+#include <set>
 #include <iostream>
 
 using namespace AddMusic;
@@ -15,7 +17,10 @@ ROMEnvironment::ROMEnvironment(const fs::path& smw_rom, const fs::path& work_dir
 	bankStart = options.bankOptimizations ? 0x200000 : 0x080000;
 
 	ROMName = smw_rom;
-	readBinaryFile(ROMName, rom);
+	{
+		TimeReport::Scope scope (timeReport.get(), "load ROM");
+		readBinaryFile(ROMName, rom);
+	}
 
 	_tryToCleanAM4Data();
 	_tryToCleanAMMData();
@@ -38,8 +43,6 @@ ROMEnvironment::ROMEnvironment(const fs::path& smw_rom, const fs::path& work_dir
 
 bool ROMEnvironment::patchROM(const fs::path& patched_rom_location)
 {
-	bool visualizeSongs = false;
-
 	justSPCsPlease = false;
 	spc_build_plan = false;
 
@@ -53,38 +56,33 @@ bool ROMEnvironment::patchROM(const fs::path& patched_rom_location)
 	result &= _compileSFX();
 	result &= _compileGlobalData();
 
-	for (int i = 0; i < 256; i++)
-	{
-		// Load music file in memory.
-		if (musics[i].exists)
-			readTextFile(fs::absolute(musics[i].name), musics[i].text);
-	}
-
 	result &= _compileMusic();
-	result &= _compileMusicROMSide();
 	result &= _fixMusicPointers();
+	result &= _compileMusicROMSide();		// After the songs are placed: resident samples need their addresses.
+	_writeSongStats();
 
 	result &= _generateSPCs();
 
-	/*
-	if (visualizeSongs)
-		generatePNGs();
-	*/
+	if (result && options.visualize)
+		_generatePNGs();
 
 	result &= _assembleSNESDriverROMSide();
 
 	if (result)
 	{
+		TimeReport::Scope scope (timeReport.get(), "write ROM");
 		fs::path rom_folder = patched_rom_location.has_parent_path() ? patched_rom_location.parent_path() : ".";
 		writeBinaryFile(patched_rom_location, patched_rom);
 		generateMSC(rom_folder / (patched_rom_location.stem().string() + ".msc"));
 	}
 
+	_writeTimeReport();
 	return true;
 }
 
 bool ROMEnvironment::_cleanROM()
 {
+	TimeReport::Scope scope (timeReport.get(), "clean ROM");
 	_tryToCleanSampleToolData();
 
 	if (rom[0x70000] == 0x3E && rom[0x70001] == 0x0E)	// If this is a "clean" ROM, then we don't need to do anything.
@@ -358,6 +356,7 @@ int ROMEnvironment::findFreeSpace(unsigned int size, int start, std::vector<uint
 
 bool ROMEnvironment::_assembleSNESDriverROMSide()
 {
+	TimeReport::Scope scope (timeReport.get(), "assemble ROM patch");
 	Logging::debug("Generating SNES driver...");
 
 	std::string patch;
@@ -401,7 +400,10 @@ bool ROMEnvironment::_assembleSNESDriverROMSide()
 			int freeSpace;
 			fs::path musicBinPath {driver_builddir / "SNES" / "bin" / ("music" + hex<2>(i) + ".bin")};
 			requestSize = fs::file_size(musicBinPath);
-			freeSpace = findFreeSpace(requestSize, bankStart, rom);
+			{
+				TimeReport::Scope freeSpaceScope (timeReport.get(), "find free space", musicBinPath.filename().string());
+				freeSpace = findFreeSpace(requestSize, bankStart, rom);
+			}
 			if (freeSpace == -1)
 			{
 				Logging::error("Your ROM is out of free space.");
@@ -452,7 +454,11 @@ bool ROMEnvironment::_assembleSNESDriverROMSide()
 			writeBinaryFile(filename, temp);
 
 			int requestSize = fs::file_size(filename);
-			int freeSpace = findFreeSpace(requestSize, bankStart, rom);
+			int freeSpace;
+			{
+				TimeReport::Scope freeSpaceScope (timeReport.get(), "find free space", filename.filename().string());
+				freeSpace = findFreeSpace(requestSize, bankStart, rom);
+			}
 			if (freeSpace == -1)
 			{
 				Logging::error("Error: Your ROM is out of free space.");
@@ -510,6 +516,7 @@ bool ROMEnvironment::_assembleSNESDriverROMSide()
 
 	Logging::debug("Final compilation...");
 
+	TimeReport::Scope patchScope (timeReport.get(), "final Asar patch");
 	AsarBinding asar4 (driver_builddir / "SNES" / "temppatch.asm");
 	if (!asar4.patchToRom(driver_builddir / "SNES" / "temp.sfc", true))
 	{
@@ -544,6 +551,7 @@ void ROMEnvironment::generateMSC(const fs::path& location)
 
 bool ROMEnvironment::_compileMusicROMSide()
 {
+	TimeReport::Scope scope (timeReport.get(), "list song samples");
 	// Used to be part of AddmusicK.cpp:compileMusic()
 	std::stringstream songSampleList;
 	std::string s;
@@ -578,7 +586,26 @@ bool ROMEnvironment::_compileMusicROMSide()
 
 		songSampleList << "\n" << "SGPointer" << hex2 << i << ":\n";
 
-		if (i > highestGlobalSong)
+		if (i > highestGlobalSong && residentSamples)
+		{
+			// Resident samples: each entry is the sample and its ARAM address. Bit 15 of the
+			// sample marks entries whose sample an earlier entry of the group already uploads.
+			songSampleList << "db $" << hex2 << musics[i].mySamples.size() << "\ndw";
+			std::set<std::pair<int, int>> uploaded;
+			for (unsigned int j = 0; j < musics[i].mySamples.size(); j++)
+			{
+				int sample = musics[i].mySamples[j];
+				int address = musics[i].sampleAddresses[j];
+				if (!uploaded.insert({sample, address}).second)
+					sample |= 0x8000;
+
+				songSampleListSize+=4;
+				songSampleList << " $" << hex4 << sample << ", $" << hex4 << address;
+				if (j != musics[i].mySamples.size() - 1)
+					songSampleList << ",";
+			}
+		}
+		else if (i > highestGlobalSong)
 		{
 			songSampleList << "db $" << hex2 << musics[i].mySamples.size() << "\ndw";
 			for (unsigned int j = 0; j < musics[i].mySamples.size(); j++)
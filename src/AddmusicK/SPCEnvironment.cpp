@@ -1,21 +1,38 @@
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
 
 #include "AddmusicLogging.h"
+#include "ARAMVisualizer.h"
 #include "asarBinding.h"
 #include "SPCEnvironment.h"
 #include "Utility.h"
 #include "Package.h"
+#include "SampleLayout.h"
+#include "DriverProfiler.h"
+#include "SPCEmulator.h"
+#include "SPCPack.h"
+#include "ZipArchive.h"
 
 #include <iostream>
 
 using namespace AddMusic;
 
 SPCEnvironment::SPCEnvironment(const fs::path& work_dir, EnvironmentOptions opts) :
+	SPCEnvironment(work_dir, nullptr, opts)
+{
+}
+
+SPCEnvironment::SPCEnvironment(const fs::path& work_dir, std::shared_ptr<const InMemoryProject> project, EnvironmentOptions opts) :
 	work_dir(work_dir),
 	global_samples_dir(work_dir / "samples"),
 	driver_srcdir(std::filesystem::temp_directory_path() / "amkdriver"),	// /tmp/amkdriver in Linux
-	driver_builddir(driver_srcdir)
+	driver_builddir(driver_srcdir),
+	project(std::move(project))
 {
 	options = opts;
 
@@ -52,20 +69,26 @@ SPCEnvironment::SPCEnvironment(const fs::path& work_dir, EnvironmentOptions opts
 
 	if (!options.allowSA1)
 		usingSA1 = false;
+
+	if (!options.timeReportPath.empty())
+		timeReport = std::make_unique<TimeReport>();
 	
-	// Does your work directory have these files?
-	if (!fs::exists(work_dir))
-		throw fs::filesystem_error("The directory with music has not been found", work_dir, std::error_code());
-	if (!fs::exists(work_dir / DEFAULT_SONGLIST_FILENAME))
-		throw fs::filesystem_error("The song list file was not found within the work directory.", work_dir / DEFAULT_SONGLIST_FILENAME, std::error_code());
-	if (!fs::exists(work_dir / DEFAULT_SAMPLELIST_FILENAME))
-		throw fs::filesystem_error("The sample list file was not found within the work directory.", work_dir / DEFAULT_SAMPLELIST_FILENAME, std::error_code());
-	if (!fs::exists(work_dir / DEFAULT_SFXLIST_FILENAME))
-		throw fs::filesystem_error("The SFX list file was not found within the work directory.", work_dir / DEFAULT_SFXLIST_FILENAME, std::error_code());
+	// Does your work directory have these files? A project in memory brings its own.
+	if (!this->project)
+	{
+		if (!fs::exists(work_dir))
+			throw fs::filesystem_error("The directory with music has not been found", work_dir, std::error_code());
+		if (!fs::exists(work_dir / DEFAULT_SONGLIST_FILENAME))
+			throw fs::filesystem_error("The song list file was not found within the work directory.", work_dir / DEFAULT_SONGLIST_FILENAME, std::error_code());
+		if (!fs::exists(work_dir / DEFAULT_SAMPLELIST_FILENAME))
+			throw fs::filesystem_error("The sample list file was not found within the work directory.", work_dir / DEFAULT_SAMPLELIST_FILENAME, std::error_code());
+		if (!fs::exists(work_dir / DEFAULT_SFXLIST_FILENAME))
+			throw fs::filesystem_error("The SFX list file was not found within the work directory.", work_dir / DEFAULT_SFXLIST_FILENAME, std::error_code());
+	}
 	
 	
 	// Dynamic allocation of some arrays.
-	musics = new Music[256];
+	musics.resize(256);
 	soundEffectsDF9 = new SoundEffect[256];
 	soundEffectsDFC = new SoundEffect[256];
 	soundEffects[0] = soundEffectsDF9;
@@ -76,7 +99,6 @@ SPCEnvironment::SPCEnvironment(const fs::path& work_dir, EnvironmentOptions opts
 
 SPCEnvironment::~SPCEnvironment()
 {
-	delete[] (musics);
 	delete[] (soundEffectsDF9);
 	delete[] (soundEffectsDFC);
 
@@ -86,14 +108,30 @@ SPCEnvironment::~SPCEnvironment()
 }
 
 bool SPCEnvironment::generateSPCFiles(const std::vector<fs::path>& textFilesToCompile, const fs::path& output_folder)
+{
+	_prepareBuild(textFilesToCompile, output_folder);
+
+	_compileMusic();
+	_fixMusicPointers();
+	_writeSongStats();
+
+	if (options.visualize)
+		_generatePNGs();
+
+	_generateSPCs();
+	spc_build_plan = false;
+
+	_writeTimeReport();
+	return true;
+}
+
+void SPCEnvironment::_prepareBuild(const std::vector<fs::path>& localSongs, const fs::path& output_folder)
 {
 	justSPCsPlease = true;
 	spc_output_dir = output_folder;
 	spc_build_plan = true;
 
-	loadSampleList(work_dir / DEFAULT_SAMPLELIST_FILENAME);
-	loadMusicList(work_dir / DEFAULT_SONGLIST_FILENAME);
-	loadSFXList(work_dir / DEFAULT_SFXLIST_FILENAME);
+	_loadLists();
 
 	_assembleSNESDriver();		// We need this for the upload position, where the SPC file's PC starts.  Luckily, this function is very short.
 
@@ -113,42 +151,45 @@ bool SPCEnvironment::generateSPCFiles(const std::vector<fs::path>& textFilesToCo
 		musics[i].exists = false;
 
 	// Load local songs from command-line arguments.
-	for (int i = firstLocalSong, j = 0; (i < 256) && (j < textFilesToCompile.size()); i++, j++)
+	for (int i = firstLocalSong, j = 0; (i < 256) && (j < localSongs.size()); i++, j++)
 	{
 		if (i >= 256)
 			Logging::error("Error: The total number of requested music files to compile exceeded 255.");
 		musics[i].exists = true;
-		musics[i].name = textFilesToCompile[j];
+		musics[i].name = localSongs[j];
 	}
-
-	for (int i = 0; i < 256; i++)
-	{
-		// Load music file in memory.
-		if (musics[i].exists)
-			readTextFile(fs::absolute(musics[i].name), musics[i].text);
-	}
-
-	_compileMusic();
-	_fixMusicPointers();
-
-	_generateSPCs();
-	spc_build_plan = false;
-
-	return true;
 }
 
 bool SPCEnvironment::_assembleSNESDriver()
 {
+	TimeReport::Scope scope (timeReport.get(), "assemble SNES driver");
 	std::string patch;
 	readTextFile(driver_builddir / "SNES" / "patch.asm", patch);
 	programUploadPos = scanInt(patch, "!DefARAMRet = ");
 
+	// Resident samples change the format of the sample groups, so the tool has to follow the driver.
+	std::string userDefines;
+	readTextFile(driver_builddir / "UserDefines.asm", userDefines);
+	std::istringstream defines (userDefines);
+	std::regex residentDefine (R"(^\s*!ResidentSamples\s*=\s*(\S+))");
+	residentSamples = false;
+	for (std::string line; std::getline(defines, line);)
+	{
+		line = line.substr(0, line.find(';'));
+		std::smatch define;
+		if (std::regex_search(line, define, residentDefine))
+			residentSamples = define[1] == "!true";
+	}
+	if (residentSamples)
+		Logging::debug("!ResidentSamples is enabled: samples get fixed ARAM addresses.");
+
 	return true;
 }
 
 // Equivalent to assembleSPCDriver()
 bool SPCEnvironment::_assembleSPCDriver()
 {
+	TimeReport::Scope scope (timeReport.get(), "assemble SPC driver");
 	std::string patch;
 	readTextFile(driver_builddir / "main.asm", patch);
 	programPos = scanInt(patch, "base ");
@@ -172,6 +213,19 @@ bool SPCEnvironment::_assembleSPCDriver()
 	noSFX = (firstpass_stdout.find("NoSFX is enabled") != -1);
 	programSize = firstpass.getProgramSize();
 
+	// Instructions that read the tables appended to the driver, so they can be linked
+	// later without assembling main.asm again.
+	driverProgram = firstpass.getCompiledBin();
+	driverLabels = firstpass.getLabels();
+	driverRelocations.clear();
+	std::regex relocPattern (R"(Reloc(\w+): \$([A-Fa-f0-9]+))");
+	for (auto it = std::sregex_iterator(firstpass_stdout.begin(), firstpass_stdout.end(), relocPattern); it != std::sregex_iterator(); ++it)
+		driverRelocations.emplace((*it)[1].str(), std::strtoul((*it)[2].str().c_str(), NULL, 16));
+
+	driverLinkable = driverRelocations.count("SongPointers") > 0 && (noSFX || driverRelocations.count("SFXTable1") > 0);
+	if (!driverLinkable)
+		Logging::debug("The SPC driver does not report its relocations. It will be assembled once per stage.");
+
 	if (options.sfxDump && noSFX) {
 		Logging::warning("The sound driver build does not support sound effects due to the !noSFX flag being enabled in asm/UserDefines.asm, yet you requested to dump SFX. There will be no new SPC dumps of the sound effects since the data is not included by default, nor is the playback code for the sound effects.");
 		options.sfxDump = false;
@@ -183,6 +237,7 @@ bool SPCEnvironment::_assembleSPCDriver()
 
 bool SPCEnvironment::_compileSFX()
 {
+	TimeReport::Scope scope (timeReport.get(), "link SFX pointers");
 	for (int i = 0; i < 2; i++)
 	{
 		for (int j = 1; j < 256; j++)
@@ -212,8 +267,90 @@ bool SPCEnvironment::_compileSFX()
 	return true;
 }
 
+bool SPCEnvironment::_assembleSFX(int sfxDataPos)
+{
+	TimeReport::Scope scope (timeReport.get(), "assemble SFX");
+	std::vector<SoundEffect*> compiled;
+	bool hasASM = false;
+	for (int bank = 0; bank < 2; bank++)
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			SoundEffect& sfx = soundEffects[bank][i];
+			if (sfx.exists && sfx.pointsTo == 0)
+			{
+				compiled.push_back(&sfx);
+				hasASM |= !sfx.asmStrings.empty();
+			}
+		}
+	}
+
+	// Without inline ASM, sound effects are just laid one after another.
+	if (!hasASM)
+	{
+		int pos = sfxDataPos;
+		for (SoundEffect* sfx : compiled)
+		{
+			sfx->posInARAM = pos;
+			pos += sfx->data.size();
+		}
+		return true;
+	}
+
+	// Otherwise every sound effect goes into a single batch, so Asar lays them out
+	// and resolves all the code blocks in one pass over the driver.
+	std::stringstream asmCode;
+	asmCode <<
+		"arch spc700-raw\n\n"
+
+		"org $000000\n"
+		"incsrc \"main.asm\"\n\n"
+
+		"org $008000\n"
+		"base $" << hex4 << sfxDataPos << std::dec << "\n\n";
+
+	for (SoundEffect* sfx : compiled)
+		sfx->writeASM(asmCode);
+
+	writeTextFile(driver_builddir / "tempsfx.asm", asmCode.str());
+	AsarBinding asar_sfx (driver_builddir / "tempsfx.asm");
+
+	Logging::debug("Assembling sound effect code.");
+
+	if (!asar_sfx.compileToBin())
+	{
+		asar_sfx.printErrors();
+		Logging::error("asar reported an error while assembling SFX binaries.");
+		return false;
+	}
+
+	const std::vector<uint8_t> bin = asar_sfx.getCompiledBin();
+	for (SoundEffect* sfx : compiled)
+		sfx->linkASM(asar_sfx, bin, 0x8000 - sfxDataPos);
+
+	return true;
+}
+
+void SPCEnvironment::_relocateDriver(const std::string& label, int assembledAt, int linkedAt)
+{
+	auto range = driverRelocations.equal_range(label);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		// The relocations point at the instruction; its 16-bit operand follows the opcode.
+		const size_t operand = it->second + 1 - programPos;
+		if (operand + 1 >= driverImage.size())
+			Logging::error("Relocation of " + label + " points outside of the SPC program.");
+
+		uint16_t value = driverImage[operand] | (driverImage[operand + 1] << 8);
+		value += linkedAt - assembledAt;
+		driverImage[operand] = value & 0xFF;
+		driverImage[operand + 1] = value >> 8;
+	}
+}
+
 bool SPCEnvironment::_compileGlobalData()
 {
+	TimeReport::Scope scope (timeReport.get(), "compile global data");
 	int DF9DataTotal = 0;
 	int DFCDataTotal = 0;
 	int DF9Count = 0;
@@ -241,13 +378,29 @@ bool SPCEnvironment::_compileGlobalData()
 		}
 	}
 
+	// Parse every sound effect, then assemble all their inline ASM at once, which
+	// also places them in ARAM.
+	const int sfxCount[2] {DF9Count, DFCCount};
+	for (int bank = 0; bank < 2; bank++)
+	{
+		for (int i = 0; i <= sfxCount[bank]; i++)
+		{
+			if (soundEffects[bank][i].exists && soundEffects[bank][i].pointsTo == 0)
+			{
+				TimeReport::Scope sfxScope (timeReport.get(), "compile SFX", soundEffects[bank][i].name.filename().string());
+				soundEffects[bank][i].compile(this);
+			}
+		}
+	}
+
+	if (!_assembleSFX(DFCCount * 2 + DF9Count * 2 + programPos + programSize))
+		return false;
+
 	for (int i = 0; i <= DF9Count; i++)
 	{
 		if (soundEffects[0][i].exists && soundEffects[0][i].pointsTo == 0)
 		{
-			soundEffects[0][i].posInARAM = DFCCount * 2 + DF9Count * 2 + programPos + programSize + DF9DataTotal;
-			soundEffects[0][i].compile(this);
-			DF9Pointers.push_back(DF9DataTotal + (DF9Count + DFCCount) * 2 + programSize + programPos);
+			DF9Pointers.push_back(soundEffects[0][i].posInARAM);
 			DF9DataTotal += soundEffects[0][i].data.size() + soundEffects[0][i].code.size();
 		}
 		else if (soundEffects[0][i].exists == false)
@@ -266,16 +419,11 @@ bool SPCEnvironment::_compileGlobalData()
 		}
 	}
 
-	// if (errorCount > 0)
-	// 	Logging::error("There were errors when compiling the sound effects.  Compilation aborted.  Your\nROM has not been modified.");
-
 	for (int i = 0; i <= DFCCount; i++)
 	{
 		if (soundEffects[1][i].exists && soundEffects[1][i].pointsTo == 0)
 		{
-			soundEffects[1][i].posInARAM = DFCCount * 2 + DF9Count * 2 + programPos + programSize + DF9DataTotal + DFCDataTotal;
-			soundEffects[1][i].compile(this);
-			DFCPointers.push_back(DFCDataTotal + DF9DataTotal + (DF9Count + DFCCount) * 2 + programSize + programPos);
+			DFCPointers.push_back(soundEffects[1][i].posInARAM);
 			DFCDataTotal += soundEffects[1][i].data.size() + soundEffects[1][i].code.size();
 		}
 		else if (soundEffects[1][i].exists == false)
@@ -305,55 +453,79 @@ bool SPCEnvironment::_compileGlobalData()
 	DF9Pointers.erase(DF9Pointers.begin(), DF9Pointers.begin() + 1);
 	DFCPointers.erase(DFCPointers.begin(), DFCPointers.begin() + 1);
 
-	writeBinaryFile(driver_builddir / "SFX1DF9Table.bin", DF9Pointers);
-	writeBinaryFile(driver_builddir / "SFX1DFCTable.bin", DFCPointers);
-
 	std::vector<uint8_t> allSFXData;
 
 	for (int i = 0; i <= DF9Count; i++)
 	{
-		for (unsigned int j = 0; j < soundEffects[0][i].data.size(); j++)
-			allSFXData.push_back(soundEffects[0][i].data[j]);
-		for (unsigned int j = 0; j < soundEffects[0][i].code.size(); j++)
-			allSFXData.push_back(soundEffects[0][i].code[j]);
+		allSFXData.insert(allSFXData.end(), soundEffects[0][i].data.begin(), soundEffects[0][i].data.end());
+		allSFXData.insert(allSFXData.end(), soundEffects[0][i].code.begin(), soundEffects[0][i].code.end());
 	}
 
 	for (int i = 0; i <= DFCCount; i++)
 	{
-		for (unsigned int j = 0; j < soundEffects[1][i].data.size(); j++)
-			allSFXData.push_back(soundEffects[1][i].data[j]);
-		for (unsigned int j = 0; j < soundEffects[1][i].code.size(); j++)
-			allSFXData.push_back(soundEffects[1][i].code[j]);
+		allSFXData.insert(allSFXData.end(), soundEffects[1][i].data.begin(), soundEffects[1][i].data.end());
+		allSFXData.insert(allSFXData.end(), soundEffects[1][i].code.begin(), soundEffects[1][i].code.end());
 	}
 
-	writeBinaryFile(driver_builddir / "SFXData.bin", allSFXData);
+	if (driverLinkable)
+	{
+		// Append the tables and data right where the first pass ended, then point the
+		// instructions that read them at their final place.
+		const int firstPassEnd = programPos + driverProgram.size();
+		driverImage = driverProgram;
 
-	std::string str;
-	readTextFile(driver_builddir / "main.asm", str);
+		if (!noSFX)
+		{
+			for (uint16_t pointer : DF9Pointers)
+				driverImage.insert(driverImage.end(), {(uint8_t)(pointer & 0xFF), (uint8_t)(pointer >> 8)});
+			const int sfxTable1 = programPos + driverImage.size();
+			for (uint16_t pointer : DFCPointers)
+				driverImage.insert(driverImage.end(), {(uint8_t)(pointer & 0xFF), (uint8_t)(pointer >> 8)});
+			driverImage.insert(driverImage.end(), allSFXData.begin(), allSFXData.end());
+
+			_relocateDriver("SFXTable0", firstPassEnd, firstPassEnd);
+			_relocateDriver("SFXTable1", firstPassEnd, sfxTable1);
+		}
+		_relocateDriver("SongPointers", firstPassEnd, programPos + driverImage.size());
 
-	int pos;
+		Logging::debug("Linked the SFX tables and data into the main SPC program.");
+		programSize = driverImage.size();
+	}
+	else
+	{
+		writeBinaryFile(driver_builddir / "SFX1DF9Table.bin", DF9Pointers);
+		writeBinaryFile(driver_builddir / "SFX1DFCTable.bin", DFCPointers);
+		writeBinaryFile(driver_builddir / "SFXData.bin", allSFXData);
 
-	pos = str.find("SFXTable0:");
-	if (pos == -1) Logging::error("Error: SFXTable0 not found in main.asm.");
-	str.insert(pos+10, "\r\nincbin \"SFX1DF9Table.bin\"\r\n");
+		std::string str;
+		readTextFile(driver_builddir / "main.asm", str);
 
-	pos = str.find("SFXTable1:");
-	if (pos == -1) Logging::error("Error: SFXTable1 not found in main.asm.");
-	str.insert(pos+10, "\r\nincbin \"SFX1DFCTable.bin\"\r\nincbin \"SFXData.bin\"\r\n");
+		int pos;
 
-	writeTextFile(driver_builddir / "tempmain.asm", str);
-	AsarBinding asar2 (driver_builddir / "tempmain.asm");
+		pos = str.find("SFXTable0:");
+		if (pos == -1) Logging::error("Error: SFXTable0 not found in main.asm.");
+		str.insert(pos+10, "\r\nincbin \"SFX1DF9Table.bin\"\r\n");
 
-	Logging::debug("Compiling main SPC program, pass 2.");
+		pos = str.find("SFXTable1:");
+		if (pos == -1) Logging::error("Error: SFXTable1 not found in main.asm.");
+		str.insert(pos+10, "\r\nincbin \"SFX1DFCTable.bin\"\r\nincbin \"SFXData.bin\"\r\n");
 
-	if (!asar2.compileToFile(driver_builddir / "main.bin"))
-	{
-		asar2.printErrors();
-		Logging::error("asar reported an error while assembling asm/main.asm. Refer to temp.log for\ndetails.\n");
-		return false;
-	}
+		writeTextFile(driver_builddir / "tempmain.asm", str);
+		tempMainSource = str;
+		AsarBinding asar2 (driver_builddir / "tempmain.asm");
+
+		Logging::debug("Compiling main SPC program, pass 2.");
 
-	programSize = asar2.getProgramSize();
+		if (!asar2.compileToFile(driver_builddir / "main.bin"))
+		{
+			asar2.printErrors();
+			Logging::error("asar reported an error while assembling asm/main.asm. Refer to temp.log for\ndetails.\n");
+			return false;
+		}
+
+		programSize = asar2.getProgramSize();
+	}
+	driverProgramSize = programSize;
 
 	std::string totalSizeStr;
 	if (noSFX) {
@@ -370,8 +542,12 @@ bool SPCEnvironment::_compileGlobalData()
 
 bool SPCEnvironment::_compileMusic()
 {
+	TimeReport::Scope scope (timeReport.get(), "compile music");
 	Logging::debug("Compiling music...");
 
+	if (!options.sampleCachePath.empty())
+		sampleCache.load(options.sampleCachePath);
+
 	int totalSamplecount = 0;
 	int totalSize = 0;
 	int maxGlobalEchoBufferSize = 0;
@@ -381,11 +557,7 @@ bool SPCEnvironment::_compileMusic()
 		{
 			//if (!(i <= highestGlobalSong && !recompileMain))
 			//{
-			musics[i].index = i;
-			if (i > highestGlobalSong) {
-				musics[i].echoBufferSize = std::max(musics[i].echoBufferSize, maxGlobalEchoBufferSize);
-			}
-			musics[i].compile(this);
+			_compileSong(i, maxGlobalEchoBufferSize);
 			if (i <= highestGlobalSong) {
 				maxGlobalEchoBufferSize = std::max(musics[i].echoBufferSize, maxGlobalEchoBufferSize);
 			}
@@ -394,100 +566,289 @@ bool SPCEnvironment::_compileMusic()
 		}
 	}
 
+	Logging::debug(std::stringstream() << "Sample cache: " << sampleCache.hits << " hit(s), " << sampleCache.misses << " miss(es).");
+	if (!options.sampleCachePath.empty())
+		sampleCache.save(options.sampleCachePath);
+
 	return true;
 }
 
+void SPCEnvironment::_compileSong(int index, int globalEchoBufferSize, const std::string* text)
+{
+	// The parser only lives while its song compiles; what is kept is the CompiledSong.
+	TimeReport::Scope scope (timeReport.get(), "compile song", musics[index].name.filename().string());
+	auto parser = std::make_unique<Music>();
+	parser->name = musics[index].name;
+	parser->index = index;
+	if (index > highestGlobalSong)
+		parser->echoBufferSize = std::max(parser->echoBufferSize, globalEchoBufferSize);
+	if (text)
+		parser->text = *text;
+	else
+		_readTextFile(fs::absolute(parser->name), parser->text);
+	parser->compile(this);
+	musics[index] = parser->release();
+}
+
+std::vector<unsigned short> SPCEnvironment::_residentSampleOrder() const
+{
+	std::vector<int> sampleSizes;
+	for (const Sample& sample : samples)
+		sampleSizes.push_back(sample.data.size());
+
+	SampleLayoutOptimizer optimizer (sampleSizes);
+	for (int i = highestGlobalSong + 1; i < 256; i++)
+		if (musics[i].exists)
+			optimizer.addSong(musics[i].mySamples);
+
+	std::vector<unsigned short> order = optimizer.optimize();
+	Logging::debug(std::stringstream() << "Resident sample layout: " << optimizer.uploadBytes(order) << " of " << optimizer.fullUploadBytes() << " sample bytes uploaded over every song change.");
+	return order;
+}
+
+void SPCEnvironment::_layoutResidentSamples(int localSongPos)
+{
+	std::vector<unsigned short> order = _residentSampleOrder();
+	std::vector<size_t> rank (samples.size(), order.size());
+	for (size_t r = 0; r < order.size(); r++)
+		rank[order[r]] = r;
+
+	// Where a song's samples would start if they were packed right after its sample table, like the SNES side does by default.
+	auto sampleTableEnd = [&](const CompiledSong& song)
+	{
+		int tablePos = localSongPos + ((song.minSize > 0) ? song.minSize : song.totalSize);
+		if ((tablePos & 0xFF) != 0) tablePos = ((tablePos >> 8) + 1) << 8;
+		return tablePos + (int)song.mySamples.size() * 4;
+	};
+
+	int commonBase = 0;
+	for (int i = highestGlobalSong + 1; i < 256; i++)
+		if (musics[i].exists)
+			commonBase = std::max(commonBase, sampleTableEnd(musics[i]));
+
+	int songsAtCommonBase = 0;
+	for (int i = highestGlobalSong + 1; i < 256; i++)
+	{
+		CompiledSong& song = musics[i];
+		if (!song.exists) continue;
+
+		// Every sample is uploaded once, even if several SRCN slots use it.
+		std::vector<unsigned short> used (song.mySamples.begin(), song.mySamples.end());
+		std::sort(used.begin(), used.end(), [&](unsigned short a, unsigned short b) { return rank[a] < rank[b]; });
+		used.erase(std::unique(used.begin(), used.end()), used.end());
+
+		int usedSize = 0;
+		for (unsigned short sample : used)
+			usedSize += samples[sample].data.size();
+
+		int base = commonBase;
+		if (base + usedSize > 0x10000 - (song.echoBufferSize << 11))
+			base = sampleTableEnd(song);		// Doesn't fit from the common base: its samples just won't be shared.
+		else
+			songsAtCommonBase++;
+
+		std::map<unsigned short, int> address;
+		for (unsigned short sample : used)
+		{
+			address[sample] = base;
+			base += samples[sample].data.size();
+		}
+
+		song.sampleAddresses.clear();
+		for (unsigned short sample : song.mySamples)
+			song.sampleAddresses.push_back(address[sample]);
+	}
+
+	Logging::debug(std::stringstream() << "Resident samples start at $" << hex4 << commonBase << std::dec << " for " << songsAtCommonBase << " local song(s).");
+	_writeSampleUploadReport();
+}
+
+void SPCEnvironment::_writeSampleUploadReport() const
+{
+	// Distinct (sample, ARAM address) placements of a song, as the SNES side checks them.
+	auto placements = [&](const CompiledSong& song)
+	{
+		std::set<std::pair<int, int>> placed;
+		for (unsigned int j = 0; j < song.mySamples.size(); j++)
+			placed.insert({song.mySamples[j], song.sampleAddresses[j]});
+		return placed;
+	};
+
+	std::stringstream report;
+	report << "Estimated sample bytes uploaded to ARAM when a local song starts after another one.\n";
+	report << "Samples left at the same address by the previous song are not uploaded again.\n";
+
+	for (int i = highestGlobalSong + 1; i < 256; i++)
+	{
+		if (!musics[i].exists) continue;
+
+		auto placed = placements(musics[i]);
+		int fullBytes = 0;
+		for (const auto& [sample, address] : placed)
+			fullBytes += samples[sample].data.size();
+
+		report << "\nSONG $" << hex2 << i << " (" << musics[i].name.stem().string() << "): 0x" << hex4 << fullBytes << " bytes in full\n";
+		for (int previous = highestGlobalSong + 1; previous < 256; previous++)
+		{
+			if (previous == i || !musics[previous].exists) continue;
+
+			auto left = placements(musics[previous]);
+			int bytes = 0;
+			for (const auto& placement : placed)
+				if (left.count(placement) == 0)
+					bytes += samples[placement.first].data.size();
+			report << "\tAFTER $" << hex2 << previous << ":\t0x" << hex4 << bytes << "\n";
+		}
+	}
+
+	if (!fs::exists(spc_output_dir / "stats"))
+		fs::create_directories(spc_output_dir / "stats");
+	writeTextFile(spc_output_dir / "stats" / "sample uploads.txt", report.str());
+}
+
+void SPCEnvironment::_writeSongStats() const
+{
+	auto range = [](int start, int end)
+	{
+		return "{\"start\": " + std::to_string(start) + ", \"end\": " + std::to_string(end) + "}";
+	};
+
+	std::stringstream json;
+	json << "{\n\t\"program\": " << range(programPos, programPos + programSize) << ",\n";
+	json << "\t\"highestGlobalSong\": " << highestGlobalSong << ",\n";
+	json << "\t\"songs\": [";
+
+	bool firstSong = true;
+	for (int i = 0; i < 256; i++)
+	{
+		const CompiledSong& song = musics[i];
+		if (!song.exists) continue;
+
+		const bool local = i > highestGlobalSong;
+		const SongStats& stats = song.stats;
+		const int paddedSize = (song.minSize > 0) ? song.minSize : song.totalSize;
+		json << (firstSong ? "\n" : ",\n") << "\t\t{\n";
+		firstSong = false;
+
+		json << "\t\t\t\"number\": " << i << ",\n";
+		json << "\t\t\t\"file\": " << jsonString(song.name.generic_string()) << ",\n";
+		json << "\t\t\t\"title\": " << jsonString(song.title) << ",\n";
+		json << "\t\t\t\"local\": " << (local ? "true" : "false") << ",\n";
+		json << "\t\t\t\"size\": " << song.totalSize << ",\n";
+		json << "\t\t\t\"paddedSize\": " << paddedSize << ",\n";
+		json << "\t\t\t\"pointersAndInstrumentsSize\": " << stats.pointersAndInstrumentsSize << ",\n";
+		json << "\t\t\t\"loopDataSize\": " << stats.channelSizes[8] << ",\n";
+		json << "\t\t\t\"channels\": [";
+		for (int ch = 0; ch < 8; ch++)
+			json << (ch ? ", " : "") << "{\"size\": " << stats.channelSizes[ch] << ", \"ticks\": " << stats.channelTicks[ch] << "}";
+		json << "],\n";
+
+		if (stats.knowsLength)
+			json << "\t\t\t\"seconds\": {\"intro\": " << stats.introSeconds << ", \"mainLoop\": " << stats.mainSeconds << ", \"total\": " << stats.introSeconds + stats.mainSeconds << "},\n";
+		else
+			json << "\t\t\t\"seconds\": null,\n";
+
+		json << "\t\t\t\"echoSize\": " << stats.echoSize << ",\n";
+		json << "\t\t\t\"samplesSize\": " << stats.samplesSize << ",\n";
+
+		// Positions of the samples are only known for local songs.
+		const SpaceInfo& space = song.spaceInfo;
+		json << "\t\t\t\"samples\": [";
+		for (size_t j = 0; j < song.mySamples.size(); j++)
+		{
+			const Sample& sample = samples[song.mySamples[j]];
+			json << (j ? ",\n" : "\n") << "\t\t\t\t{\"srcn\": " << j << ", \"name\": " << jsonString(sample.name) << ", \"size\": " << sample.data.size()
+				<< ", \"important\": " << (sample.important ? "true" : "false");
+			if (local && j < space.individualSampleStartPositions.size())
+				json << ", \"aram\": " << range(space.individualSampleStartPositions[j], space.individualSampleEndPositions[j]);
+			json << "}";
+		}
+		json << (song.mySamples.empty() ? "],\n" : "\n\t\t\t],\n");
+
+		json << "\t\t\t\"aram\": {\n";
+		json << "\t\t\t\t\"song\": " << range(song.posInARAM, song.posInARAM + paddedSize);
+		if (local)
+		{
+			// Resident samples may sit anywhere, not just right after the table.
+			int samplesStart = space.sampleTableEndPos, samplesEnd = space.sampleTableEndPos;
+			if (!space.individualSampleStartPositions.empty())
+			{
+				samplesStart = *std::min_element(space.individualSampleStartPositions.begin(), space.individualSampleStartPositions.end());
+				samplesEnd = std::max(samplesEnd, *std::max_element(space.individualSampleEndPositions.begin(), space.individualSampleEndPositions.end()));
+			}
+
+			json << ",\n\t\t\t\t\"sampleTable\": " << range(space.sampleTableStartPos, space.sampleTableEndPos);
+			json << ",\n\t\t\t\t\"samples\": " << range(samplesStart, samplesEnd);
+			json << ",\n\t\t\t\t\"echoBuffer\": " << range(space.echoBufferStartPos, space.echoBufferEndPos);
+			json << ",\n\t\t\t\t\"free\": " << space.echoBufferStartPos - samplesEnd;
+		}
+		json << "\n\t\t\t}\n\t\t}";
+	}
+	json << "\n\t]\n}\n";
+
+	if (!fs::exists(spc_output_dir / "stats"))
+		fs::create_directories(spc_output_dir / "stats");
+	writeTextFile(spc_output_dir / "stats" / "songs.json", json.str());
+}
+
+void SPCEnvironment::_generatePNGs() const
+{
+	TimeReport::Scope scope (timeReport.get(), "visualize ARAM");
+
+	const fs::path folder = spc_output_dir / "Visualizations";
+	fs::create_directories(folder);
+
+	for (int i = highestGlobalSong + 1; i < 256; i++)
+	{
+		if (!musics[i].exists) continue;
+
+		const fs::path pngFile = folder / (musics[i].name.stem().string() + ".png");
+		ARAMVisualizer::write(pngFile, ARAMVisualizer::render(musics[i].spaceInfo, programPos));
+		Logging::debug("Wrote the ARAM map of " + musics[i].name.filename().string() + " to " + pngFile.string());
+	}
+}
+
 bool SPCEnvironment::_fixMusicPointers()
 {
+	TimeReport::Scope scope (timeReport.get(), "fix music pointers");
 	Logging::debug("Fixing song pointers...");
 
-	int pointersPos = programSize + 0x400;
+	int pointersPos = driverProgramSize + 0x400;
 	std::stringstream globalPointers;
 	std::stringstream incbins;
 
-	int songDataARAMPos = programSize + programPos + highestGlobalSong * 2 + 2;
+	// Based on the driver alone, as programSize includes the global songs once they are linked.
+	int songDataARAMPos = driverProgramSize + programPos + highestGlobalSong * 2 + 2;
 	//                    size + startPos + pointer to each global song + pointer to local song.
 	//int songPointerARAMPos = programSize + programPos;
 
 	bool addedLocalPtr = false;
 
+	// What gets appended to the driver when it is linked instead of assembled again.
+	std::vector<uint8_t> linkedPointers, linkedSongs;
+
 	for (int i = 0; i < 256; i++)
 	{
 		if (musics[i].exists == false) continue;
 
 		musics[i].posInARAM = songDataARAMPos;
 
-		int untilJump = -1;
-
 		if (i <= highestGlobalSong)
 		{
 			globalPointers << "\ndw song" << hex2 << i;
 			incbins << "song" << hex2 << i << ": incbin \"" << "SNES/bin/" << "music" << hex2 << i << ".bin\"\n";
+			linkedPointers.insert(linkedPointers.end(), {(uint8_t)(songDataARAMPos & 0xFF), (uint8_t)(songDataARAMPos >> 8)});
 		}
 		else if (addedLocalPtr == false)
 		{
 			globalPointers << "\ndw localSong";
 			incbins << "localSong: ";
+			linkedPointers.insert(linkedPointers.end(), {(uint8_t)(songDataARAMPos & 0xFF), (uint8_t)(songDataARAMPos >> 8)});
 			addedLocalPtr = true;
-		}
-
-		for (int j = 0; j < musics[i].spaceForPointersAndInstrs; j+=2)
-		{
-			if (untilJump == 0)
-			{
-				j += musics[i].instrumentData.size();
-				untilJump = -1;
-			}
-
-			int temp = musics[i].allPointersAndInstrs[j] | musics[i].allPointersAndInstrs[j+1] << 8;
-
-			if (temp == 0xFFFF)		// 0xFFFF = swap with 0x0000.
-			{
-				musics[i].allPointersAndInstrs[j] = 0;
-				musics[i].allPointersAndInstrs[j+1] = 0;
-				untilJump = 1;
-			}
-			else if (temp == 0xFFFE)	// 0xFFFE = swap with 0x00FF.
-			{
-				musics[i].allPointersAndInstrs[j] = 0xFF;
-				musics[i].allPointersAndInstrs[j+1] = 0;
-				untilJump = 2;
-			}
-			else if (temp == 0xFFFD)	// 0xFFFD = swap with the song's position (its first track pointer).
-			{
-				musics[i].allPointersAndInstrs[j] = (musics[i].posInARAM + 2) & 0xFF;
-				musics[i].allPointersAndInstrs[j+1] = (musics[i].posInARAM + 2) >> 8;
-			}
-			else if (temp == 0xFFFC)	// 0xFFFC = swap with the song's position + 2 (its second track pointer).
-			{
-				musics[i].allPointersAndInstrs[j] = musics[i].posInARAM & 0xFF;
-				musics[i].allPointersAndInstrs[j+1] = musics[i].posInARAM >> 8;
-			}
-			else if (temp == 0xFFFB)	// 0xFFFB = swap with 0x0000, but don't set untilSkip.
-			{
-				musics[i].allPointersAndInstrs[j] = 0;
-				musics[i].allPointersAndInstrs[j+1] = 0;
-			}
-			else
-			{
-				temp += musics[i].posInARAM;
-				musics[i].allPointersAndInstrs[j] = temp & 0xFF;
-				musics[i].allPointersAndInstrs[j+1] = temp >> 8;
-			}
-			untilJump--;
-		}
 
-		int normalChannelsSize = musics[i].data[0].size() + musics[i].data[1].size() + musics[i].data[2].size() + musics[i].data[3].size() + musics[i].data[4].size() + musics[i].data[5].size() + musics[i].data[6].size() + musics[i].data[7].size();
-
-		for (int j = 0; j < 9; j++)
-		{
-			for (unsigned int k = 0; k < musics[i].loopLocations[j].size(); k++)
-			{
-				int temp = (musics[i].data[j][musics[i].loopLocations[j][k]] & 0xFF) | (musics[i].data[j][musics[i].loopLocations[j][k] + 1] << 8);
-				temp += musics[i].posInARAM + normalChannelsSize + musics[i].spaceForPointersAndInstrs;
-				musics[i].data[j][musics[i].loopLocations[j][k]] = temp & 0xFF;
-				musics[i].data[j][musics[i].loopLocations[j][k] + 1] = temp >> 8;
-			}
+			// Every local song goes here, so their samples can be laid out now.
+			if (residentSamples)
+				_layoutResidentSamples(songDataARAMPos);
 		}
 
 		std::vector<uint8_t> final;
@@ -515,13 +876,8 @@ bool SPCEnvironment::_fixMusicPointers()
 			final.push_back(songDataARAMPos >> 8);
 		}
 
-
-		for (unsigned int j = 0; j < musics[i].allPointersAndInstrs.size(); j++)
-			final.push_back(musics[i].allPointersAndInstrs[j]);
-
-		for (unsigned int j = 0; j < 9; j++)
-			for (unsigned int k = 0; k < musics[i].data[j].size(); k++)
-				final.push_back(musics[i].data[j][k]);
+		// Every pointer of the song is resolved by linking its object here.
+		musics[i].object.link(songDataARAMPos, final);
 
 		if (musics[i].minSize > 0 && i <= highestGlobalSong)
 			while (final.size() < musics[i].minSize)
@@ -538,104 +894,121 @@ bool SPCEnvironment::_fixMusicPointers()
 		fs::path globalinc_name (driver_builddir / "SNES" / "bin" / (std::stringstream() << "music" << hex2 << i << ".bin").str());
 		writeBinaryFile(globalinc_name, final);
 
+		if (i <= highestGlobalSong)
+			linkedSongs.insert(linkedSongs.end(), final.begin(), final.end());
+
 		if (i <= highestGlobalSong)
 		{
 			songDataARAMPos += sizeWithPadding;
 		}
 		else
 		{
-			if (options.checkEcho)
-			{
-				musics[i].spaceInfo.songStartPos = songDataARAMPos;
-				musics[i].spaceInfo.songEndPos = musics[i].spaceInfo.songStartPos + sizeWithPadding;
+			// The layout is worked out even without the echo check, for the stats.
+			musics[i].spaceInfo.songStartPos = songDataARAMPos;
+			musics[i].spaceInfo.songEndPos = musics[i].spaceInfo.songStartPos + sizeWithPadding;
 
-				int checkPos = songDataARAMPos + sizeWithPadding;
-				if ((checkPos & 0xFF) != 0) checkPos = ((checkPos >> 8) + 1) << 8;
+			int checkPos = songDataARAMPos + sizeWithPadding;
+			if ((checkPos & 0xFF) != 0) checkPos = ((checkPos >> 8) + 1) << 8;
 
-				musics[i].spaceInfo.sampleTableStartPos = checkPos;
+			musics[i].spaceInfo.sampleTableStartPos = checkPos;
 
-				checkPos += musics[i].mySamples.size() * 4;
+			checkPos += musics[i].mySamples.size() * 4;
 
-				musics[i].spaceInfo.sampleTableEndPos = checkPos;
+			musics[i].spaceInfo.sampleTableEndPos = checkPos;
 
-				int importantSampleCount = 0;
-				for (unsigned int j = 0; j < musics[i].mySamples.size(); j++)
-				{
-					auto thisSample = musics[i].mySamples[j];
-					auto thisSampleSize = samples[thisSample].data.size();
-					bool sampleIsImportant = samples[thisSample].important;
-					if (sampleIsImportant) importantSampleCount++;
+			int importantSampleCount = 0;
+			int sampleEndPos = 0;
+			for (unsigned int j = 0; j < musics[i].mySamples.size(); j++)
+			{
+				auto thisSample = musics[i].mySamples[j];
+				auto thisSampleSize = samples[thisSample].data.size();
+				bool sampleIsImportant = samples[thisSample].important;
+				if (sampleIsImportant) importantSampleCount++;
 
-					musics[i].spaceInfo.individualSampleStartPositions.push_back(checkPos);
-					musics[i].spaceInfo.individualSampleEndPositions.push_back(checkPos + thisSampleSize);
+				if (!musics[i].sampleAddresses.empty())
+				{
+					// Resident samples have their own address. They don't follow each other.
+					int sampleStartPos = musics[i].sampleAddresses[j];
+					musics[i].spaceInfo.individualSampleStartPositions.push_back(sampleStartPos);
+					musics[i].spaceInfo.individualSampleEndPositions.push_back(sampleStartPos + thisSampleSize);
 					musics[i].spaceInfo.individialSampleIsImportant.push_back(sampleIsImportant);
 
-					checkPos += thisSampleSize;
+					sampleEndPos = std::max(sampleEndPos, (int)(sampleStartPos + thisSampleSize));
+					continue;
 				}
-				musics[i].spaceInfo.importantSampleCount = importantSampleCount;
 
-				if ((checkPos & 0xFF) != 0) checkPos = ((checkPos >> 8) + 1) << 8;
+				musics[i].spaceInfo.individualSampleStartPositions.push_back(checkPos);
+				musics[i].spaceInfo.individualSampleEndPositions.push_back(checkPos + thisSampleSize);
+				musics[i].spaceInfo.individialSampleIsImportant.push_back(sampleIsImportant);
 
-				//musics[i].spaceInfo.echoBufferStartPos = checkPos;
+				checkPos += thisSampleSize;
+			}
+			checkPos = std::max(checkPos, sampleEndPos);
+			musics[i].spaceInfo.importantSampleCount = importantSampleCount;
+
+			if ((checkPos & 0xFF) != 0) checkPos = ((checkPos >> 8) + 1) << 8;
 
-				checkPos += musics[i].echoBufferSize << 11;
+			//musics[i].spaceInfo.echoBufferStartPos = checkPos;
 
-				//musics[i].spaceInfo.echoBufferEndPos = checkPos;
+			checkPos += musics[i].echoBufferSize << 11;
 
+			//musics[i].spaceInfo.echoBufferEndPos = checkPos;
+
+			musics[i].spaceInfo.echoBufferEndPos = 0x10000;
+			if (musics[i].echoBufferSize > 0)
+			{
+				musics[i].spaceInfo.echoBufferStartPos = 0x10000 - (musics[i].echoBufferSize << 11);
 				musics[i].spaceInfo.echoBufferEndPos = 0x10000;
-				if (musics[i].echoBufferSize > 0)
-				{
-					musics[i].spaceInfo.echoBufferStartPos = 0x10000 - (musics[i].echoBufferSize << 11);
-					musics[i].spaceInfo.echoBufferEndPos = 0x10000;
-				}
-				else
-				{
-					musics[i].spaceInfo.echoBufferStartPos = 0xFF00;
-					musics[i].spaceInfo.echoBufferEndPos = 0xFF04;
-				}
+			}
+			else
+			{
+				musics[i].spaceInfo.echoBufferStartPos = 0xFF00;
+				musics[i].spaceInfo.echoBufferEndPos = 0xFF04;
+			}
 
 
-				if (checkPos > 0x10000)
-				{
-					Logging::error(std::stringstream() << musics[i].name << ": Echo buffer exceeded total space in ARAM by 0x" << hex4 << checkPos - 0x10000 << " bytes." << std::dec);
-					return false;
-				}
+			if (options.checkEcho && checkPos > 0x10000)
+			{
+				Logging::error(std::stringstream() << musics[i].name << ": Echo buffer exceeded total space in ARAM by 0x" << hex4 << checkPos - 0x10000 << " bytes." << std::dec);
+				return false;
 			}
 		}
 	}
 
-	//if (recompileMain)
-	//{
-	std::string patch;
-	readTextFile(driver_builddir / "tempmain.asm", patch);
-
-	patch += globalPointers.str() + "\n" + incbins.str();
+	std::vector<uint8_t> program;
+	if (driverLinkable)
+	{
+		// The song pointers go right where SongPointers was linked, followed by the global songs.
+		program = driverImage;
+		program.insert(program.end(), linkedPointers.begin(), linkedPointers.end());
+		program.insert(program.end(), linkedSongs.begin(), linkedSongs.end());
+		Logging::debug("Linked the global songs into the main SPC program.");
+	}
+	else
+	{
+		// From a clean copy every time, as the song labels can only be defined once.
+		std::string patch = tempMainSource;
+		patch += globalPointers.str() + "\n" + incbins.str();
 
-	writeTextFile(driver_builddir / "tempmain.asm", patch);
+		writeTextFile(driver_builddir / "tempmain.asm", patch);
 
-	Logging::debug("Compiling main SPC program, final pass.");
+		Logging::debug("Compiling main SPC program, final pass.");
 
-	AsarBinding asar3 (driver_builddir / "tempmain.asm");
-	if (!asar3.compileToFile(driver_builddir / "SNES" / "bin" / "main.bin"))
-	{
-		asar3.printErrors();
-		Logging::error("asar reported an error while assembling asm/main.asm.");
-		return false;
+		AsarBinding asar3 (driver_builddir / "tempmain.asm");
+		if (!asar3.compileToBin())
+		{
+			asar3.printErrors();
+			Logging::error("asar reported an error while assembling asm/main.asm.");
+			return false;
+		}
+		program = asar3.getCompiledBin();
 	}
 
-	programSize = asar3.getProgramSize();
+	programSize = program.size();
 
-	std::vector<uint8_t> temp;
-	readBinaryFile(driver_builddir / "SNES" / "bin" / "main.bin", temp);
-	std::vector<uint8_t> temp2;
-	temp2.resize(temp.size() + 4);
-	temp2[0] = programSize & 0xFF;
-	temp2[1] = programSize >> 8;
-	temp2[2] = programPos & 0xFF;
-	temp2[3] = programPos >> 8;
-	for (unsigned int i = 0; i < temp.size(); i++)
-		temp2[4+i] = temp[i];
-	writeBinaryFile(driver_builddir / "SNES" / "bin" / "main.bin", temp2);
+	// The uploadable program carries its size and ARAM position in front.
+	program.insert(program.begin(), {(uint8_t)(programSize & 0xFF), (uint8_t)(programSize >> 8), (uint8_t)(programPos & 0xFF), (uint8_t)(programPos >> 8)});
+	writeBinaryFile(driver_builddir / "SNES" / "bin" / "main.bin", program);
 
 	Logging::debug(std::stringstream() << "Total space in ARAM left for local songs: 0x" << hex4 << (0x10000 - programSize - 0x400) << " bytes." << std::dec);
 
@@ -651,203 +1024,534 @@ bool SPCEnvironment::_fixMusicPointers()
 	return true;
 }
 
-bool SPCEnvironment::_generateSPCs()
+bool SPCEnvironment::_buildSPCTemplate()
 {
-	if (options.checkEcho == false)		// If echo buffer checking is off, then the overflow may be due to too many samples.
-		return false;			// In this case, trying to generate an SPC would crash.
-	//uint8_t base[0x10000];
-
-	std::vector<uint8_t> programData;
+	std::vector<uint8_t> programData, SPCBase, DSPBase;
 	readBinaryFile(driver_builddir / "SNES" / "bin" / "main.bin", programData);
 	programData.erase(programData.begin(), programData.begin() + 4);	// Erase the upload data.
-	unsigned int i;
+	readBinaryFile(driver_builddir / "SNES" / "SPCBase.bin", SPCBase);
+	readBinaryFile(driver_builddir / "SNES" / "SPCDSPBase.bin", DSPBase);
 
-	unsigned int localPos;
+	spcTemplate.assign(SPC_FILE_SIZE, 0);
+	std::copy(SPCBase.begin(), SPCBase.begin() + std::min<size_t>(SPCBase.size(), SPC_FILE_SIZE), spcTemplate.begin());
+	std::copy(programData.begin(), programData.begin() + std::min<size_t>(programSize, programData.size()), spcTemplate.begin() + 0x100 + programPos);
+	std::copy(DSPBase.begin(), DSPBase.end(), spcTemplate.begin() + 0x10100);
 
+	spcTemplate[0x15F] = 0x20;
 
-	//for (i = 0; i < programPos; i++) base[i] = 0;
+	// Play length is stored as plain text. The seconds field is filled per song; the fade length is always 10000 ms.
+	std::memcpy(spcTemplate.data() + 0xAC, "10000", 5);
 
-	//for (i = 0; i < programSize; i++)
-	//	base[i + programPos] = programData[i];
+	spcTemplate[0x25] = mainLoopPos & 0xFF;	// Set the PC to the main loop.
+	spcTemplate[0x26] = mainLoopPos >> 8;	// The values of the registers (besides stack which is in the file) don't matter.  They're 0 in the base file.
 
-	localPos = programData.size() + programPos;
+	// Every SPC dumped in the same run shares the same date.
+	char buffer[11];
+	time_t t = time(NULL);
+	strftime(buffer, 11, "%m/%d/%Y", localtime(&t));
+	strncpy((char *)spcTemplate.data() + 0x9E, buffer, 10);
 
-	std::vector<uint8_t> SPC, SPCBase, DSPBase;
-	readBinaryFile(driver_builddir / "SNES" / "SPCBase.bin", SPCBase);
-	readBinaryFile(driver_builddir / "SNES" / "SPCDSPBase.bin", DSPBase);
-	SPC.resize(0x10200);
+	spcSongDataPos = programData.size() + programPos;
+	return true;
+}
 
-	int SPCsGenerated = 0;
+/**
+ * Copies a string into a fixed-length ID666 text field, padding the rest with zeros.
+ */
+static void writeSPCTextField(std::vector<uint8_t>& SPC, size_t offset, const std::string& str, size_t fieldLength = 32)
+{
+	size_t len = std::min(str.length(), fieldLength);
+	std::memcpy(SPC.data() + offset, str.data(), len);
+	std::memset(SPC.data() + offset + len, 0, fieldLength - len);
+}
 
-	bool forceAll = false;
+void SPCEnvironment::_renderSPC(const SPCDumpJob& job, std::vector<uint8_t>& SPC, std::vector<SPCSamplePlacement>* placements) const
+{
+	const CompiledSong& song = musics[job.songIndex];
+	const unsigned int localPos = spcSongDataPos;
 
-	int mode = 0;		// 0 = dump music, 1 = dump SFX1, 2 = dump SFX2
-	int maxMode = 0;
-	if (options.sfxDump == true) maxMode = 2;
+	std::memcpy(SPC.data(), spcTemplate.data(), SPC_FILE_SIZE);
+	if (placements)
+		placements->clear();
 
-	for (int mode = 0; mode <= maxMode; mode++)
+	if (job.mode == 0)
 	{
+		writeSPCTextField(SPC, 0x2E, song.title);
+		writeSPCTextField(SPC, 0x4E, song.game);
+		writeSPCTextField(SPC, 0x7E, song.comment);
+		writeSPCTextField(SPC, 0xB1, song.author);
 
-		for (unsigned int i = 0; i < 256; i++)
-		{
-			if (mode == 0 && musics[i].exists == false) continue;
-			if (mode == 1 && soundEffects[0][i].exists == false) continue;
-			if (mode == 2 && soundEffects[1][i].exists == false) continue;
+		std::copy(song.finalData.begin(), song.finalData.end(), SPC.begin() + localPos + 0x100);
+	}
 
-			if (mode == 0 && i <= highestGlobalSong) continue;		// Cannot generate SPCs for global songs as required samples, SRCN table, etc. cannot be determined.
+	int tablePos = localPos + song.finalData.size();
 
-			SPCsGenerated++;
-			int y = 2;					// Used to generate 2 SPCs for tracks with Yoshi drums.
-			if (mode != 0) y = 1;
-			while (y > 0)
-			{
-				if (mode == 0 && musics[i].hasYoshiDrums == false && y == 2)
-				{
-					y--;
-					continue;
-				}
-				SPC.clear();
-				SPC.resize(0x10200);
+	if ((tablePos & 0xFF) != 0)
+		tablePos = (tablePos & 0xFF00) + 0x100;
 
-				for (unsigned int j = 0; j < SPCBase.size(); j++)
-					SPC[j] = SPCBase[j];
+	int samplePos = tablePos + song.mySamples.size() * 4;
 
-				if (mode == 0) { for (unsigned int j = 0; j < 32; j++) if (j < musics[i].title.length())    SPC[j + 0x2E] = musics[i].title[j];    else SPC[j + 0x2E] = 0; }
-				if (mode == 0) { for (unsigned int j = 0; j < 32; j++) if (j < musics[i].game.length())     SPC[j + 0x4E] = musics[i].game[j];     else SPC[j + 0x4E] = 0; }
-				if (mode == 0) { for (unsigned int j = 0; j < 32; j++) if (j < musics[i].comment.length())  SPC[j + 0x7E] = musics[i].comment[j];  else SPC[j + 0x7E] = 0; }
-				if (mode == 0) { for (unsigned int j = 0; j < 32; j++) if (j < musics[i].author.length())   SPC[j + 0xB1] = musics[i].author[j];   else SPC[j + 0xB1] = 0; }
+	for (unsigned int j = 0; j < song.mySamples.size(); j++)
+	{
+		const Sample& sample = samples[song.mySamples[j]];
+		if (!song.sampleAddresses.empty())
+			samplePos = song.sampleAddresses[j];
+		unsigned short newLoopPoint = sample.loopPoint + samplePos;
+		SPC[tablePos + j * 4 + 0x100] = samplePos & 0xFF;
+		SPC[tablePos + j * 4 + 0x101] = samplePos >> 8;
+		SPC[tablePos + j * 4 + 0x102] = newLoopPoint & 0xFF;
+		SPC[tablePos + j * 4 + 0x103] = newLoopPoint >> 8;
+
+		std::copy(sample.data.begin(), sample.data.end(), SPC.begin() + samplePos + 0x100);
+		if (placements)
+			placements->push_back({(uint32_t)song.mySamples[j], (uint32_t)samplePos + 0x100});
+		samplePos += sample.data.size();
+	}
 
-				for (int j = 0; j < programSize; j++)
-					SPC[0x100 + programPos + j] = programData[j];
+	SPC[0x1015D] = tablePos >> 8;
 
+	if (job.yoshi) SPC[0x01f5] = 2;
 
-				int backupIndex = i;
-				if (mode != 0) {
-					i = highestGlobalSong + 1;
-					for (int j = highestGlobalSong+1; j < 256; j++) {
-						if (musics[j].exists) {
-							i = j;		// While dumping SFX, pretend that the current song is the lowest valid local song
-							break;
-						}
-					}
-				}
+	SPC[0xA9] = (song.seconds / 100 % 10) + '0';		// Why on Earth is the value stored as plain text...?
+	SPC[0xAA] = (song.seconds / 10 % 10) + '0';
+	SPC[0xAB] = (song.seconds / 1 % 10) + '0';
 
-				if (mode == 0)
-				{
-					for (unsigned int j = 0; j < musics[i].finalData.size(); j++)
-						SPC[localPos + 0x100 + j] = musics[i].finalData[j];
-				}
+	if (job.mode == 0)
+		SPC[0x1F6] = highestGlobalSong + 1;	// Tell the SPC to play this song.
+	else if (job.mode == 1)
+		SPC[0x1F4] = job.index;				// Tell the SPC to play this SFX
+	else if (job.mode == 2)
+		SPC[0x1F7] = job.index;				// Tell the SPC to play this SFX
+}
 
-				int tablePos = localPos + musics[i].finalData.size();
+void SPCEnvironment::_renderWAV(const SPCDumpJob& job, const std::vector<uint8_t>& SPC) const
+{
+	TimeReport::Scope scope (timeReport.get(), "render WAV", job.filename.filename().string());
+	SPCEmulator emulator;
+	if (!emulator.loadSPC(SPC))
+		Logging::error("Could not load the SPC of song " + hex<2>(job.index) + " into the emulator.");
+
+	std::vector<int16_t> pcm;
+	emulator.render((size_t)options.renderSeconds * SPCEmulator::SAMPLE_RATE, pcm);
+
+	fs::path wavPath = job.filename;
+	wavPath.replace_extension(".wav");
+	if (!SPCEmulator::writeWAV(wavPath.string(), pcm))
+		throw fs::filesystem_error("Could not write WAV file", wavPath, std::make_error_code(std::errc::io_error));
+	Logging::debug(std::string("Wrote \"") + wavPath.string() + "\" to file.");
+}
 
-				if ((tablePos & 0xFF) != 0)
-					tablePos = (tablePos & 0xFF00) + 0x100;
+void SPCEnvironment::_profileDriver(const SPCDumpJob& job, const std::vector<uint8_t>& SPC) const
+{
+	TimeReport::Scope scope (timeReport.get(), "profile driver", job.filename.filename().string());
+	SPCEmulator emulator;
+	if (!emulator.loadSPC(SPC))
+		Logging::error("Could not load the SPC of song " + hex<2>(job.index) + " into the emulator.");
+
+	DriverProfiler profiler (driverLabels);
+	emulator.cpu().setTracer(&profiler);
+	std::vector<int16_t> pcm;
+	emulator.render((size_t)options.profileSeconds * SPCEmulator::SAMPLE_RATE, pcm);
+
+	const int tickBudget = emulator.cpu().timerPeriod(0);
+	writeTextFile(spc_output_dir / "stats" / (job.filename.stem().string() + " driver load.txt"), profiler.report(tickBudget));
+
+	if (profiler.worstPass() > tickBudget)
+		Logging::warning("Song " + hex<2>(job.index) + " kept the driver busy for " + std::to_string(profiler.worstPass()) + " cycles in a " + std::to_string(tickBudget) + "-cycle tick ("
+			+ std::to_string(profiler.passesOver(tickBudget)) + " times in " + std::to_string(options.profileSeconds) + " seconds). It may slow down in game.");
+}
 
-				int samplePos = tablePos + musics[i].mySamples.size() * 4;
+std::vector<SPCDumpJob> SPCEnvironment::_planSPCDumps()
+{
+	std::vector<SPCDumpJob> jobs;
 
-				for (unsigned int j = 0; j < musics[i].mySamples.size(); j++)
-				{
-					SPC[tablePos + j * 4 + 0x100] = samplePos & 0xFF;
-					SPC[tablePos + j * 4 + 0x101] = samplePos >> 8;
-					unsigned short loopPoint = samples[musics[i].mySamples[j]].loopPoint;
-					unsigned short newLoopPoint = loopPoint + samplePos;
-					SPC[tablePos + j * 4 + 0x102] = newLoopPoint & 0xFF;
-					SPC[tablePos + j * 4 + 0x103] = newLoopPoint >> 8;
+	// While dumping SFX, pretend that the current song is the lowest valid local song.
+	unsigned int sfxSongIndex = highestGlobalSong + 1;
+	for (int j = highestGlobalSong + 1; j < 256; j++)
+	{
+		if (musics[j].exists)
+		{
+			sfxSongIndex = j;
+			break;
+		}
+	}
 
-					for (unsigned int k = 0; k < samples[musics[i].mySamples[j]].data.size(); k++)
-						SPC[samplePos + 0x100 + k] = samples[musics[i].mySamples[j]].data[k];
+	int maxMode = 0;	// 0 = dump music, 1 = dump SFX1, 2 = dump SFX2
+	if (options.sfxDump == true) maxMode = 2;
 
-					samplePos += samples[musics[i].mySamples[j]].data.size();
-				}
+	for (int mode = 0; mode <= maxMode; mode++)
+	{
+		if (mode != 0 && spc_build_plan && options.spcArchive.empty() && options.spcPack.empty())
+			fs::create_directories(spc_output_dir / (mode == 1 ? "1DF9" : "1DFC"));
+
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			SPCDumpJob job;
+			job.mode = mode;
+			job.index = i;
+
+			if (mode == 0)
+			{
+				if (musics[i].exists == false) continue;
+				if (i <= highestGlobalSong) continue;		// Cannot generate SPCs for global songs as required samples, SRCN table, etc. cannot be determined.
+
+				musics[i].pathlessSongName = musics[i].name.stem().string();
+				job.songIndex = i;
+				job.filename = spc_output_dir / musics[i].pathlessSongName;
+			}
+			else
+			{
+				if (soundEffects[mode - 1][i].exists == false) continue;
+
+				job.songIndex = sfxSongIndex;
+				job.filename = spc_output_dir / (mode == 1 ? "1DF9" : "1DFC") / soundEffects[mode - 1][i].name.stem();
+			}
+
+			// Tracks with Yoshi drums get a second SPC with the drums turned on.
+			if (mode == 0 && musics[i].hasYoshiDrums)
+			{
+				SPCDumpJob yoshiJob = job;
+				yoshiJob.yoshi = true;
+				yoshiJob.filename += " (Yoshi)";
+				yoshiJob.filename += ".spc";
+				jobs.push_back(yoshiJob);
+			}
+
+			job.filename += ".spc";
+			jobs.push_back(job);
+		}
+	}
+
+	return jobs;
+}
 
-				for (unsigned int j = 0; j < DSPBase.size(); j++)
-					SPC[0x10100 + j] = DSPBase[j];
+std::string SPCEnvironment::_spcArchiveIndex(const std::vector<SPCDumpJob>& jobs) const
+{
+	std::stringstream index;
+	index << "file\tlength\ttitle\tgame\tauthor\n";
+	for (const SPCDumpJob& job : jobs)
+	{
+		const CompiledSong& song = musics[job.songIndex];
+		index << job.filename.lexically_relative(spc_output_dir).generic_string() << '\t' << song.seconds << '\t';
+		if (job.mode == 0)
+			index << song.title << '\t' << song.game << '\t' << song.author;
+		else
+			index << '\t' << '\t';
+		index << '\n';
+	}
+	return index.str();
+}
 
-				SPC[0x1015D] = tablePos >> 8;
+bool SPCEnvironment::_generateSPCs()
+{
+	TimeReport::Scope scope (timeReport.get(), "generate SPCs");
+	if (options.checkEcho == false)		// If echo buffer checking is off, then the overflow may be due to too many samples.
+		return false;			// In this case, trying to generate an SPC would crash.
+
+	std::vector<SPCDumpJob> jobs = _planSPCDumps();
 
-				SPC[0x15F] = 0x20;
+	// Hotfix to not store SPCs if we're patching a ROM.
+	if (!spc_build_plan || jobs.empty())
+		return true;
 
-				if (y == 2) SPC[0x01f5] = 2;
+	_buildSPCTemplate();
 
-				SPC[0xA9] = (musics[i].seconds / 100 % 10) + '0';		// Why on Earth is the value stored as plain text...?
-				SPC[0xAA] = (musics[i].seconds / 10 % 10) + '0';
-				SPC[0xAB] = (musics[i].seconds / 1 % 10) + '0';
+	// Every SPC only depends on read-only state from here on, so they are rendered by a
+	// pool of workers. Without an archive or a pack, each worker writes its own files.
+	// Otherwise, this thread streams the rendered images into them in job order.
+	std::unique_ptr<ZipWriter> archive;
+	if (!options.spcArchive.empty())
+		archive = std::make_unique<ZipWriter>(options.spcArchive);
+	std::unique_ptr<SPCPackWriter> pack;
+	if (!options.spcPack.empty())
+		pack = std::make_unique<SPCPackWriter>(options.spcPack, spcTemplate);
+	const bool collect = archive || pack;
 
-				SPC[0xAC] = '1';
-				SPC[0xAD] = '0';
-				SPC[0xAE] = '0';
-				SPC[0xAF] = '0';
-				SPC[0xB0] = '0';
+	if (options.profileSeconds > 0)
+		fs::create_directories(spc_output_dir / "stats");
 
-				SPC[0x25] = mainLoopPos & 0xFF;	// Set the PC to the main loop.
-				SPC[0x26] = mainLoopPos >> 8;	// The values of the registers (besides stack which is in the file) don't matter.  They're 0 in the base file.
+	unsigned int workerCount = options.jobs ? options.jobs : std::thread::hardware_concurrency();
+	workerCount = std::max(1u, std::min<unsigned int>(workerCount, jobs.size()));
+
+	struct RenderedSPC
+	{
+		std::vector<uint8_t> image;
+		std::vector<SPCSamplePlacement> placements;
+		bool ready {false};
+	};
 
-				i = backupIndex;
+	std::atomic<size_t> nextJob {0};
+	std::exception_ptr workerError;
+	std::vector<RenderedSPC> rendered(collect ? jobs.size() : 0);
+	std::mutex stateMutex;
+	std::condition_variable renderedCV;
 
-				if (mode == 0)
+	auto worker = [&]()
+	{
+		std::vector<uint8_t> SPC(SPC_FILE_SIZE);
+		std::vector<SPCSamplePlacement> placements;
+		try
+		{
+			for (size_t j = nextJob++; j < jobs.size(); j = nextJob++)
+			{
 				{
-					SPC[0x1F6] = highestGlobalSong + 1;	// Tell the SPC to play this song.
+					TimeReport::Scope jobScope (timeReport.get(), "render SPC", jobs[j].filename.filename().string());
+					_renderSPC(jobs[j], SPC, collect ? &placements : nullptr);
 				}
-				else if (mode == 1)
+				if (options.renderSeconds > 0 && jobs[j].mode == 0)
+					_renderWAV(jobs[j], SPC);
+				if (options.profileSeconds > 0 && jobs[j].mode == 0)
+					_profileDriver(jobs[j], SPC);
+				if (collect)
 				{
-					SPC[0x1F4] = i;				// Tell the SPC to play this SFX
+					std::lock_guard<std::mutex> lock(stateMutex);
+					rendered[j].image = SPC;
+					rendered[j].placements = placements;
+					rendered[j].ready = true;
+					renderedCV.notify_all();
 				}
-				else if (mode == 2)
+				else
 				{
-					SPC[0x1F7] = i;				// Tell the SPC to play this SFX
+					writeBinaryFile(jobs[j].filename, SPC);
+					Logging::debug(std::string("Wrote \"") + jobs[j].filename.string() + "\" to file.");
 				}
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			if (!workerError)
+				workerError = std::current_exception();
+			nextJob = jobs.size();		// Stop the other workers as soon as possible.
+			renderedCV.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < workerCount; t++)
+		workers.emplace_back(worker);
 
-				char buffer[11];
-				time_t t = time(NULL);
-				strftime(buffer, 11, "%m/%d/%Y", localtime(&t));
-				strncpy((char *)SPC.data() + 0x9E, buffer, 10);
-
-				fs::path pathlessSongName;
-				if (mode == 0)
-					pathlessSongName = musics[i].name.stem();
-				else if (mode == 1)
-					pathlessSongName = soundEffects[0][i].name.stem();
-				else if (mode == 2)
-					pathlessSongName = soundEffects[1][i].name.stem();
-
-				if (mode == 0) musics[i].pathlessSongName = pathlessSongName.string();
-				if (mode == 1) {
-					pathlessSongName = "1DF9" / pathlessSongName;
-					if (!fs::exists("1DF9"))
-						fs::create_directory(spc_output_dir / "1DF9");
+	if (collect)
+	{
+		try
+		{
+			for (size_t j = 0; j < jobs.size(); j++)
+			{
+				RenderedSPC current;
+				{
+					std::unique_lock<std::mutex> lock(stateMutex);
+					renderedCV.wait(lock, [&]() { return rendered[j].ready || workerError; });
+					if (!rendered[j].ready)
+						break;
+					current = std::move(rendered[j]);
 				}
-				if (mode == 2) {
-					pathlessSongName = "1DFC" / pathlessSongName;
-					if (!fs::exists("1DFC"))
-						fs::create_directory(spc_output_dir / "1DFC");
+
+				const std::string entryName = jobs[j].filename.lexically_relative(spc_output_dir).generic_string();
+				if (archive)
+					archive->addFile(entryName, current.image);
+				if (pack)
+				{
+					for (const SPCSamplePlacement& placement : current.placements)
+						pack->addSample(placement.sampleId, samples[placement.sampleId].data);
+					pack->addSPC(entryName, current.image, current.placements);
 				}
+			}
+			if (!workerError && archive)
+			{
+				archive->addFile("index.txt", _spcArchiveIndex(jobs));
+				archive->close();
+				Logging::debug("Wrote " + std::to_string(jobs.size()) + " SPC file(s) into \"" + options.spcArchive.string() + "\".");
+			}
+			if (!workerError && pack)
+			{
+				pack->close();
+				Logging::debug(std::stringstream() << "Packed " << jobs.size() << " SPC file(s) into \"" << options.spcPack.string() << "\" ("
+					<< pack->packedSize() << " bytes instead of " << jobs.size() * SPC_FILE_SIZE << ").");
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			if (!workerError)
+				workerError = std::current_exception();
+			nextJob = jobs.size();
+		}
+	}
 
-				fs::path fname = spc_output_dir / pathlessSongName;
+	for (std::thread& t : workers)
+		t.join();
 
-				if (y == 2)
-					fname += " (Yoshi)";
+	if (workerError)
+		std::rethrow_exception(workerError);
 
-				fname += ".spc";
+	Logging::debug(std::string("Generated ") + std::to_string(jobs.size()) + " SPC file(s)");
+	return true;
+}
 
-				Logging::debug(std::string("Wrote \"") + fname.string() + "\" to file.");
+void SPCEnvironment::prepare(const fs::path& output_folder)
+{
+	justSPCsPlease = true;
+	spc_output_dir = output_folder;
+	spc_build_plan = false;
 
-				// Hotfix to not store SPCs if we're patching a ROM.
-				if (spc_build_plan)
-					writeBinaryFile(fname, SPC);
-				y--;
-			}
+	_loadLists();
+
+	_assembleSNESDriver();
+	_assembleSPCDriver();
+	_compileSFX();
+	_compileGlobalData();
+
+	// Only the global songs stay resident. Local songs come one at a time.
+	for (int i = highestGlobalSong + 1; i < 256; i++)
+		musics[i].exists = false;
+	_compileMusic();
+
+	prepared = true;
+}
 
+std::vector<uint8_t> SPCEnvironment::compileSPC(const fs::path& mmlFile, const std::string* text)
+{
+	if (!prepared)
+		prepare(spc_output_dir.empty() ? fs::path(".") : spc_output_dir);
+
+	const int index = highestGlobalSong + 1;
+	if (index >= 256)
+		Logging::error("Error: There is no room left for a local song after the global ones.");
+
+	int globalEchoBufferSize = 0;
+	for (int i = 0; i <= highestGlobalSong; i++)
+		if (musics[i].exists)
+			globalEchoBufferSize = std::max(globalEchoBufferSize, musics[i].echoBufferSize);
+
+	musics[index] = CompiledSong();
+	musics[index].exists = true;
+	musics[index].name = mmlFile;
+	_compileSong(index, globalEchoBufferSize, text);
+	if (!_fixMusicPointers())
+		Logging::error("Error: " + mmlFile.filename().string() + " could not be linked.");
+
+	_buildSPCTemplate();
+	std::vector<uint8_t> SPC (SPC_FILE_SIZE);
+	for (const SPCDumpJob& job : _planSPCDumps())
+	{
+		if (job.mode == 0 && !job.yoshi)
+		{
+			_renderSPC(job, SPC);
+			break;
 		}
 	}
+	return SPC;
+}
 
-	Logging::debug(std::string("Generated ") + std::to_string(SPCsGenerated) + " SPC file(s)");
-	return true;
+std::vector<fs::path> SPCEnvironment::lastSongSamples() const
+{
+	std::vector<fs::path> files;
+	const int index = highestGlobalSong + 1;
+	if (index >= 256 || !musics[index].exists)
+		return files;
+
+	for (unsigned short sample : musics[index].mySamples)
+		if (!samples[sample].isBNK)
+			files.push_back(samples[sample].name);
+	return files;
+}
+
+void SPCEnvironment::_writeTimeReport() const
+{
+	if (!timeReport)
+		return;
+
+	timeReport->write(options.timeReportPath);
+	Logging::info("Time report written to " + options.timeReportPath.string() + ":\n" + timeReport->summary());
+}
+
+void SPCEnvironment::_loadLists()
+{
+	if (listsLoaded)
+		return;
+
+	if (project)
+	{
+		parseSampleList(project->sampleGroups);
+		parseMusicList(project->songList);
+		parseSFXList(project->soundEffects);
+	}
+	else
+	{
+		loadSampleList(work_dir / DEFAULT_SAMPLELIST_FILENAME);
+		loadMusicList(work_dir / DEFAULT_SONGLIST_FILENAME);
+		loadSFXList(work_dir / DEFAULT_SFXLIST_FILENAME);
+	}
+	listsLoaded = true;
+}
+
+fs::path SPCEnvironment::_projectKey(const fs::path& file) const
+{
+	// Not canonical(): the files of the project don't exist.
+	return fs::absolute(file).lexically_normal().lexically_relative(fs::absolute(work_dir).lexically_normal());
+}
+
+bool SPCEnvironment::_fileExists(const fs::path& file) const
+{
+	if (project)
+	{
+		const fs::path key = _projectKey(file);
+		if (project->texts.count(key) || project->binaries.count(key))
+			return true;
+	}
+	return fs::exists(file);
+}
+
+bool SPCEnvironment::_inProject(const fs::path& file) const
+{
+	return project && project->binaries.count(_projectKey(file));
+}
+
+void SPCEnvironment::_readTextFile(const fs::path& file, std::string& str) const
+{
+	if (project)
+	{
+		auto it = project->texts.find(_projectKey(file));
+		if (it != project->texts.end())
+		{
+			str = it->second;
+			return;
+		}
+	}
+	readTextFile(file, str);
+}
+
+void SPCEnvironment::_readBinaryFile(const fs::path& file, std::vector<uint8_t>& data) const
+{
+	if (project)
+	{
+		auto it = project->binaries.find(_projectKey(file));
+		if (it != project->binaries.end())
+		{
+			data = it->second;
+			return;
+		}
+	}
+	readBinaryFile(file, data);
+}
+
+bool SPCEnvironment::_sameFile(const fs::path& a, const fs::path& b) const
+{
+	if (_inProject(a) || _inProject(b))
+		return _projectKey(a) == _projectKey(b);
+	return fs::equivalent(a, b);
 }
 
 void SPCEnvironment::loadSampleList(const fs::path& samplelistfile)
 {
 	std::string str;
 	readTextFile(samplelistfile, str);
+	parseSampleList(str);
+}
+
+void SPCEnvironment::parseSampleList(const std::string& str)
+{
+	TimeReport::Scope scope (timeReport.get(), "load lists");
 
 	std::string groupName;
 	std::string tempName;
@@ -978,8 +1682,13 @@ void SPCEnvironment::loadMusicList(const fs::path& musiclistfile)
 {
 	std::string musicFile;
 	readTextFile(musiclistfile, musicFile);
+	parseMusicList(musicFile);
+}
 
-	if (musicFile[musicFile.length()-1] != '\n')
+void SPCEnvironment::parseMusicList(std::string musicFile)
+{
+	TimeReport::Scope scope (timeReport.get(), "load lists");
+	if (musicFile.empty() || musicFile[musicFile.length()-1] != '\n')
 		musicFile += '\n';
 
 	unsigned int i = 0;
@@ -1048,11 +1757,6 @@ void SPCEnvironment::loadMusicList(const fs::path& musiclistfile)
 			if (musicFile[i] == '\n' || musicFile[i] == '\r')
 			{
 				musics[index].name = work_dir / "music" / tempName;
-				// Don't bother loading local songs if we're just going to compile SPCs on demand.
-				if (inLocals && justSPCsPlease == false)
-				{
-					readTextFile(work_dir / "music" / tempName, musics[index].text);
-				}
 				musics[index].exists = true;
 				index = -1;
 				i++;
@@ -1080,10 +1784,16 @@ void SPCEnvironment::loadMusicList(const fs::path& musiclistfile)
 }
 
 void SPCEnvironment::loadSFXList(const fs::path& sfxlistfile)
-{	std::string str;
+{
+	std::string str;
 	readTextFile(sfxlistfile, str);
+	parseSFXList(str);
+}
 
-	if (str[str.length()-1] != '\n')
+void SPCEnvironment::parseSFXList(std::string str)
+{
+	TimeReport::Scope scope (timeReport.get(), "load lists");
+	if (str.empty() || str[str.length()-1] != '\n')
 		str += '\n';
 
 	unsigned int i = 0;
@@ -1176,7 +1886,7 @@ void SPCEnvironment::loadSFXList(const fs::path& sfxlistfile)
 							soundEffects[0][index].add0 = true;
 
 						if (!isPointer)
-							readTextFile(work_dir / "1DF9" / tempName, soundEffects[0][index].text);
+							_readTextFile(work_dir / "1DF9" / tempName, soundEffects[0][index].text);
 					}
 					else
 					{
@@ -1193,7 +1903,7 @@ void SPCEnvironment::loadSFXList(const fs::path& sfxlistfile)
 							soundEffects[1][index].add0 = true;
 
 						if (!isPointer)
-							readTextFile(work_dir / "1DFC" / tempName, soundEffects[1][index].text);
+							_readTextFile(work_dir / "1DFC" / tempName, soundEffects[1][index].text);
 					}
 
 					index = -1;
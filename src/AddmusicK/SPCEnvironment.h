@@ -5,8 +5,12 @@
 #include <memory>
 #include <filesystem>
 
+#include "InMemoryProject.h"
 #include "SoundEffect.h"
 #include "Music.h"
+#include "SampleCache.h"
+#include "SPCPack.h"
+#include "TimeReport.h"
 #include "Utility.h"
 
 namespace fs = std::filesystem;
@@ -19,6 +23,9 @@ constexpr const char DEFAULT_SONGLIST_FILENAME[] {"Addmusic_list.txt"};
 constexpr const char DEFAULT_SAMPLELIST_FILENAME[] {"Addmusic_sample groups.txt"};
 constexpr const char DEFAULT_SFXLIST_FILENAME[] {"Addmusic_sound effects.txt"};
 
+// Size of an SPC file: header, 64 KB of ARAM, DSP registers and extra RAM.
+constexpr size_t SPC_FILE_SIZE {0x10200};
+
 /**
  * @brief Initialization options that combine the SPC and ROM hacking
  * functionality. Normally you won't need to change any of these.
@@ -39,10 +46,32 @@ struct EnvironmentOptions
 	fs::path customSPCDriverPath;
 
 	fs::path customSamplesPath;
+	fs::path sampleCachePath;			// If set, parsed BRR samples and banks are cached in this file between builds.
 	
 	bool sfxDump {false};
 	bool doNotPatch {false};
 	bool bankOptimizations {true};
+
+	unsigned int jobs {0};				// Worker threads used to dump SPCs. 0 = one per hardware thread.
+	fs::path spcArchive;				// If set, SPCs are bundled into this store-only ZIP archive instead of loose files.
+	fs::path spcPack;					// If set, SPCs are stored deduplicated in this pack instead of loose files (see SPCPack.h).
+	unsigned int renderSeconds {0};		// If not 0, every song is also played for this long and saved as a WAV next to its SPC.
+	unsigned int profileSeconds {0};	// If not 0, every song is played for this long to measure the driver's CPU load (see DriverProfiler.h).
+	bool visualize {false};				// If set, the ARAM usage of every local song is drawn in a PNG (see ARAMVisualizer.h).
+	fs::path timeReportPath;			// If set, every build phase is timed and a Chrome trace is written here (see TimeReport.h).
+};
+
+/**
+ * @brief A single SPC file to be dumped. Jobs are planned serially and can
+ * then be rendered in any order.
+ */
+struct SPCDumpJob
+{
+	int mode {0};						// 0 = music, 1 = 1DF9 SFX, 2 = 1DFC SFX.
+	unsigned int index {0};				// Song or SFX number.
+	unsigned int songIndex {0};			// Song whose data, samples and length go into the image.
+	bool yoshi {false};					// Turn on the Yoshi drums.
+	fs::path filename;					// Output SPC file.
 };
 
 /**
@@ -66,6 +95,14 @@ public:
 	 */
 	SPCEnvironment(const fs::path& work_dir, EnvironmentOptions opts = EnvironmentOptions());
 
+	/**
+	 * @brief Instance SPCEnvironment on a project held in memory. work_dir
+	 * does not need to exist: it only names where the project's files would
+	 * be, so that songs and samples can be found by path. The project is
+	 * shared, not copied, between environments.
+	 */
+	SPCEnvironment(const fs::path& work_dir, std::shared_ptr<const InMemoryProject> project, EnvironmentOptions opts = EnvironmentOptions());
+
 	/**
 	 * @brief Destructor.
 	 */
@@ -76,21 +113,57 @@ public:
 	 */
 	bool generateSPCFiles(const std::vector<fs::path>& textFilesToCompile, const fs::path& output_folder = fs::path("."));
 
+	/**
+	 * @brief Loads the lists and builds the driver, the SFX and the global
+	 * songs once, so that every compileSPC() afterwards only compiles its song.
+	 */
+	void prepare(const fs::path& output_folder = fs::path("."));
+
+	/**
+	 * @brief Compiles a local song and returns its SPC image. Prepares the
+	 * environment first if needed. The MML is read from mmlFile unless text
+	 * is given; mmlFile still names the song and is where its #path and
+	 * sample paths are relative to.
+	 */
+	std::vector<uint8_t> compileSPC(const fs::path& mmlFile, const std::string* text = nullptr);
+
+	/**
+	 * @brief Sample files used by the song compileSPC() compiled last. Samples
+	 * from BNK files are left out, as they have no file of their own.
+	 */
+	std::vector<fs::path> lastSongSamples() const;
+
 	/**
 	 * Loads a sample list file.
 	 */
 	void loadSampleList(const fs::path& samplelistfile);
 
+	/**
+	 * Parses the contents of a sample list file.
+	 */
+	void parseSampleList(const std::string& str);
+
 	/**
 	 * Loads a music list file.
 	 */
 	void loadMusicList(const fs::path& musiclistfile);
 
+	/**
+	 * Parses the contents of a music list file.
+	 */
+	void parseMusicList(std::string musicFile);
+
 	/**
 	 * Loads a SFX list file. 
 	 */
 	void loadSFXList(const fs::path& sfxlistfile);
 
+	/**
+	 * Parses the contents of a SFX list file. The sound effects themselves
+	 * are read from the 1DF9 and 1DFC folders.
+	 */
+	void parseSFXList(std::string str);
+
 	int SNESToPC(int addr);
 
 	int PCToSNES(int addr);
@@ -98,6 +171,44 @@ public:
 	EnvironmentOptions options;							// User-defined options.
 
 protected:
+	/**
+	 * Loads the three lists from the project or the work directory, unless
+	 * they were loaded already.
+	 */
+	void _loadLists();
+
+	/**
+	 * Whether a file of the project or the work directory exists. Files of
+	 * the project are looked up first; anything else is read from disk.
+	 */
+	bool _fileExists(const fs::path& file) const;
+
+	/**
+	 * Whether file is a BRR or BNK file held by the project, rather than on disk.
+	 */
+	bool _inProject(const fs::path& file) const;
+
+	void _readTextFile(const fs::path& file, std::string& str) const;
+
+	void _readBinaryFile(const fs::path& file, std::vector<uint8_t>& data) const;
+
+	/**
+	 * Like fs::equivalent(), but also for files of the project.
+	 */
+	bool _sameFile(const fs::path& a, const fs::path& b) const;
+
+	/**
+	 * Path of file relative to work_dir, which is how the project keys it.
+	 */
+	fs::path _projectKey(const fs::path& file) const;
+
+	/**
+	 * Everything generateSPCFiles() does before compiling the songs: loads
+	 * the lists, builds the driver, the SFX and the global data, and puts
+	 * localSongs in the slots after the global songs.
+	 */
+	void _prepareBuild(const std::vector<fs::path>& localSongs, const fs::path& output_folder);
+
 	/**
 	 * Useful to retrieve patch info embedded in SNES/patch.asm.
 	 * Equivalent to assembleSNESDriver().
@@ -112,14 +223,112 @@ protected:
 
 	bool _compileSFX();
 
+	/**
+	 * Places every parsed sound effect in ARAM from sfxDataPos onwards and
+	 * assembles all of their inline ASM blocks in a single Asar pass.
+	 */
+	bool _assembleSFX(int sfxDataPos);
+
 	bool _compileGlobalData();
 
+	/**
+	 * Moves every driver instruction reading label (as reported by the first
+	 * pass of main.asm) from the address it was assembled with to the
+	 * address the label was linked at.
+	 */
+	void _relocateDriver(const std::string& label, int assembledAt, int linkedAt);
+
 	bool _compileMusic();
 
+	/**
+	 * Compiles the song in musics[index], from text or from its file if text
+	 * is null. Local songs get an echo buffer as big as the biggest one of
+	 * the global songs at least.
+	 */
+	void _compileSong(int index, int globalEchoBufferSize, const std::string* text = nullptr);
+
+	/**
+	 * Sample order used to lay out resident samples, picked by a
+	 * SampleLayoutOptimizer over every local song.
+	 */
+	std::vector<unsigned short> _residentSampleOrder() const;
+
+	/**
+	 * With resident samples, gives every local song's samples a fixed ARAM
+	 * address. Every song lays its samples out in the same global order from
+	 * a common base, so shared samples tend to stay where the previous song
+	 * left them and the SNES side can skip uploading them again.
+	 */
+	void _layoutResidentSamples(int localSongPos);
+
+	/**
+	 * Writes stats/sample uploads.txt: the sample bytes each local song
+	 * uploads when it starts after every other local song.
+	 */
+	void _writeSampleUploadReport() const;
+
+	/**
+	 * Writes stats/songs.json: the ARAM layout, channel sizes, lengths,
+	 * samples and free ARAM of every song, for tools to track. Only full
+	 * builds write it, not every compileSPC().
+	 */
+	void _writeSongStats() const;
+
+	/**
+	 * Draws the ARAM map of every local song in Visualizations/<song>.png,
+	 * in the SPC output folder.
+	 */
+	void _generatePNGs() const;
+
 	bool _fixMusicPointers();
 
+	/**
+	 * Builds the part of the SPC image shared by every dumped SPC: SPC base
+	 * header, driver program, DSP registers, PC and dump date.
+	 */
+	bool _buildSPCTemplate();
+
+	/**
+	 * Lists every SPC that _generateSPCs() will dump, creating the SFX output
+	 * folders on the way.
+	 */
+	std::vector<SPCDumpJob> _planSPCDumps();
+
+	/**
+	 * Renders a single SPC image into SPC. Only reads the environment, so it
+	 * is safe to call from several threads at once. If placements is not null,
+	 * it receives where each sample was copied in the image.
+	 */
+	void _renderSPC(const SPCDumpJob& job, std::vector<uint8_t>& SPC, std::vector<SPCSamplePlacement>* placements = nullptr) const;
+
+	/**
+	 * Plays a rendered music SPC for options.renderSeconds in the emulator
+	 * and writes what it heard as a WAV next to the SPC. Thread-safe like
+	 * _renderSPC().
+	 */
+	void _renderWAV(const SPCDumpJob& job, const std::vector<uint8_t>& SPC) const;
+
+	/**
+	 * Plays a rendered music SPC for options.profileSeconds, counting the
+	 * cycles of every driver routine, and stores the report in the stats
+	 * folder. Warns if the song keeps the driver busy for longer than a tick.
+	 * Thread-safe like _renderSPC().
+	 */
+	void _profileDriver(const SPCDumpJob& job, const std::vector<uint8_t>& SPC) const;
+
+	/**
+	 * Tab-separated index of an SPC archive: file name, length in seconds,
+	 * title, game and author of every dumped SPC.
+	 */
+	std::string _spcArchiveIndex(const std::vector<SPCDumpJob>& jobs) const;
+
 	bool _generateSPCs();
 
+	/**
+	 * Writes the time report, if one was asked for, and prints its summary.
+	 */
+	void _writeTimeReport() const;
+
 	fs::path driver_srcdir;									// Root directory from which driver ASM files will be found.
 	fs::path driver_builddir;								// Directory in which generated driver files will be put.
 
@@ -129,10 +338,15 @@ protected:
 	fs::path spc_output_dir;								// Where to store the resulting SPCs.
 	
 
+	std::shared_ptr<const InMemoryProject> project;			// Null unless the project is held in memory.
+
 	bool spc_build_plan {false};
+	bool listsLoaded {false};								// _loadLists() has run.
+	bool prepared {false};									// prepare() has run.
 	bool using_custom_spc_driver {false};
 
 	int programUploadPos;
+	bool residentSamples {false};							// !ResidentSamples is enabled in UserDefines.asm.
 
 	// Use the SA1 expansion chip. Will be true unless either the ROM says the opposite
 	// or you don't want it.
@@ -144,18 +358,31 @@ protected:
 	int reuploadPos;
 	bool noSFX;
 	size_t programSize;
+	size_t driverProgramSize {0};							// Main program and SFX, before the song pointers and global songs.
+
+	// Driver linking: main.asm is assembled once and the SFX tables, SFX data and
+	// global songs are appended to its binary instead of assembling it again.
+	std::vector<uint8_t> driverProgram;						// First pass of main.asm.
+	std::multimap<std::string, int> driverRelocations;		// Instructions reading an appended label, by label.
+	std::map<std::string, int> driverLabels;				// Labels of main.asm, to profile the driver.
+	bool driverLinkable {false};							// The driver reports the relocations needed to be linked.
+	std::vector<uint8_t> driverImage;						// Driver program with the SFX tables and data linked.
+	std::string tempMainSource;								// tempmain.asm before the songs are appended, when the driver is not linkable.
 
 	// Sample system.
 	// Will eventually refactor this with a more sophisticated method.
 	std::vector<Sample> samples;
 	std::map<fs::path, int> sampleToIndex;
 	std::vector<std::unique_ptr<BankDefine>> bankDefines;
+	SampleCache sampleCache;								// Parsed BRR and BNK files, shared by every song.
+
+	std::unique_ptr<TimeReport> timeReport;					// Null unless options.timeReportPath is set.
 
 	// Music system.
 	// Will also refactor this with a more sophisticated method.
 	int highestGlobalSong {0};
 	int songCount {0};
-	Music* musics;		// Refactored it to be allocated in the heap.
+	std::vector<CompiledSong> musics;		// By song number. Each song is parsed by a short-lived Music instance.
 
 	// SFX system
 	// Will also refactor this with a more sophisticated method.
@@ -167,6 +394,10 @@ protected:
 	bool justSPCsPlease {true};
 
 	int songSampleListSize;
+
+	// SPC dumping.
+	std::vector<uint8_t> spcTemplate;						// Constant region of every SPC image, built by _buildSPCTemplate().
+	unsigned int spcSongDataPos {0};						// ARAM position where local song data begins.
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include <cstring>
+
+#include "AddmusicLogging.h"
+#include "SPCPack.h"
+#include "Utility.h"
+
+using namespace AddMusic;
+
+static constexpr char SPCPACK_MAGIC[] {"AMKSPCPK"};
+static constexpr uint16_t SPCPACK_VERSION {1};
+
+// Equal bytes tolerated inside a single difference run before it is split in two.
+// A run costs 8 bytes of bookkeeping, so shorter gaps are cheaper to store verbatim.
+static constexpr size_t SPCPACK_MAX_RUN_GAP {8};
+
+enum SPCPackRecord : uint8_t
+{
+	RECORD_END = 0,
+	RECORD_BASE = 1,
+	RECORD_SAMPLE = 2,
+	RECORD_SPC = 3
+};
+
+SPCPackWriter::SPCPackWriter(const fs::path& packfile, const std::vector<uint8_t>& base) :
+	_path(packfile),
+	_base(base)
+{
+	_stream.open(packfile, std::ios::binary | std::ios::trunc);
+	if (!_stream)
+		throw fs::filesystem_error("File cannot be written.", packfile, std::make_error_code(std::errc::permission_denied));
+
+	_writeBytes(reinterpret_cast<const uint8_t*>(SPCPACK_MAGIC), 8);
+	_write16(SPCPACK_VERSION);
+
+	_write8(RECORD_BASE);
+	_write32(_base.size());
+	_writeBytes(_base.data(), _base.size());
+}
+
+SPCPackWriter::~SPCPackWriter()
+{
+	// Never finalize here: a pack that was not closed is missing SPCs,
+	// most likely because an exception is unwinding, and must not look valid.
+	if (!_closed)
+	{
+		_stream.close();
+		std::error_code ec;
+		fs::remove(_path, ec);
+	}
+}
+
+void SPCPackWriter::_write8(uint8_t value)
+{
+	_stream.put((char)value);
+	_written++;
+}
+
+void SPCPackWriter::_write16(uint16_t value)
+{
+	_write8(value & 0xFF);
+	_write8(value >> 8);
+}
+
+void SPCPackWriter::_write32(uint32_t value)
+{
+	_write16(value & 0xFFFF);
+	_write16(value >> 16);
+}
+
+void SPCPackWriter::_writeBytes(const uint8_t* data, size_t size)
+{
+	_stream.write(reinterpret_cast<const char*>(data), size);
+	_written += size;
+}
+
+void SPCPackWriter::addSample(uint32_t sampleId, const std::vector<uint8_t>& data)
+{
+	if (_samples.count(sampleId))
+		return;
+	_samples[sampleId] = data;
+
+	_write8(RECORD_SAMPLE);
+	_write32(sampleId);
+	_write32(data.size());
+	_writeBytes(data.data(), data.size());
+}
+
+void SPCPackWriter::addSPC(const std::string& name, const std::vector<uint8_t>& image, const std::vector<SPCSamplePlacement>& placements)
+{
+	if (image.size() != _base.size())
+		Logging::error("SPC \"" + name + "\" does not have the size of the base image of " + _path.string());
+
+	// What the expander will have before applying this SPC's differences.
+	_reference = _base;
+	for (const SPCSamplePlacement& placement : placements)
+	{
+		auto sample = _samples.find(placement.sampleId);
+		if (sample == _samples.end())
+			Logging::error("SPC \"" + name + "\" references a sample that was not added to " + _path.string());
+		if (placement.offset + sample->second.size() > _reference.size())
+			Logging::error("SPC \"" + name + "\" places a sample out of bounds.");
+		std::memcpy(_reference.data() + placement.offset, sample->second.data(), sample->second.size());
+	}
+
+	// Differences, as runs of bytes. Short stretches of equal bytes are kept inside a run.
+	std::vector<std::pair<uint32_t, uint32_t>> runs;
+	for (size_t i = 0; i < image.size(); )
+	{
+		if (image[i] == _reference[i])
+		{
+			i++;
+			continue;
+		}
+
+		size_t start = i, end = i + 1, gap = 0;
+		for (i = end; i < image.size() && gap <= SPCPACK_MAX_RUN_GAP; i++)
+		{
+			if (image[i] != _reference[i])
+			{
+				end = i + 1;
+				gap = 0;
+			}
+			else
+				gap++;
+		}
+		i = end;
+		runs.emplace_back(start, end - start);
+	}
+
+	_write8(RECORD_SPC);
+	_write16(name.size());
+	_writeBytes(reinterpret_cast<const uint8_t*>(name.data()), name.size());
+	_write16(placements.size());
+	for (const SPCSamplePlacement& placement : placements)
+	{
+		_write32(placement.sampleId);
+		_write32(placement.offset);
+	}
+	_write32(runs.size());
+	for (const auto& [offset, length] : runs)
+	{
+		_write32(offset);
+		_write32(length);
+		_writeBytes(image.data() + offset, length);
+	}
+
+	if (!_stream)
+		throw fs::filesystem_error("File cannot be written.", _path, std::make_error_code(std::errc::io_error));
+}
+
+void SPCPackWriter::close()
+{
+	if (_closed)
+		return;
+
+	_write8(RECORD_END);
+	_stream.close();
+	if (!_stream)
+		throw fs::filesystem_error("File cannot be written.", _path, std::make_error_code(std::errc::io_error));
+	_closed = true;
+}
+
+SPCPackReader::SPCPackReader(const fs::path& packfile)
+{
+	std::vector<uint8_t> pack;
+	readBinaryFile(packfile, pack);
+
+	size_t pos = 0;
+	auto need = [&](size_t size)
+	{
+		if (pos + size > pack.size())
+			Logging::error("The SPC pack " + packfile.string() + " is truncated.");
+	};
+	auto read8 = [&]() -> uint8_t { need(1); return pack[pos++]; };
+	auto read16 = [&]() -> uint16_t { uint16_t lo = read8(); return lo | (read8() << 8); };
+	auto read32 = [&]() -> uint32_t { uint32_t lo = read16(); return lo | ((uint32_t)read16() << 16); };
+	auto readBytes = [&](size_t size) -> std::vector<uint8_t>
+	{
+		need(size);
+		std::vector<uint8_t> bytes(pack.begin() + pos, pack.begin() + pos + size);
+		pos += size;
+		return bytes;
+	};
+
+	need(10);
+	if (std::memcmp(pack.data(), SPCPACK_MAGIC, 8) != 0)
+		Logging::error(packfile.string() + " is not an SPC pack.");
+	pos = 8;
+	if (read16() != SPCPACK_VERSION)
+		Logging::error("The SPC pack " + packfile.string() + " was made by an unsupported version.");
+
+	for (uint8_t record = read8(); record != RECORD_END; record = read8())
+	{
+		switch (record)
+		{
+			case RECORD_BASE:
+				_base = readBytes(read32());
+				break;
+
+			case RECORD_SAMPLE:
+			{
+				uint32_t id = read32();
+				_samples[id] = readBytes(read32());
+				break;
+			}
+
+			case RECORD_SPC:
+			{
+				Entry entry;
+				std::vector<uint8_t> name = readBytes(read16());
+				entry.name.assign(name.begin(), name.end());
+
+				entry.placements.resize(read16());
+				for (SPCSamplePlacement& placement : entry.placements)
+				{
+					placement.sampleId = read32();
+					placement.offset = read32();
+				}
+
+				// Every run takes at least 8 bytes, which bounds the count before anything is allocated.
+				const uint32_t runCount = read32();
+				need((size_t)runCount * 8);
+				entry.runs.resize(runCount);
+				for (Run& run : entry.runs)
+				{
+					run.offset = read32();
+					run.data = readBytes(read32());
+				}
+				_spcs.push_back(std::move(entry));
+				break;
+			}
+
+			default:
+				Logging::error("The SPC pack " + packfile.string() + " contains an unknown record.");
+		}
+	}
+}
+
+void SPCPackReader::expand(size_t index, std::vector<uint8_t>& image) const
+{
+	const Entry& entry = _spcs.at(index);
+	image = _base;
+
+	for (const SPCSamplePlacement& placement : entry.placements)
+	{
+		const std::vector<uint8_t>& sample = _samples.at(placement.sampleId);
+		if (placement.offset + sample.size() > image.size())
+			Logging::error("SPC \"" + entry.name + "\" places a sample out of bounds.");
+		std::memcpy(image.data() + placement.offset, sample.data(), sample.size());
+	}
+
+	for (const Run& run : entry.runs)
+	{
+		if (run.offset + run.data.size() > image.size())
+			Logging::error("SPC \"" + entry.name + "\" has data out of bounds.");
+		std::memcpy(image.data() + run.offset, run.data.data(), run.data.size());
+	}
+}
+
+void SPCPackReader::expandAll(const fs::path& output_dir) const
+{
+	std::vector<uint8_t> image;
+	for (size_t i = 0; i < _spcs.size(); i++)
+	{
+		// Names come from the pack file: keep them from pointing outside output_dir.
+		const fs::path name = fs::path(_spcs[i].name).lexically_normal();
+		if (name.empty() || name.has_root_name() || name.has_root_directory() || *name.begin() == "..")
+			Logging::error("SPC \"" + _spcs[i].name + "\" would be written outside of " + output_dir.string() + ".");
+
+		fs::path fname = output_dir / name;
+		fs::create_directories(fname.parent_path());
+		expand(i, image);
+		writeBinaryFile(fname, image);
+	}
+}
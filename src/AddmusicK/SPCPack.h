@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace AddMusic
+{
+
+/**
+ * @brief Where a pooled sample was copied into an SPC image.
+ */
+struct SPCSamplePlacement
+{
+	uint32_t sampleId;			// Caller-defined key of the sample (its index in the sample list, for instance).
+	uint32_t offset;			// Offset of the sample inside the SPC file.
+};
+
+/**
+ * @brief Writes a deduplicated bundle of SPC files.
+ *
+ * The image shared by every SPC (header, driver, DSP registers) is stored
+ * once, every distinct sample is stored once, and each SPC is described by
+ * its sample placements plus the byte runs where it differs from the shared
+ * image with those samples placed. SPCPackReader reconstructs the files
+ * bit-exactly.
+ *
+ * File layout (little endian): the "AMKSPCPK" magic and a 16-bit version,
+ * then a stream of records, each starting with a type byte:
+ * 	1 = base image (u32 size, data)
+ * 	2 = sample (u32 id, u32 size, data)
+ * 	3 = SPC (u16 name length, name, u16 placement count, {u32 id, u32 offset}...,
+ * 	    u32 run count, {u32 offset, u32 length, data}...)
+ * 	0 = end of pack
+ */
+class SPCPackWriter
+{
+public:
+	SPCPackWriter(const fs::path& packfile, const std::vector<uint8_t>& base);
+	~SPCPackWriter();
+
+	SPCPackWriter(const SPCPackWriter&) = delete;
+	SPCPackWriter& operator=(const SPCPackWriter&) = delete;
+
+	/**
+	 * @brief Stores a sample in the pool, unless a sample with this id was already stored.
+	 */
+	void addSample(uint32_t sampleId, const std::vector<uint8_t>& data);
+
+	/**
+	 * @brief Stores an SPC image. Every sample it references must have been added before.
+	 */
+	void addSPC(const std::string& name, const std::vector<uint8_t>& image, const std::vector<SPCSamplePlacement>& placements);
+
+	/**
+	 * @brief Writes the end marker and closes the file. A pack that is
+	 * destroyed without being closed is deleted.
+	 */
+	void close();
+
+	/**
+	 * @brief Amount of bytes written so far.
+	 */
+	uint64_t packedSize() const { return _written; }
+
+private:
+	void _write8(uint8_t value);
+	void _write16(uint16_t value);
+	void _write32(uint32_t value);
+	void _writeBytes(const uint8_t* data, size_t size);
+
+	fs::path _path;
+	std::ofstream _stream;
+	std::vector<uint8_t> _base;
+	std::map<uint32_t, std::vector<uint8_t>> _samples;
+	std::vector<uint8_t> _reference;		// Scratch buffer: base image with an SPC's samples placed.
+	uint64_t _written {0};
+	bool _closed {false};
+};
+
+/**
+ * @brief Reads a pack made by SPCPackWriter and expands its SPC files.
+ */
+class SPCPackReader
+{
+public:
+	SPCPackReader(const fs::path& packfile);
+
+	/**
+	 * @brief Amount of SPC files in the pack.
+	 */
+	size_t size() const { return _spcs.size(); }
+
+	/**
+	 * @brief Name (relative path) the SPC file was stored with.
+	 */
+	const std::string& name(size_t index) const { return _spcs.at(index).name; }
+
+	/**
+	 * @brief Reconstructs the SPC file at index into image.
+	 */
+	void expand(size_t index, std::vector<uint8_t>& image) const;
+
+	/**
+	 * @brief Writes every SPC file of the pack into output_dir, creating folders as needed.
+	 */
+	void expandAll(const fs::path& output_dir) const;
+
+private:
+	struct Run
+	{
+		uint32_t offset;
+		std::vector<uint8_t> data;
+	};
+
+	struct Entry
+	{
+		std::string name;
+		std::vector<SPCSamplePlacement> placements;
+		std::vector<Run> runs;
+	};
+
+	std::vector<uint8_t> _base;
+	std::map<uint32_t, std::vector<uint8_t>> _samples;
+	std::vector<Entry> _spcs;
+};
+
+}
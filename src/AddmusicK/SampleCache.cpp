@@ -0,0 +1,176 @@
+#include <cstring>
+
+#include "AddmusicLogging.h"
+#include "SampleCache.h"
+#include "Utility.h"
+
+using namespace AddMusic;
+
+static constexpr char SAMPLECACHE_MAGIC[] {"AMKSMPC1"};
+
+bool SampleCache::_stamp(const fs::path& file, int64_t& mtime, uint64_t& size)
+{
+	std::error_code ec;
+	auto time = fs::last_write_time(file, ec);
+	if (ec)
+		return false;
+	size = fs::file_size(file, ec);
+	if (ec)
+		return false;
+	mtime = time.time_since_epoch().count();
+	return true;
+}
+
+const std::vector<SampleCache::CachedSample>* SampleCache::find(const fs::path& file)
+{
+	auto it = _entries.find(file.string());
+	int64_t mtime;
+	uint64_t size;
+
+	if (it == _entries.end() || !_stamp(file, mtime, size) || it->second.mtime != mtime || it->second.size != size)
+	{
+		misses++;
+		return nullptr;
+	}
+
+	hits++;
+	return &it->second.samples;
+}
+
+void SampleCache::store(const fs::path& file, std::vector<CachedSample> samples)
+{
+	Entry entry;
+	if (!_stamp(file, entry.mtime, entry.size))
+		return;
+	entry.samples = std::move(samples);
+	_entries[file.string()] = std::move(entry);
+	_dirty = true;
+}
+
+bool SampleCache::load(const fs::path& cachefile)
+{
+	_entries.clear();
+	_dirty = false;
+
+	if (!fs::exists(cachefile))
+		return false;
+
+	std::vector<uint8_t> cache;
+	readBinaryFile(cachefile, cache);
+
+	size_t pos = 0;
+	bool truncated = false;
+	auto need = [&](size_t size)
+	{
+		if (pos + size > cache.size())
+		{
+			truncated = true;
+			pos = cache.size();
+		}
+		return !truncated;
+	};
+	auto read64 = [&]() -> uint64_t
+	{
+		uint64_t value = 0;
+		if (need(8))
+			for (int i = 0; i < 8; i++)
+				value |= (uint64_t)cache[pos++] << (i * 8);
+		return value;
+	};
+	auto read32 = [&]() -> uint32_t
+	{
+		uint32_t value = 0;
+		if (need(4))
+			for (int i = 0; i < 4; i++)
+				value |= (uint32_t)cache[pos++] << (i * 8);
+		return value;
+	};
+
+	if (cache.size() < 12 || std::memcmp(cache.data(), SAMPLECACHE_MAGIC, 8) != 0)
+	{
+		Logging::warning("Ignoring the sample cache at " + cachefile.string() + ": it is not a sample cache or was made by another version.");
+		return false;
+	}
+	pos = 8;
+
+	uint32_t entryCount = read32();
+	for (uint32_t e = 0; e < entryCount && !truncated; e++)
+	{
+		uint32_t nameLength = read32();
+		if (!need(nameLength))
+			break;
+		std::string name(cache.begin() + pos, cache.begin() + pos + nameLength);
+		pos += nameLength;
+
+		Entry entry;
+		entry.mtime = (int64_t)read64();
+		entry.size = read64();
+		// Every sample takes at least 8 bytes, which bounds the count before anything is allocated.
+		const uint32_t sampleCount = read32();
+		if (!need((size_t)sampleCount * 8))
+			break;
+		entry.samples.resize(sampleCount);
+		for (CachedSample& sample : entry.samples)
+		{
+			uint32_t flags = read32();
+			sample.empty = (flags & 0x10000) != 0;
+			sample.loopPoint = flags & 0xFFFF;
+			uint32_t dataLength = read32();
+			if (!need(dataLength))
+				break;
+			sample.data.assign(cache.begin() + pos, cache.begin() + pos + dataLength);
+			pos += dataLength;
+		}
+		if (!truncated)
+			_entries[name] = std::move(entry);
+	}
+
+	if (truncated)
+	{
+		Logging::warning("The sample cache at " + cachefile.string() + " is truncated. It will be rebuilt.");
+		_entries.clear();
+		return false;
+	}
+
+	Logging::debug("Loaded " + std::to_string(_entries.size()) + " entries from the sample cache at " + cachefile.string());
+	return true;
+}
+
+void SampleCache::save(const fs::path& cachefile)
+{
+	if (!_dirty)
+		return;
+
+	std::vector<uint8_t> cache(SAMPLECACHE_MAGIC, SAMPLECACHE_MAGIC + 8);
+	auto write64 = [&](uint64_t value)
+	{
+		for (int i = 0; i < 8; i++)
+			cache.push_back((value >> (i * 8)) & 0xFF);
+	};
+	auto write32 = [&](uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			cache.push_back((value >> (i * 8)) & 0xFF);
+	};
+
+	write32(_entries.size());
+	for (const auto& [name, entry] : _entries)
+	{
+		write32(name.size());
+		cache.insert(cache.end(), name.begin(), name.end());
+		write64(entry.mtime);
+		write64(entry.size);
+		write32(entry.samples.size());
+		for (const CachedSample& sample : entry.samples)
+		{
+			write32(sample.loopPoint | (sample.empty ? 0x10000 : 0));
+			write32(sample.data.size());
+			cache.insert(cache.end(), sample.data.begin(), sample.data.end());
+		}
+	}
+
+	writeBinaryFile(cachefile, cache);
+	_dirty = false;
+
+	Logging::debug("Saved " + std::to_string(_entries.size()) + " entries into the sample cache at " + cachefile.string());
+}
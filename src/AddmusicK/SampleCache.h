@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace AddMusic
+{
+
+/**
+ * @brief Persistent cache of parsed BRR samples and sample banks, meant to be
+ * shared between builds.
+ *
+ * Entries are keyed by file path and validated against the file's last write
+ * time and size, so an outdated entry is simply treated as a miss. The whole
+ * cache lives in a single packed file which is read once and rewritten only
+ * when something new was parsed.
+ */
+class SampleCache
+{
+public:
+	/**
+	 * @brief A parsed sample: payload without the loop header, plus its loop point.
+	 * For banks, empty slots are flagged instead of carrying data.
+	 */
+	struct CachedSample
+	{
+		std::vector<uint8_t> data;
+		uint16_t loopPoint {0};
+		bool empty {false};
+	};
+
+	/**
+	 * @brief Loads a cache file. A missing, corrupt or outdated file leaves
+	 * the cache empty. Returns whether anything was loaded.
+	 */
+	bool load(const fs::path& cachefile);
+
+	/**
+	 * @brief Writes the cache to a file, if it changed since it was loaded.
+	 */
+	void save(const fs::path& cachefile);
+
+	/**
+	 * @brief Returns the parsed samples of file if the cache is up to date
+	 * with it, or nullptr otherwise. A .brr file has one sample; a .bnk file
+	 * has one per slot.
+	 */
+	const std::vector<CachedSample>* find(const fs::path& file);
+
+	/**
+	 * @brief Stores the parsed samples of file, stamping the entry with the
+	 * file's current last write time and size.
+	 */
+	void store(const fs::path& file, std::vector<CachedSample> samples);
+
+	size_t hits {0};
+	size_t misses {0};
+
+private:
+	struct Entry
+	{
+		int64_t mtime;
+		uint64_t size;
+		std::vector<CachedSample> samples;
+	};
+
+	/**
+	 * Last write time and size of a file, as stored in the entries.
+	 */
+	static bool _stamp(const fs::path& file, int64_t& mtime, uint64_t& size);
+
+	std::unordered_map<std::string, Entry> _entries;
+	bool _dirty {false};
+};
+
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <climits>
+#include <set>
+
+#include "SampleLayout.h"
+
+using namespace AddMusic;
+
+// How far apart two samples can be in the order to be tried swapped.
+static constexpr size_t SWAP_WINDOW {8};
+
+SampleLayoutOptimizer::SampleLayoutOptimizer(const std::vector<int>& sampleSizes) :
+	sizes(sampleSizes),
+	usage(sampleSizes.size(), 0)
+{
+}
+
+void SampleLayoutOptimizer::addSong(const std::vector<unsigned short>& songSamples)
+{
+	std::set<unsigned short> used (songSamples.begin(), songSamples.end());
+	for (unsigned short sample : used)
+		usage[sample]++;
+	songs.emplace_back(used.begin(), used.end());
+}
+
+long long SampleLayoutOptimizer::fullUploadBytes() const
+{
+	long long total = 0;
+	for (const auto& song : songs)
+		for (unsigned short sample : song)
+			total += sizes[sample];
+	return songs.empty() ? 0 : total * (long long)(songs.size() - 1);
+}
+
+long long SampleLayoutOptimizer::uploadBytes(const std::vector<unsigned short>& order) const
+{
+	std::vector<int> rank (sizes.size(), INT_MAX);
+	for (size_t r = 0; r < order.size(); r++)
+		rank[order[r]] = r;
+
+	// Every (sample, offset from the base) placement of every song. Songs that
+	// share a placement don't upload that sample when going from one to the other.
+	std::vector<uint64_t> placements;
+	std::vector<unsigned short> song;
+	for (const auto& songSamples : songs)
+	{
+		song = songSamples;
+		std::sort(song.begin(), song.end(), [&](unsigned short a, unsigned short b) { return rank[a] != rank[b] ? rank[a] < rank[b] : a < b; });
+
+		uint64_t offset = 0;
+		for (unsigned short sample : song)
+		{
+			placements.push_back(((uint64_t)sample << 32) | offset);
+			offset += sizes[sample];
+		}
+	}
+	std::sort(placements.begin(), placements.end());
+
+	long long saved = 0;
+	for (size_t i = 0; i < placements.size();)
+	{
+		size_t j = i;
+		while (j < placements.size() && placements[j] == placements[i])
+			j++;
+		long long songCount = j - i;
+		saved += sizes[placements[i] >> 32] * songCount * (songCount - 1);
+		i = j;
+	}
+
+	return fullUploadBytes() - saved;
+}
+
+std::vector<unsigned short> SampleLayoutOptimizer::optimize(unsigned int maxPasses) const
+{
+	std::vector<unsigned short> shared, unshared;
+	for (size_t sample = 0; sample < usage.size(); sample++)
+	{
+		if (usage[sample] > 1)
+			shared.push_back(sample);
+		else if (usage[sample] == 1)
+			unshared.push_back(sample);
+	}
+
+	auto withUnshared = [&](std::vector<unsigned short> order)
+	{
+		order.insert(order.end(), unshared.begin(), unshared.end());
+		return order;
+	};
+
+	// Starting points: the most used samples first, the most bytes that could
+	// be saved first, and the most used samples first with the small ones ahead.
+	std::vector<std::vector<unsigned short>> candidates (3, shared);
+	std::stable_sort(candidates[0].begin(), candidates[0].end(), [&](unsigned short a, unsigned short b) { return usage[a] > usage[b]; });
+	std::stable_sort(candidates[1].begin(), candidates[1].end(), [&](unsigned short a, unsigned short b) { return (long long)usage[a] * sizes[a] > (long long)usage[b] * sizes[b]; });
+	std::stable_sort(candidates[2].begin(), candidates[2].end(), [&](unsigned short a, unsigned short b) { return usage[a] != usage[b] ? usage[a] > usage[b] : sizes[a] < sizes[b]; });
+
+	std::vector<unsigned short> best;
+	long long bestBytes = LLONG_MAX;
+	for (const auto& candidate : candidates)
+	{
+		long long bytes = uploadBytes(withUnshared(candidate));
+		if (bytes < bestBytes)
+		{
+			best = candidate;
+			bestBytes = bytes;
+		}
+	}
+
+	// Hill climbing: keep any swap that uploads fewer bytes.
+	for (unsigned int pass = 0; pass < maxPasses; pass++)
+	{
+		bool improved = false;
+		for (size_t i = 0; i < best.size(); i++)
+		{
+			for (size_t j = i + 1; j < best.size() && j <= i + SWAP_WINDOW; j++)
+			{
+				std::swap(best[i], best[j]);
+				long long bytes = uploadBytes(withUnshared(best));
+				if (bytes < bestBytes)
+				{
+					bestBytes = bytes;
+					improved = true;
+				}
+				else
+					std::swap(best[i], best[j]);
+			}
+		}
+		if (!improved)
+			break;
+	}
+
+	return withUnshared(best);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace AddMusic
+{
+
+/**
+ * @brief Searches the order in which resident samples are laid out in ARAM.
+ *
+ * Every song packs the samples it uses in this order, from the same base
+ * address. A sample is left in ARAM across a song change when both songs put
+ * it at the same address, that is, when the samples before it in both songs
+ * add up to the same size. The optimizer looks for the order that uploads
+ * the fewest bytes over every possible song change, as nothing tells which
+ * song follows which in the game.
+ *
+ * The search starts from a few orderings built from how many songs use each
+ * sample and how big it is, keeps the best one and then improves it by
+ * swapping samples that are close in the order until no swap helps. It is
+ * deterministic, so the same songs always get the same layout.
+ */
+class SampleLayoutOptimizer
+{
+public:
+	/**
+	 * @brief sampleSizes is the size in bytes of every sample, by sample ID.
+	 */
+	SampleLayoutOptimizer(const std::vector<int>& sampleSizes);
+
+	/**
+	 * @brief Adds a song by the samples it uses. Repeated samples count once.
+	 */
+	void addSong(const std::vector<unsigned short>& songSamples);
+
+	/**
+	 * @brief Best order found for the samples used by the songs added so far.
+	 * Samples used by a single song can't be shared and always go last.
+	 */
+	std::vector<unsigned short> optimize(unsigned int maxPasses = 16) const;
+
+	/**
+	 * @brief Bytes uploaded over every ordered pair of different songs if
+	 * their samples are laid out in this order.
+	 */
+	long long uploadBytes(const std::vector<unsigned short>& order) const;
+
+	/**
+	 * @brief Bytes uploaded if every song uploaded all of its samples on every song change.
+	 */
+	long long fullUploadBytes() const;
+
+private:
+	std::vector<int> sizes;
+	std::vector<std::vector<unsigned short>> songs;		// Distinct samples of each song.
+	std::vector<int> usage;								// Number of songs using each sample.
+};
+
+}
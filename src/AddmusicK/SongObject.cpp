@@ -0,0 +1,177 @@
+#include <cstring>
+
+#include "AddmusicLogging.h"
+#include "SongObject.h"
+#include "Utility.h"
+
+using namespace AddMusic;
+
+static constexpr char SONGOBJECT_MAGIC[] {"AMKSOBJ1"};
+
+void SongObject::setWord(size_t offset, uint16_t value)
+{
+	if (code.size() < offset + 2)
+		code.resize(offset + 2);
+	code[offset] = value & 0xFF;
+	code[offset + 1] = value >> 8;
+}
+
+void SongObject::setPointer(size_t offset, uint16_t target)
+{
+	setWord(offset, target);
+	relocations.push_back({(uint16_t)offset, RelocationType::Absolute16});
+}
+
+void SongObject::link(int base, std::vector<uint8_t>& out) const
+{
+	size_t start = out.size();
+	out.insert(out.end(), code.begin(), code.end());
+
+	for (const SongRelocation& reloc : relocations)
+	{
+		uint8_t* word = out.data() + start + reloc.offset;
+		switch (reloc.type)
+		{
+		case RelocationType::Absolute16:
+		{
+			int value = (word[0] | (word[1] << 8)) + base;
+			word[0] = value & 0xFF;
+			word[1] = (value >> 8) & 0xFF;
+			break;
+		}
+		}
+	}
+}
+
+int SongObject::symbolAddress(const std::string& symbol, int base) const
+{
+	auto it = symbols.find(symbol);
+	if (it == symbols.end())
+		return -1;
+	return it->second + base;
+}
+
+void SongObject::save(const fs::path& objectfile) const
+{
+	std::vector<uint8_t> object(SONGOBJECT_MAGIC, SONGOBJECT_MAGIC + 8);
+	auto write32 = [&](uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			object.push_back((value >> (i * 8)) & 0xFF);
+	};
+
+	write32(code.size());
+	object.insert(object.end(), code.begin(), code.end());
+
+	write32(relocations.size());
+	for (const SongRelocation& reloc : relocations)
+	{
+		object.push_back(reloc.offset & 0xFF);
+		object.push_back(reloc.offset >> 8);
+		object.push_back((uint8_t)reloc.type);
+	}
+
+	write32(symbols.size());
+	for (const auto& [name, offset] : symbols)
+	{
+		write32(name.size());
+		object.insert(object.end(), name.begin(), name.end());
+		object.push_back(offset & 0xFF);
+		object.push_back(offset >> 8);
+	}
+
+	writeBinaryFile(objectfile, object);
+}
+
+bool SongObject::load(const fs::path& objectfile)
+{
+	code.clear();
+	relocations.clear();
+	symbols.clear();
+
+	if (!fs::exists(objectfile))
+		return false;
+
+	std::vector<uint8_t> object;
+	readBinaryFile(objectfile, object);
+
+	size_t pos = 8;
+	bool truncated = false;
+	auto need = [&](size_t size)
+	{
+		if (pos + size > object.size())
+		{
+			truncated = true;
+			pos = object.size();
+		}
+		return !truncated;
+	};
+	auto read32 = [&]() -> uint32_t
+	{
+		uint32_t value = 0;
+		if (need(4))
+			for (int i = 0; i < 4; i++)
+				value |= (uint32_t)object[pos++] << (i * 8);
+		return value;
+	};
+	auto read16 = [&]() -> uint16_t
+	{
+		uint16_t value = 0;
+		if (need(2))
+		{
+			value = object[pos] | (object[pos + 1] << 8);
+			pos += 2;
+		}
+		return value;
+	};
+
+	if (object.size() < 8 || std::memcmp(object.data(), SONGOBJECT_MAGIC, 8) != 0)
+	{
+		Logging::warning(objectfile.string() + " is not a song object or was made by another version.");
+		return false;
+	}
+
+	uint32_t codeSize = read32();
+	if (need(codeSize))
+	{
+		code.assign(object.begin() + pos, object.begin() + pos + codeSize);
+		pos += codeSize;
+	}
+
+	// Every relocation takes 3 bytes, which bounds the count before anything is allocated.
+	const uint32_t relocationCount = read32();
+	if (need((size_t)relocationCount * 3))
+		relocations.resize(relocationCount);
+	for (SongRelocation& reloc : relocations)
+	{
+		reloc.offset = read16();
+		if (need(1))
+			reloc.type = (RelocationType)object[pos++];
+		if (reloc.type != RelocationType::Absolute16 || (size_t)reloc.offset + 2 > code.size())
+			truncated = true;
+		if (truncated)
+			break;
+	}
+
+	uint32_t symbolCount = truncated ? 0 : read32();
+	for (uint32_t s = 0; s < symbolCount && !truncated; s++)
+	{
+		uint32_t nameLength = read32();
+		if (!need(nameLength))
+			break;
+		std::string name(object.begin() + pos, object.begin() + pos + nameLength);
+		pos += nameLength;
+		symbols[name] = read16();
+	}
+
+	if (truncated)
+	{
+		Logging::warning("The song object at " + objectfile.string() + " is truncated or corrupt.");
+		code.clear();
+		relocations.clear();
+		symbols.clear();
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace AddMusic
+{
+
+/**
+ * @brief Kinds of fix-ups a song object asks the linker for.
+ */
+enum class RelocationType : uint8_t
+{
+	Absolute16 = 1,					// Little-endian word holding an offset into the object. The link address is added to it.
+};
+
+/**
+ * @brief A single fix-up of a song object.
+ */
+struct SongRelocation
+{
+	uint16_t offset {0};			// Position of the word to fix, from the start of the object.
+	RelocationType type {RelocationType::Absolute16};
+};
+
+/**
+ * @brief A compiled song that has not been placed in ARAM yet: its pointer
+ * table, instruments and channel data as a single block, plus every word that
+ * has to move along with it.
+ *
+ * Linking only touches the relocation entries, so the song can be placed at
+ * any address (e.g. again when a global song before it grows) without
+ * compiling its MML again. Objects can be saved to and loaded from disk,
+ * but nothing caches them between builds yet: a cached object alone would
+ * not bring back the samples and stats of its song.
+ */
+class SongObject
+{
+public:
+	/**
+	 * @brief Writes a constant little-endian word at offset.
+	 */
+	void setWord(size_t offset, uint16_t value);
+
+	/**
+	 * @brief Writes a pointer to target, an offset into this object, at offset
+	 * and records the relocation that turns it into an ARAM address.
+	 */
+	void setPointer(size_t offset, uint16_t target);
+
+	/**
+	 * @brief Appends the code of this object, linked at the ARAM address base, to out.
+	 */
+	void link(int base, std::vector<uint8_t>& out) const;
+
+	/**
+	 * @brief ARAM address of a symbol once linked at base, or -1 if there is no such symbol.
+	 */
+	int symbolAddress(const std::string& symbol, int base) const;
+
+	/**
+	 * @brief Writes the object to a file.
+	 */
+	void save(const fs::path& objectfile) const;
+
+	/**
+	 * @brief Reads an object file. Returns false, leaving the object empty,
+	 * if the file is missing or not a valid song object.
+	 */
+	bool load(const fs::path& objectfile);
+
+	std::vector<uint8_t> code;						// Song data as if it were linked at address 0.
+	std::vector<SongRelocation> relocations;
+	std::map<std::string, uint16_t> symbols;		// Named offsets into code.
+};
+
+}
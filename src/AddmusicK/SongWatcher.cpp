@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "AddmusicLogging.h"
+#include "SongWatcher.h"
+
+using namespace AddMusic;
+
+SongDependencies::SongDependencies(const fs::path& work_dir)
+{
+	listFiles.insert(_normal(work_dir / DEFAULT_SONGLIST_FILENAME));
+	listFiles.insert(_normal(work_dir / DEFAULT_SAMPLELIST_FILENAME));
+	listFiles.insert(_normal(work_dir / DEFAULT_SFXLIST_FILENAME));
+}
+
+fs::path SongDependencies::_normal(const fs::path& file)
+{
+	// Not canonical(): deleted files have to match as well.
+	return fs::absolute(file).lexically_normal();
+}
+
+void SongDependencies::setSong(const fs::path& song, const std::vector<fs::path>& samples, bool compiled)
+{
+	Song& entry = songsByFile[_normal(song)];
+	entry.samples.clear();
+	for (const fs::path& sample : samples)
+		entry.samples.insert(_normal(sample));
+	entry.compiled = compiled;
+}
+
+SongDependencies::Rebuild SongDependencies::affectedBy(const std::vector<fs::path>& changed) const
+{
+	Rebuild rebuild;
+	for (const fs::path& file : changed)
+	{
+		const fs::path normal = _normal(file);
+		if (listFiles.count(normal))
+		{
+			rebuild.reload = true;
+			for (const auto& [song, entry] : songsByFile)
+				rebuild.songs.insert(song);
+			continue;
+		}
+
+		if (songsByFile.count(normal))
+			rebuild.songs.insert(normal);
+
+		std::string extension = normal.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		const bool isSample = extension == ".brr" || extension == ".bnk";
+
+		for (const auto& [song, entry] : songsByFile)
+		{
+			if (entry.samples.count(normal))
+			{
+				rebuild.reload = true;
+				rebuild.songs.insert(song);
+			}
+			else if (isSample && !entry.compiled)
+				rebuild.songs.insert(song);
+		}
+	}
+	return rebuild;
+}
+
+std::set<fs::path> SongDependencies::folders() const
+{
+	std::set<fs::path> folders;
+	for (const fs::path& list : listFiles)
+		folders.insert(list.parent_path());
+	for (const auto& [song, entry] : songsByFile)
+	{
+		folders.insert(song.parent_path());
+		for (const fs::path& sample : entry.samples)
+			folders.insert(sample.parent_path());
+	}
+	return folders;
+}
+
+std::set<fs::path> SongDependencies::songs() const
+{
+	std::set<fs::path> songs;
+	for (const auto& [song, entry] : songsByFile)
+		songs.insert(song);
+	return songs;
+}
+
+SongWatcher::SongWatcher(const fs::path& work_dir, const std::vector<fs::path>& songs, const fs::path& output_folder, EnvironmentOptions opts) :
+	work_dir(work_dir),
+	output_folder(output_folder),
+	options(opts),
+	dependencies(work_dir)
+{
+	for (const fs::path& song : songs)
+		dependencies.setSong(song, {}, false);
+}
+
+void SongWatcher::_reload()
+{
+	// Only one environment can have the driver extracted at a time.
+	spc.reset();
+	spc = std::make_unique<SPCEnvironment>(work_dir, options);
+	spc->prepare(output_folder);
+}
+
+void SongWatcher::_compile(const fs::path& song)
+{
+	const auto start = std::chrono::steady_clock::now();
+	try
+	{
+		std::vector<uint8_t> SPC = spc->compileSPC(song);
+		const fs::path spcFile = output_folder / (song.stem().string() + ".spc");
+		writeBinaryFile(spcFile, SPC);
+		dependencies.setSong(song, spc->lastSongSamples(), true);
+
+		const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		Logging::info("Wrote " + spcFile.string() + " in " + std::to_string(milliseconds) + " ms.");
+	}
+	catch (const std::exception& e)
+	{
+		// Keep watching: the next save may fix it.
+		dependencies.setSong(song, {}, false);
+		Logging::warning(song.filename().string() + " could not be compiled: " + e.what());
+	}
+}
+
+void SongWatcher::_rebuild(const SongDependencies::Rebuild& rebuild)
+{
+	if (rebuild.songs.empty() && !rebuild.reload)
+		return;
+
+	if (rebuild.reload || !spc)
+	{
+		try
+		{
+			_reload();
+		}
+		catch (const std::exception& e)
+		{
+			spc.reset();
+			Logging::warning(std::string("The environment could not be prepared: ") + e.what());
+			return;
+		}
+	}
+
+	for (const fs::path& song : rebuild.songs)
+		_compile(song);
+}
+
+#ifdef __linux__
+
+void SongWatcher::watch()
+{
+	SongDependencies::Rebuild everything;
+	everything.reload = true;
+	everything.songs = dependencies.songs();
+	_rebuild(everything);
+
+	const int inotify = inotify_init1(IN_CLOEXEC);
+	if (inotify < 0)
+		throw std::runtime_error("Could not start watching files.");
+
+	std::map<int, fs::path> watched;
+	auto watchFolder = [&](const fs::path& folder)
+	{
+		if (!fs::is_directory(folder))
+			return;
+		const int wd = inotify_add_watch(inotify, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE);
+		if (wd >= 0)
+			watched[wd] = folder;
+	};
+	auto watchAll = [&]()
+	{
+		for (const fs::path& folder : dependencies.folders())
+			watchFolder(folder);
+
+		// New samples may show up anywhere under samples, #path folders included.
+		const fs::path samplesFolder = work_dir / "samples";
+		watchFolder(samplesFolder);
+		if (fs::is_directory(samplesFolder))
+			for (const auto& entry : fs::recursive_directory_iterator(samplesFolder))
+				if (entry.is_directory())
+					watchFolder(entry.path());
+	};
+	watchAll();
+	Logging::info("Watching for changes. Stop with Ctrl+C.");
+
+	alignas(inotify_event) char buffer[4096];
+	while (true)
+	{
+		// Wait for a change, then for the rest of the save to settle.
+		std::vector<fs::path> changed;
+		int timeout = -1;
+		pollfd events {inotify, POLLIN, 0};
+		while (poll(&events, 1, timeout) > 0)
+		{
+			const ssize_t length = read(inotify, buffer, sizeof(buffer));
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const inotify_event* event = (const inotify_event*)(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+				if (event->len == 0 || watched.count(event->wd) == 0)
+					continue;
+
+				const fs::path path = watched[event->wd] / event->name;
+				if (event->mask & IN_ISDIR)
+				{
+					if (event->mask & (IN_CREATE | IN_MOVED_TO))
+						watchFolder(path);
+				}
+				else if (!(event->mask & IN_CREATE))
+					changed.push_back(path);
+			}
+			timeout = SETTLE_MILLISECONDS;
+		}
+
+		_rebuild(dependencies.affectedBy(changed));
+		watchAll();
+	}
+}
+
+#else
+
+void SongWatcher::watch()
+{
+	throw std::runtime_error("Watching files needs inotify, which is only available on Linux.");
+}
+
+#endif
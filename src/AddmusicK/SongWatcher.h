@@ -0,0 +1,96 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "SPCEnvironment.h"
+
+namespace AddMusic
+{
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Which files every watched song was built from, to tell which songs
+ * a change affects.
+ *
+ * Samples are kept by name once an environment loads them, so a changed
+ * sample needs the environment to be prepared again. So does a changed list
+ * file, which affects every song.
+ */
+class SongDependencies
+{
+public:
+	struct Rebuild
+	{
+		bool reload {false};			// Prepare the environment again first.
+		std::set<fs::path> songs;
+	};
+
+	SongDependencies(const fs::path& work_dir);
+
+	/**
+	 * @brief Records the sample files a song used, or that it failed to
+	 * compile, in which case any new sample may fix it.
+	 */
+	void setSong(const fs::path& song, const std::vector<fs::path>& samples, bool compiled);
+
+	/**
+	 * @brief What to rebuild after these files changed.
+	 */
+	Rebuild affectedBy(const std::vector<fs::path>& changed) const;
+
+	/**
+	 * @brief Folders holding the songs, their samples and the lists.
+	 */
+	std::set<fs::path> folders() const;
+
+	std::set<fs::path> songs() const;
+
+private:
+	struct Song
+	{
+		std::set<fs::path> samples;
+		bool compiled {false};
+	};
+
+	static fs::path _normal(const fs::path& file);
+
+	std::set<fs::path> listFiles;
+	std::map<fs::path, Song> songsByFile;
+};
+
+/**
+ * @brief Recompiles songs to SPC whenever they, their samples or the lists
+ * are saved, keeping the environment prepared between saves. Linux only, as
+ * it relies on inotify.
+ */
+class SongWatcher
+{
+public:
+	static constexpr int SETTLE_MILLISECONDS {100};		// Quiet time after a change before rebuilding, as editors save in several steps.
+
+	SongWatcher(const fs::path& work_dir, const std::vector<fs::path>& songs, const fs::path& output_folder, EnvironmentOptions opts = EnvironmentOptions());
+
+	/**
+	 * @brief Compiles every song, then keeps recompiling what changes until
+	 * the process is stopped.
+	 */
+	void watch();
+
+private:
+	void _reload();
+	void _compile(const fs::path& song);
+	void _rebuild(const SongDependencies::Rebuild& rebuild);
+
+	fs::path work_dir;
+	fs::path output_folder;
+	EnvironmentOptions options;
+	SongDependencies dependencies;
+	std::unique_ptr<SPCEnvironment> spc;
+};
+
+}
@@ -9,6 +9,7 @@
 #include "SoundEffect.h"
 #include "asarBinding.h"
 #include "SPCEnvironment.h"
+#include "Utility.h"
 
 using namespace AddMusic;
 
@@ -380,8 +381,6 @@ void SoundEffect::compile(SPCEnvironment* spc_)
 
 	if (spc->soundEffects[bank][index].add0)
 		append(0x00);
-
-	compileASM();
 }
 
 void SoundEffect::parseASM()
@@ -425,70 +424,65 @@ void SoundEffect::parseASM()
 	asmNames.push_back(tempname);
 }
 
-void SoundEffect::compileASM()
+std::string SoundEffect::labelPrefix() const
 {
-	//int codeSize = 0;
+	return "AMKSFX" + std::to_string(bank) + "_" + hex<2>(index);
+}
 
-	std::vector<unsigned int> codePositions;
+void SoundEffect::writeASM(std::ostream& out) const
+{
+	const std::string prefix = labelPrefix();
 
-	for (unsigned int i = 0; i < asmStrings.size(); i++)
+	// The data only reserves room here; jsr pointers are fixed by linkASM().
+	out << prefix << ":\n";
+	for (size_t i = 0; i < data.size(); i += 16)
 	{
-		codePositions.push_back(code.size());
-
-		std::stringstream asmCode;
-		asmCode << 
-			"arch spc700-raw\n\n"
-
-			"org $000000\n" 
-			"incsrc \"main.asm\"\n"
-			"base $" << hex4 << posInARAM + code.size() + data.size() << "\n\n"
-			
-			"org $008000\n\n" <<
-
-			asmStrings[i];
-		
-		writeTextFile(spc->driver_builddir / "tempsfx.asm", asmCode.str());
-		AsarBinding asar_sfx (spc->driver_builddir / "tempsfx.asm");
-		if (!asar_sfx.compileToFile(spc->driver_builddir / "tempsfx.bin"))
-		{
-			asar_sfx.printErrors();
-			Logging::error("asar reported an error while assembling SFX binaries.");
-			return;
-		}
-		
-		// writeTextFile("temp.asm", asmCode.str());
-
-		// if (!asarCompileToBIN("temp.asm", "temp.bin"))
-		// 	throw fileError("asar reported an error.  Refer to temp.log for details.", AddmusicErrorcode::COMPILEASM_ERROR, false);
+		out << "db ";
+		for (size_t j = i; j < std::min(i + 16, data.size()); j++)
+			out << (j == i ? "$" : ",$") << hex<2>(data[j]);
+		out << "\n";
+	}
 
-		std::vector<uint8_t> temp;
-		readBinaryFile(spc->driver_builddir / "tempsfx.bin", temp);
+	// Each block gets its own namespace, so blocks from different sound effects can reuse label names.
+	for (unsigned int i = 0; i < asmStrings.size(); i++)
+	{
+		out << prefix << "_ASM" << i << ":\n"
+			"namespace " << prefix << "_ASM" << i << "\n" <<
+			asmStrings[i] << "\n"
+			"namespace off\n";
+	}
+	out << prefix << "_End:\n\n";
+}
 
-		// openFile("temp.bin", temp);
+void SoundEffect::linkASM(const AsarBinding& asar, const std::vector<uint8_t>& bin, int fileOffset)
+{
+	const std::string prefix = labelPrefix();
+	const int start = asar.getLabelValue(prefix);
+	const int end = asar.getLabelValue(prefix + "_End");
 
-		temp.erase(temp.begin(), temp.begin() + 0x08000);
+	if (start < 0 || end < 0 || end + fileOffset > (int)bin.size())
+		Logging::error("Could not find the assembled code of sound effect " + prefix + ".", this);
 
-		for (unsigned int j = 0; j < temp.size(); j++)
-			code.push_back(temp[j]);
-	}
+	posInARAM = start;
+	code.assign(bin.begin() + start + data.size() + fileOffset, bin.begin() + end + fileOffset);
 
 	for (unsigned int i = 0; i < asmStrings.size(); i++)
 	{
-		int k = -1;
+		const int blockPos = asar.getLabelValue(prefix + "_ASM" + std::to_string(i));
+
+		bool matched = false;
 		for (unsigned int j = 0; j < jmpNames.size(); j++)
 		{
 			if (asmNames[i] == jmpNames[j])
 			{
-				k = j;
-				break;
+				data[jmpPoses[j]] = blockPos & 0xFF;
+				data[jmpPoses[j]+1] = blockPos >> 8;
+				matched = true;
 			}
 		}
 
-		if (k == -1)
+		if (!matched)
 			Logging::warning("Could not match asm and jsr names.", this);
-
-		data[jmpPoses[k]] = (posInARAM + data.size() + codePositions[k]) & 0xFF;
-		data[jmpPoses[k]+1] = (posInARAM + data.size() + codePositions[k]) >> 8;
 	}
 }
 
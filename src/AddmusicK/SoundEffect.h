@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <ostream>
 #include <initializer_list>
 
 #include "MMLBase.h"
@@ -11,6 +12,7 @@ namespace AddMusic
 {
 
 class SPCEnvironment;
+class AsarBinding;
 
 /**
  * @brief Representation of an AddMusic sound effect.
@@ -22,7 +24,25 @@ class SoundEffect : public MMLBase
 
 public:
 	std::string &getEffectiveName();		// Returns name or pointName.
-	void compile(SPCEnvironment* spc_);
+	void compile(SPCEnvironment* spc_);		// Parses the sound effect. Inline ASM is assembled later, along with every other SFX.
+
+	/**
+	 * @brief Writes this sound effect's data and inline ASM blocks into a
+	 * batched assembly file, wrapped in labels starting with labelPrefix().
+	 */
+	void writeASM(std::ostream& out) const;
+
+	/**
+	 * @brief Takes this sound effect's position, code and jsr targets from
+	 * the assembled batch. fileOffset converts ARAM addresses into offsets
+	 * of bin.
+	 */
+	void linkASM(const AsarBinding& asar, const std::vector<uint8_t>& bin, int fileOffset);
+
+	/**
+	 * @brief Unique label of this sound effect in the batched assembly.
+	 */
+	std::string labelPrefix() const;
 
 protected:
 	inline void append(unsigned char value)
@@ -57,7 +77,6 @@ private:
 
 	// Parser sub-methods
 	void parseASM();						// Generates the strings which will compiled afterwards
-	void compileASM();						// Pushes the compilable strings to ASAR
 
 	void parseJSR();
 	void parseDefine();
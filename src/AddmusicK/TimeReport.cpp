@@ -0,0 +1,174 @@
+#include "TimeReport.h"
+#include "Utility.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace AddMusic;
+
+TimeReport::Scope::Scope(TimeReport* report, const char* phase, std::string item) :
+	report(report),
+	phase(phase),
+	item(std::move(item))
+{
+	if (!report)
+		return;
+
+	if (report->running++ == 0)
+		_resetPeakRSS();
+	start = std::chrono::steady_clock::now();
+}
+
+TimeReport::Scope::~Scope()
+{
+	if (!report)
+		return;
+
+	report->_record(phase, std::move(item), start);
+	report->running--;
+}
+
+TimeReport::TimeReport() :
+	origin(std::chrono::steady_clock::now())
+{
+}
+
+void TimeReport::_record(const char* phase, std::string item, std::chrono::steady_clock::time_point start)
+{
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+
+	const auto end = std::chrono::steady_clock::now();
+	const size_t peak = peakRSS();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto thread = threads.emplace(std::this_thread::get_id(), threads.size() + 1).first;
+	events.push_back({phase, std::move(item), duration_cast<microseconds>(start - origin).count(), duration_cast<microseconds>(end - start).count(), peak, thread->second});
+}
+
+size_t TimeReport::peakRSS()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	// VmHWM follows resets through clear_refs, unlike getrusage().
+	std::ifstream status ("/proc/self/status");
+	for (std::string line; std::getline(status, line);)
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return std::stoull(line.substr(6)) * 1024;
+
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#if defined(__APPLE__)
+	return usage.ru_maxrss;
+#else
+	return usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+void TimeReport::_resetPeakRSS()
+{
+#if defined(__linux__)
+	std::ofstream clearRefs ("/proc/self/clear_refs");
+	clearRefs << "5";
+#endif
+}
+
+std::string TimeReport::summary() const
+{
+	struct Phase
+	{
+		const char* name;
+		int64_t firstStart;
+		size_t calls {0};
+		int64_t total {0};
+		int64_t longest {0};
+		size_t peakRSS {0};
+		std::string slowest;
+	};
+
+	std::vector<Phase> phases;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::string, size_t> byName;
+		for (const Event& event : events)
+		{
+			auto found = byName.emplace(event.phase, phases.size());
+			if (found.second)
+			{
+				Phase phase;
+				phase.name = event.phase;
+				phase.firstStart = event.start;
+				phases.push_back(phase);
+			}
+
+			Phase& phase = phases[found.first->second];
+			phase.firstStart = std::min(phase.firstStart, event.start);
+			phase.calls++;
+			phase.total += event.duration;
+			phase.peakRSS = std::max(phase.peakRSS, event.peakRSS);
+			if (event.duration >= phase.longest)
+			{
+				phase.longest = event.duration;
+				phase.slowest = event.item;
+			}
+		}
+	}
+	std::sort(phases.begin(), phases.end(), [](const Phase& a, const Phase& b) { return a.firstStart < b.firstStart; });
+
+	size_t nameWidth = 5;
+	for (const Phase& phase : phases)
+		nameWidth = std::max(nameWidth, std::string(phase.name).size());
+
+	std::stringstream table;
+	table << std::fixed << std::setprecision(1) << std::left << std::setw(nameWidth) << "Phase" << std::right
+		<< std::setw(8) << "Calls" << std::setw(12) << "Total ms" << std::setw(12) << "Max ms" << std::setw(14) << "Peak RSS MB" << "   Slowest\n";
+	for (const Phase& phase : phases)
+	{
+		table << std::left << std::setw(nameWidth) << phase.name << std::right
+			<< std::setw(8) << phase.calls
+			<< std::setw(12) << phase.total / 1000.0
+			<< std::setw(12) << phase.longest / 1000.0
+			<< std::setw(14) << phase.peakRSS / (1024.0 * 1024.0)
+			<< "   " << (phase.calls > 1 ? phase.slowest : "") << "\n";
+	}
+	return table.str();
+}
+
+std::string TimeReport::chromeTrace() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::stringstream trace;
+	trace << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const Event& event = events[i];
+		const std::string name = event.item.empty() ? event.phase : std::string(event.phase) + ": " + event.item;
+		trace << "{\"name\": " << jsonString(name) << ", \"cat\": " << jsonString(event.phase) << ", \"ph\": \"X\""
+			<< ", \"ts\": " << event.start << ", \"dur\": " << event.duration << ", \"pid\": 1, \"tid\": " << event.thread
+			<< ", \"args\": {\"peak_rss_kb\": " << event.peakRSS / 1024 << "}}" << (i + 1 < events.size() ? "," : "") << "\n";
+	}
+	trace << "]}\n";
+	return trace.str();
+}
+
+void TimeReport::write(const fs::path& traceFile) const
+{
+	writeTextFile(traceFile, chromeTrace());
+	writeTextFile(fs::path(traceFile).replace_extension(".txt"), summary());
+}
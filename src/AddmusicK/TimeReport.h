@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace AddMusic
+{
+
+/**
+ * @brief Wall time and peak resident memory of the phases of a build.
+ *
+ * Phases are timed with Scope objects, from any thread. The report can be
+ * printed as a summary table with one row per phase, or exported as a Chrome
+ * trace (chrome://tracing, Perfetto) with one event per timed scope.
+ *
+ * The peak RSS of a phase is the process's resident memory high-water mark
+ * when it ends. On Linux the mark is reset whenever a phase starts while no
+ * other one is running, so top-level phases report their own peak. Elsewhere
+ * it only ever grows.
+ */
+class TimeReport
+{
+public:
+	/**
+	 * @brief Times the enclosing block as one run of a phase. The item tells
+	 * runs apart, e.g. which song was compiled. Does nothing if report is null.
+	 */
+	class Scope
+	{
+	public:
+		Scope(TimeReport* report, const char* phase, std::string item = "");
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		TimeReport* report;
+		const char* phase;
+		std::string item;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	TimeReport();
+
+	/**
+	 * @brief Calls, total and longest time, peak RSS and slowest item of every
+	 * phase, in the order they first ran.
+	 */
+	std::string summary() const;
+
+	/**
+	 * @brief Every timed scope in Chrome's trace_event JSON format.
+	 */
+	std::string chromeTrace() const;
+
+	/**
+	 * @brief Writes the Chrome trace to traceFile, and the summary next to it
+	 * with a .txt extension.
+	 */
+	void write(const fs::path& traceFile) const;
+
+	/**
+	 * @brief Resident memory high-water mark of the process, in bytes, or 0
+	 * if the platform doesn't tell.
+	 */
+	static size_t peakRSS();
+
+private:
+	struct Event
+	{
+		const char* phase;
+		std::string item;
+		int64_t start;					// Microseconds since the report was created.
+		int64_t duration;				// Microseconds.
+		size_t peakRSS;
+		unsigned int thread;			// 1 for the first thread that reported, 2 for the next one...
+	};
+
+	void _record(const char* phase, std::string item, std::chrono::steady_clock::time_point start);
+	static void _resetPeakRSS();
+
+	std::chrono::steady_clock::time_point origin;
+	std::atomic<int> running {0};		// Scopes open right now, in every thread.
+
+	mutable std::mutex mutex;
+	std::vector<Event> events;
+	std::map<std::thread::id, unsigned int> threads;
+};
+
+}
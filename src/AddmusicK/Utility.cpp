@@ -1,3 +1,4 @@
+#include <array>
 #include <cstdio>
 #include <fstream>
 #include <exception>
@@ -49,3 +50,41 @@ void AddMusic::deleteDir(const fs::path& dir_path)
         fs::remove(dir_path);
     }
 }
+
+uint32_t AddMusic::crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+	static const std::array<uint32_t, 256> table = []()
+	{
+		std::array<uint32_t, 256> t {};
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+std::string AddMusic::jsonString(const std::string& str)
+{
+	std::stringstream quoted;
+	quoted << '"';
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			quoted << '\\' << c;
+		else if ((unsigned char)c < 0x20)
+			quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+		else
+			quoted << c;
+	}
+	quoted << '"';
+	return quoted.str();
+}
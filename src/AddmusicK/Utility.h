@@ -185,6 +185,17 @@ inline void replaceHexValue(T value, const std::string &tag, std::string &str)
 		throw std::runtime_error(std::string("Error: Could not find \"") + tag + "\" inside your string.");
 }
 
+/**
+ * @brief Standard CRC-32 (the one used by ZIP and PNG) of a block of data.
+ * Pass a previous result as crc to checksum data in several chunks.
+ */
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+/**
+ * @brief Quotes and escapes a string for a JSON document.
+ */
+std::string jsonString(const std::string& str);
+
 /**
  * @brief Recursively copies a folder and its contents. Will overwrite files
  * and directory contents, but won't delete any new files in dst.
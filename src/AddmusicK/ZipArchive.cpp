@@ -0,0 +1,141 @@
+#include <ctime>
+#include <limits>
+
+#include "AddmusicLogging.h"
+#include "ZipArchive.h"
+#include "Utility.h"
+
+using namespace AddMusic;
+
+ZipWriter::ZipWriter(const fs::path& zipfile) :
+	_path(zipfile),
+	_streamBuffer(1 << 20)
+{
+	// A big buffer, so hundreds of 64 KB entries end up being a handful of writes.
+	_stream.rdbuf()->pubsetbuf(_streamBuffer.data(), _streamBuffer.size());
+	_stream.open(zipfile, std::ios::binary | std::ios::trunc);
+	if (!_stream)
+		throw fs::filesystem_error("File cannot be written.", zipfile, std::make_error_code(std::errc::permission_denied));
+
+	// Every entry gets the creation time of the archive, in MS-DOS format.
+	time_t t = time(NULL);
+	const tm* lt = localtime(&t);
+	_dosTime = (lt->tm_hour << 11) | (lt->tm_min << 5) | (lt->tm_sec / 2);
+	_dosDate = ((std::max(lt->tm_year - 80, 0)) << 9) | ((lt->tm_mon + 1) << 5) | lt->tm_mday;
+}
+
+ZipWriter::~ZipWriter()
+{
+	// Never finalize here: an archive that was not closed is missing entries,
+	// most likely because an exception is unwinding, and must not look valid.
+	if (!_closed)
+	{
+		_stream.close();
+		std::error_code ec;
+		fs::remove(_path, ec);
+	}
+}
+
+void ZipWriter::_write16(uint16_t value)
+{
+	const char bytes[2] {(char)(value & 0xFF), (char)(value >> 8)};
+	_stream.write(bytes, 2);
+}
+
+void ZipWriter::_write32(uint32_t value)
+{
+	_write16(value & 0xFFFF);
+	_write16(value >> 16);
+}
+
+void ZipWriter::addFile(const std::string& name, const uint8_t* data, size_t size)
+{
+	if (_closed)
+		throw std::runtime_error("Cannot add \"" + name + "\" to the closed archive " + _path.string());
+
+	// No ZIP64 support: these archives hold SPCs, not gigabytes of data.
+	if (_entries.size() >= 0xFFFF || size + _offset + name.size() + 30 > std::numeric_limits<uint32_t>::max())
+		Logging::error("The archive " + _path.string() + " exceeded the size or entry limits of the ZIP format.");
+
+	Entry entry {name, crc32(data, size), (uint32_t)size, (uint32_t)_offset};
+
+	// Local file header.
+	_write32(0x04034B50);
+	_write16(10);					// Version needed to extract (1.0, stored)
+	_write16(0x0800);				// Flags: UTF-8 names
+	_write16(0);					// Compression method: stored
+	_write16(_dosTime);
+	_write16(_dosDate);
+	_write32(entry.crc);
+	_write32(entry.size);			// Compressed size
+	_write32(entry.size);			// Uncompressed size
+	_write16(name.size());
+	_write16(0);					// Extra field length
+	_stream.write(name.data(), name.size());
+	_stream.write(reinterpret_cast<const char*>(data), size);
+
+	_offset += 30 + name.size() + size;
+	_entries.push_back(std::move(entry));
+
+	if (!_stream)
+		throw fs::filesystem_error("File cannot be written.", _path, std::make_error_code(std::errc::io_error));
+}
+
+void ZipWriter::addFile(const std::string& name, const std::vector<uint8_t>& data)
+{
+	addFile(name, data.data(), data.size());
+}
+
+void ZipWriter::addFile(const std::string& name, const std::string& text)
+{
+	addFile(name, reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+void ZipWriter::close()
+{
+	if (_closed)
+		return;
+
+	const uint64_t centralDirectoryOffset = _offset;
+
+	for (const Entry& entry : _entries)
+	{
+		_write32(0x02014B50);
+		_write16(20);				// Version made by
+		_write16(10);				// Version needed to extract
+		_write16(0x0800);			// Flags: UTF-8 names
+		_write16(0);				// Compression method: stored
+		_write16(_dosTime);
+		_write16(_dosDate);
+		_write32(entry.crc);
+		_write32(entry.size);
+		_write32(entry.size);
+		_write16(entry.name.size());
+		_write16(0);				// Extra field length
+		_write16(0);				// Comment length
+		_write16(0);				// Disk number
+		_write16(0);				// Internal attributes
+		_write32(0);				// External attributes
+		_write32(entry.offset);
+		_stream.write(entry.name.data(), entry.name.size());
+
+		_offset += 46 + entry.name.size();
+	}
+
+	// End of central directory record.
+	_write32(0x06054B50);
+	_write16(0);
+	_write16(0);
+	_write16(_entries.size());
+	_write16(_entries.size());
+	_write32(_offset - centralDirectoryOffset);
+	_write32(centralDirectoryOffset);
+	_write16(0);					// Comment length
+
+	// Only an archive that reached the disk whole counts as closed; otherwise
+	// the destructor deletes it.
+	_stream.close();
+	if (!_stream)
+		throw fs::filesystem_error("File cannot be written.", _path, std::make_error_code(std::errc::io_error));
+	_closed = true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace AddMusic
+{
+
+/**
+ * @brief Minimal store-only (uncompressed) ZIP writer.
+ *
+ * Entries are streamed to the archive in a single sequential write as they
+ * are added, and the central directory is appended by close(). An archive
+ * that is never closed is deleted, so an interrupted build leaves no
+ * truncated .zip behind.
+ * Meant for bundling a large amount of generated files (SPCs, mostly) without
+ * creating one file per item.
+ */
+class ZipWriter
+{
+public:
+	/**
+	 * @brief Creates (or truncates) a ZIP archive at zipfile.
+	 */
+	ZipWriter(const fs::path& zipfile);
+
+	/**
+	 * @brief Deletes the partial archive if close() has not been called.
+	 */
+	~ZipWriter();
+
+	ZipWriter(const ZipWriter&) = delete;
+	ZipWriter& operator=(const ZipWriter&) = delete;
+
+	/**
+	 * @brief Appends a file to the archive. Name separators must be forward slashes.
+	 */
+	void addFile(const std::string& name, const uint8_t* data, size_t size);
+	void addFile(const std::string& name, const std::vector<uint8_t>& data);
+	void addFile(const std::string& name, const std::string& text);
+
+	/**
+	 * @brief Writes the central directory and closes the file. No more
+	 * entries can be added afterwards.
+	 */
+	void close();
+
+	/**
+	 * @brief Amount of entries added so far.
+	 */
+	size_t entryCount() const { return _entries.size(); }
+
+private:
+	struct Entry
+	{
+		std::string name;
+		uint32_t crc;
+		uint32_t size;
+		uint32_t offset;		// Offset of the local file header.
+	};
+
+	void _write16(uint16_t value);
+	void _write32(uint32_t value);
+
+	fs::path _path;
+	std::ofstream _stream;
+	std::vector<char> _streamBuffer;
+	std::vector<Entry> _entries;
+	uint64_t _offset {0};
+	uint16_t _dosTime {0};
+	uint16_t _dosDate {0};
+	bool _closed {false};
+};
+
+}
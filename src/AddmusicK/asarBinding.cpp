@@ -49,6 +49,7 @@ bool AsarBinding::compileToBin()
 	asar_stdout.clear();
 	asar_stderr.clear();
 	_compiledbin.clear();
+	_labels.clear();
 
 	// auto binOutput {std::make_unique< uint8_t[] >(buflen)};		// C++ fashion array allocation. Deletion is automatic, don't worry.
 	uint8_t* binOutput = new uint8_t[buflen]();
@@ -76,6 +77,10 @@ bool AsarBinding::compileToBin()
 	
 	_compiledbin.assign(binOutput, binOutput + binlen);
 	delete[] (binOutput);
+
+	const labeldata* labels = asar_getalllabels(&count);
+	for (currentCount = 0; currentCount != count; currentCount++)
+		_labels[labels[currentCount].name] = labels[currentCount].location;
 	
 	return true;
 }
@@ -152,6 +157,17 @@ std::vector<uint8_t> AsarBinding::getCompiledBin() const
 	return _compiledbin;
 }
 
+const std::map<std::string, int>& AsarBinding::getLabels() const
+{
+	return _labels;
+}
+
+int AsarBinding::getLabelValue(const std::string& label) const
+{
+	auto it = _labels.find(label);
+	return (it == _labels.end()) ? -1 : it->second;
+}
+
 std::string AsarBinding::getStderr() const
 {
 	std::string retval;
@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <exception>
 #include <vector>
+#include <map>
 #include <cstdint>
 
 namespace AddMusic
@@ -84,6 +85,18 @@ public:
 	 */
 	size_t getProgramSize() const;
 
+	/**
+	 * @brief Labels defined by the last successful compilation, with their
+	 * (base-adjusted) addresses.
+	 */
+	const std::map<std::string, int>& getLabels() const;
+
+	/**
+	 * @brief Address of a label defined by the last successful compilation,
+	 * or -1 if there is no such label.
+	 */
+	int getLabelValue(const std::string& label) const;
+
 	/**
 	 * @brief Tells whether the last Asar process had errors. 
 	 */
@@ -112,6 +125,7 @@ private:
 	std::filesystem::path _patchfilename;	// Path to the patch, can be supplied or auto-generated.
 	std::string _patchcontent;				// Content of the patch.
 	std::vector<uint8_t> _compiledbin;		// Contents of the result of the compilation.
+	std::map<std::string, int> _labels;		// Labels defined by the compiled program.
 
 	std::vector<std::string> asar_stdout;	// Whatever returned Asar as result of a normal execution.
 	std::vector<std::string> asar_stderr;	// Whatever returned Asar as result of an erroneous execution.
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "DriverProfiler.h"
+
+using namespace AddMusic;
+
+DriverProfiler::DriverProfiler(const std::map<std::string, int>& labels, const std::string& idleLabel) :
+	routineAt(0x10000, 0)
+{
+	routineList.push_back({"(unlabeled)", 0});
+
+	// Asar also lists the labels of macros and anonymous branches, which are not routines.
+	std::vector<Routine> found;
+	for (const auto& label : labels)
+	{
+		if (label.second < 0 || label.second > 0xFFFF || label.first.find(':') != std::string::npos)
+			continue;
+		found.push_back({label.first, (uint16_t)label.second});
+	}
+	std::stable_sort(found.begin(), found.end(), [](const Routine& a, const Routine& b)
+	{
+		return a.address != b.address ? a.address < b.address : a.name.length() < b.name.length();
+	});
+	for (const Routine& routine : found)
+		if (routineList.size() == 1 || routineList.back().address != routine.address)
+			routineList.push_back(routine);
+
+	for (size_t r = 1; r < routineList.size(); r++)
+	{
+		size_t end = r + 1 < routineList.size() ? routineList[r + 1].address : 0x10000;
+		std::fill(routineAt.begin() + routineList[r].address, routineAt.begin() + end, (uint16_t)r);
+	}
+
+	auto idleLabelIt = labels.find(idleLabel);
+	if (idleLabelIt != labels.end())
+		idleStart = idleLabelIt->second;
+}
+
+void DriverProfiler::instruction(uint16_t pc, int cycles)
+{
+	if (idleStart >= 0 && pc >= idleStart && pc < idleStart + IDLE_LOOP_SIZE)
+	{
+		if (inPass)
+			_endPass();
+		reachedIdle = true;
+		idle += cycles;
+		return;
+	}
+
+	inPass = true;
+	passCycles += cycles;
+	Routine& routine = routineList[routineAt[pc]];
+	routine.cycles += cycles;
+	routine.currentPass += cycles;
+}
+
+void DriverProfiler::_endPass()
+{
+	// Whatever ran before the first wait is the driver starting up, not a pass.
+	for (Routine& routine : routineList)
+	{
+		if (reachedIdle)
+			routine.worstPass = std::max(routine.worstPass, routine.currentPass);
+		routine.currentPass = 0;
+	}
+	if (reachedIdle)
+	{
+		worst = std::max(worst, passCycles);
+		passHistogram[passCycles]++;
+		passCount++;
+	}
+	passCycles = 0;
+	inPass = false;
+}
+
+uint64_t DriverProfiler::passesOver(int tickBudget) const
+{
+	uint64_t over = 0;
+	for (auto it = passHistogram.upper_bound(tickBudget); it != passHistogram.end(); ++it)
+		over += it->second;
+	return over;
+}
+
+std::string DriverProfiler::report(int tickBudget) const
+{
+	uint64_t busy = 0;
+	for (const Routine& routine : routineList)
+		busy += routine.cycles;
+
+	std::stringstream out;
+	out << "PASSES THROUGH THE MAIN LOOP:		" << passCount << "\n";
+	out << "CYCLES PER TIMER 0 TICK:		" << tickBudget << "\n";
+	out << "AVERAGE CYCLES PER PASS:		" << (passCount ? busy / passCount : 0) << "\n";
+	out << "WORST PASS IN CYCLES:			" << worst << "\n";
+	out << "WORST PASS HEADROOM IN CYCLES:		" << tickBudget - worst << "\n";
+	out << "PASSES LONGER THAN A TICK:		" << passesOver(tickBudget) << "\n";
+	out << "CPU LOAD:				" << std::fixed << std::setprecision(1) << (busy + idle ? 100.0 * busy / (busy + idle) : 0.0) << "%\n\n";
+
+	std::vector<const Routine*> sorted;
+	for (const Routine& routine : routineList)
+		if (routine.cycles > 0)
+			sorted.push_back(&routine);
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Routine* a, const Routine* b) { return a->cycles > b->cycles; });
+
+	out << "ROUTINE\tADDRESS\tCYCLES\tSHARE\tPER PASS\tWORST PASS\n";
+	for (const Routine* routine : sorted)
+	{
+		out << routine->name << "\t$" << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << routine->address << std::dec
+			<< "\t" << routine->cycles
+			<< "\t" << std::setprecision(1) << 100.0 * routine->cycles / busy << "%"
+			<< "\t" << std::setprecision(1) << (passCount ? (double)routine->cycles / passCount : 0.0)
+			<< "\t" << routine->worstPass << "\n";
+	}
+
+	return out.str();
+}
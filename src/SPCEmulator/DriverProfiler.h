@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "SPC700.h"
+
+namespace AddMusic
+{
+
+/**
+ * @brief Counts the SPC700 cycles the sound driver spends in each of its
+ * routines, pass by pass through its main loop.
+ *
+ * Every instruction is charged to the closest label at or before it, so a
+ * routine's cycles don't include the routines it calls. The driver is idle
+ * while it polls timer 0 at the top of the main loop; everything between two
+ * of those waits is one pass. A pass that takes longer than a timer 0 period
+ * makes the next ticks late, and songs that do it often slow down.
+ */
+class DriverProfiler : public SPC700::Tracer
+{
+public:
+	struct Routine
+	{
+		std::string name;
+		uint16_t address {0};
+		uint64_t cycles {0};			// Total over the whole run.
+		int worstPass {0};				// Most cycles spent in a single pass.
+		int currentPass {0};
+	};
+
+	/**
+	 * @brief labels are the driver's labels with their ARAM addresses, as
+	 * Asar reports them. idleLabel is the label of the timer 0 polling loop.
+	 */
+	DriverProfiler(const std::map<std::string, int>& labels, const std::string& idleLabel = "MainLoop");
+
+	void instruction(uint16_t pc, int cycles) override;
+
+	/**
+	 * @brief Plain text report of the run so far. tickBudget is the number
+	 * of cycles in a timer 0 period.
+	 */
+	std::string report(int tickBudget) const;
+
+	const std::vector<Routine>& routines() const { return routineList; }
+	uint64_t passes() const { return passCount; }
+	uint64_t idleCycles() const { return idle; }
+	int worstPass() const { return worst; }
+	uint64_t passesOver(int tickBudget) const;
+
+private:
+	// Bytes of the polling loop: mov y, $fd / beq MainLoop.
+	static constexpr int IDLE_LOOP_SIZE {4};
+
+	void _endPass();
+
+	std::vector<Routine> routineList;		// Sorted by address. The first one collects code before every label.
+	std::vector<uint16_t> routineAt;		// Routine of every ARAM address.
+	int idleStart {-1};
+
+	bool reachedIdle {false};
+	bool inPass {false};
+	int passCycles {0};
+	int worst {0};
+	uint64_t passCount {0};
+	uint64_t idle {0};
+	std::map<int, uint64_t> passHistogram;	// How many passes took each number of cycles.
+};
+
+}
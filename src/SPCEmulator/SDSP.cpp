@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <iterator>
+
+#include "SDSP.h"
+
+using namespace AddMusic;
+
+// Global registers.
+enum : uint8_t
+{
+	R_MVOLL = 0x0C, R_MVOLR = 0x1C, R_EVOLL = 0x2C, R_EVOLR = 0x3C,
+	R_KON = 0x4C, R_KOFF = 0x5C, R_FLG = 0x6C, R_ENDX = 0x7C,
+	R_EFB = 0x0D, R_PMON = 0x2D, R_NON = 0x3D, R_EON = 0x4D,
+	R_DIR = 0x5D, R_ESA = 0x6D, R_EDL = 0x7D, R_FIR = 0x0F,
+};
+
+// Voice registers, added to voice * 0x10.
+enum : uint8_t
+{
+	V_VOLL = 0x00, V_VOLR = 0x01, V_PITCHL = 0x02, V_PITCHH = 0x03, V_SRCN = 0x04,
+	V_ADSR1 = 0x05, V_ADSR2 = 0x06, V_GAIN = 0x07, V_ENVX = 0x08, V_OUTX = 0x09,
+};
+
+// Samples between envelope and noise steps for each rate, and the offset
+// of each rate against the global clock.
+static constexpr int COUNTER_RANGE {2048 * 5 * 3};
+static constexpr int COUNTER_RATES[32] {
+	COUNTER_RANGE + 1, 2048, 1536, 1280, 1024, 768, 640, 512, 384, 320, 256, 192, 160, 128, 96, 80,
+	64, 48, 40, 32, 24, 20, 16, 12, 10, 8, 6, 5, 4, 3, 2, 1
+};
+static constexpr int COUNTER_OFFSETS[32] {
+	1, 0, 1040, 536, 0, 1040, 536, 0, 1040, 536, 0, 1040, 536, 0, 1040, 536,
+	0, 1040, 536, 0, 1040, 536, 0, 1040, 536, 0, 1040, 536, 0, 1040, 0, 0
+};
+
+// Gaussian interpolation table of the S-DSP.
+static constexpr int16_t GAUSS[512] {
+	0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,
+	2,   2,   3,   3,   3,   3,   3,   4,   4,   4,   4,   4,   5,   5,   5,   5,
+	6,   6,   6,   6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  10,
+	11,  11,  11,  12,  12,  13,  13,  14,  14,  15,  15,  15,  16,  16,  17,  17,
+	18,  19,  19,  20,  20,  21,  21,  22,  23,  23,  24,  24,  25,  26,  27,  27,
+	28,  29,  29,  30,  31,  32,  32,  33,  34,  35,  36,  36,  37,  38,  39,  40,
+	41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51,  52,  53,  54,  55,  56,
+	58,  59,  60,  61,  62,  64,  65,  66,  67,  69,  70,  71,  73,  74,  76,  77,
+	78,  80,  81,  83,  84,  86,  87,  89,  90,  92,  94,  95,  97,  99, 100, 102,
+	104, 106, 107, 109, 111, 113, 115, 117, 118, 120, 122, 124, 126, 128, 130, 132,
+	134, 137, 139, 141, 143, 145, 147, 150, 152, 154, 156, 159, 161, 163, 166, 168,
+	171, 173, 175, 178, 180, 183, 186, 188, 191, 193, 196, 199, 201, 204, 207, 210,
+	212, 215, 218, 221, 224, 227, 230, 233, 236, 239, 242, 245, 248, 251, 254, 257,
+	260, 263, 267, 270, 273, 276, 280, 283, 286, 290, 293, 297, 300, 304, 307, 311,
+	314, 318, 321, 325, 328, 332, 336, 339, 343, 347, 351, 354, 358, 362, 366, 370,
+	374, 378, 381, 385, 389, 393, 397, 401, 405, 410, 414, 418, 422, 426, 430, 434,
+	439, 443, 447, 451, 456, 460, 464, 469, 473, 477, 482, 486, 491, 495, 499, 504,
+	508, 513, 517, 522, 527, 531, 536, 540, 545, 550, 554, 559, 563, 568, 573, 577,
+	582, 587, 592, 596, 601, 606, 611, 615, 620, 625, 630, 635, 640, 644, 649, 654,
+	659, 664, 669, 674, 678, 683, 688, 693, 698, 703, 708, 713, 718, 723, 728, 732,
+	737, 742, 747, 752, 757, 762, 767, 772, 777, 782, 787, 792, 797, 802, 806, 811,
+	816, 821, 826, 831, 836, 841, 846, 851, 855, 860, 865, 870, 875, 880, 884, 889,
+	894, 899, 904, 908, 913, 918, 923, 927, 932, 937, 941, 946, 951, 955, 960, 965,
+	969, 974, 978, 983, 988, 992, 997,1001,1005,1010,1014,1019,1023,1027,1032,1036,
+	1040,1045,1049,1053,1057,1061,1066,1070,1074,1078,1082,1086,1090,1094,1098,1102,
+	1106,1109,1113,1117,1121,1125,1128,1132,1136,1139,1143,1146,1150,1153,1157,1160,
+	1164,1167,1170,1174,1177,1180,1183,1186,1190,1193,1196,1199,1202,1205,1207,1210,
+	1213,1216,1219,1221,1224,1227,1229,1232,1234,1237,1239,1241,1244,1246,1248,1251,
+	1253,1255,1257,1259,1261,1263,1265,1267,1269,1270,1272,1274,1275,1277,1279,1280,
+	1282,1283,1284,1286,1287,1288,1290,1291,1292,1293,1294,1295,1296,1297,1297,1298,
+	1299,1300,1300,1301,1302,1302,1303,1303,1303,1304,1304,1304,1304,1304,1305,1305
+};
+
+static inline int clamp16(int value)
+{
+	return std::clamp(value, -0x8000, 0x7FFF);
+}
+
+SDSP::SDSP(uint8_t* ram) : ram(ram)
+{
+	reset();
+}
+
+void SDSP::reset()
+{
+	std::fill(std::begin(regs), std::end(regs), 0);
+	regs[R_FLG] = 0xE0;
+	for (Voice& voice : voices)
+		voice = Voice();
+	counter = 0;
+	noise = 0x4000;
+	everyOtherSample = false;
+	newKon = 0;
+	echoOffset = 0;
+	echoLength = 0;
+	firPos = 0;
+	std::fill(&firBuffer[0][0], &firBuffer[0][0] + 16, 0);
+}
+
+void SDSP::loadRegisters(const uint8_t* newRegs)
+{
+	// Voices don't carry on from the snapshot: they start when they are keyed on.
+	std::copy(newRegs, newRegs + 128, regs);
+	newKon = regs[R_KON];
+}
+
+uint8_t SDSP::read(uint8_t addr) const
+{
+	return regs[addr & 0x7F];
+}
+
+void SDSP::write(uint8_t addr, uint8_t data)
+{
+	if (addr >= 0x80)
+		return;			// Read-only mirror.
+
+	regs[addr] = data;
+	if (addr == R_KON)
+		newKon = data;
+	else if (addr == R_ENDX)
+		regs[R_ENDX] = 0;
+}
+
+bool SDSP::_counterPoll(int rate) const
+{
+	return ((unsigned)counter + COUNTER_OFFSETS[rate]) % COUNTER_RATES[rate] == 0;
+}
+
+void SDSP::_keyOn(int v)
+{
+	Voice& voice = voices[v];
+	int entry = (regs[R_DIR] << 8) + (regs[(v << 4) | V_SRCN] << 2);
+	voice.brrAddr = ram[entry & 0xFFFF] | (ram[(entry + 1) & 0xFFFF] << 8);
+	voice.brrOffset = 0;
+	voice.prev1 = voice.prev2 = 0;
+	std::fill(std::begin(voice.history), std::end(voice.history), 0);
+	voice.interpPos = 0;
+	voice.konDelay = 5;
+	voice.env = 0;
+	voice.hiddenEnv = 0;
+	voice.envMode = EnvelopeMode::Attack;
+	_decodeBlock(voice);
+	regs[R_ENDX] &= ~(1 << v);
+}
+
+void SDSP::_decodeBlock(Voice& voice)
+{
+	const int header = ram[voice.brrAddr & 0xFFFF];
+	const int shift = header >> 4;
+	const int filter = header & 0x0C;
+
+	for (int i = 0; i < 16; i++)
+	{
+		int byte = ram[(voice.brrAddr + 1 + (i >> 1)) & 0xFFFF];
+		int s = (int8_t)((i & 1) ? (byte << 4) : byte) >> 4;		// Sign-extended nibble, high nibble first.
+		s = (s << shift) >> 1;
+		if (shift >= 13)
+			s = (s < 0) ? -2048 : 0;
+
+		const int p1 = voice.prev1;
+		const int p2 = voice.prev2 >> 1;
+		if (filter >= 8)
+		{
+			s += p1;
+			s -= p2;
+			if (filter == 8)
+			{
+				s += p2 >> 4;
+				s += (p1 * -3) >> 6;
+			}
+			else
+			{
+				s += (p1 * -13) >> 7;
+				s += (p2 * 3) >> 4;
+			}
+		}
+		else if (filter)
+		{
+			s += p1 >> 1;
+			s += (-p1) >> 5;
+		}
+
+		s = (int16_t)(clamp16(s) * 2);
+		voice.decoded[i] = s;
+		voice.prev2 = voice.prev1;
+		voice.prev1 = s;
+	}
+}
+
+int16_t SDSP::_nextSample(int v)
+{
+	Voice& voice = voices[v];
+	if (voice.brrOffset == 16)
+	{
+		const int header = ram[voice.brrAddr & 0xFFFF];
+		if (header & 0x01)
+		{
+			// End of the sample: go to its loop point. Without the loop flag the voice is silenced.
+			regs[R_ENDX] |= 1 << v;
+			int entry = (regs[R_DIR] << 8) + (regs[(v << 4) | V_SRCN] << 2) + 2;
+			voice.brrAddr = ram[entry & 0xFFFF] | (ram[(entry + 1) & 0xFFFF] << 8);
+			if (!(header & 0x02))
+			{
+				voice.envMode = EnvelopeMode::Release;
+				voice.env = 0;
+			}
+		}
+		else
+			voice.brrAddr = (voice.brrAddr + 9) & 0xFFFF;
+
+		voice.brrOffset = 0;
+		_decodeBlock(voice);
+	}
+	return voice.decoded[voice.brrOffset++];
+}
+
+void SDSP::_runEnvelope(int v)
+{
+	Voice& voice = voices[v];
+	const uint8_t* vregs = regs + (v << 4);
+	int env = voice.env;
+
+	if (voice.envMode == EnvelopeMode::Release)
+	{
+		env -= 0x8;
+		voice.env = std::max(env, 0);
+		return;
+	}
+
+	int rate;
+	int envData = vregs[V_ADSR2];
+	if (vregs[V_ADSR1] & 0x80)
+	{
+		if (voice.envMode >= EnvelopeMode::Decay)
+		{
+			env--;
+			env -= env >> 8;
+			rate = envData & 0x1F;
+			if (voice.envMode == EnvelopeMode::Decay)
+				rate = ((vregs[V_ADSR1] >> 3) & 0x0E) + 0x10;
+		}
+		else
+		{
+			rate = (vregs[V_ADSR1] & 0x0F) * 2 + 1;
+			env += (rate < 31) ? 0x20 : 0x400;
+		}
+	}
+	else
+	{
+		envData = vregs[V_GAIN];
+		int mode = envData >> 5;
+		if (mode < 4)
+		{
+			env = envData * 0x10;		// Direct.
+			rate = 31;
+		}
+		else
+		{
+			rate = envData & 0x1F;
+			if (mode == 4)				// Linear decrease.
+				env -= 0x20;
+			else if (mode < 6)			// Exponential decrease.
+			{
+				env--;
+				env -= env >> 8;
+			}
+			else						// Linear or bent line increase.
+			{
+				env += 0x20;
+				if (mode > 6 && (unsigned)voice.hiddenEnv >= 0x600)
+					env += 0x8 - 0x20;
+			}
+		}
+	}
+
+	if ((env >> 8) == (envData >> 5) && voice.envMode == EnvelopeMode::Decay)
+		voice.envMode = EnvelopeMode::Sustain;
+
+	voice.hiddenEnv = env;
+
+	if ((unsigned)env > 0x7FF)
+	{
+		env = (env < 0) ? 0 : 0x7FF;
+		if (voice.envMode == EnvelopeMode::Attack)
+			voice.envMode = EnvelopeMode::Decay;
+	}
+
+	if (_counterPoll(rate))
+		voice.env = env;
+}
+
+void SDSP::run(int16_t& left, int16_t& right)
+{
+	if (--counter < 0)
+		counter = COUNTER_RANGE - 1;
+
+	if (_counterPoll(regs[R_FLG] & 0x1F))
+	{
+		int feedback = (noise << 13) ^ (noise << 14);
+		noise = (feedback & 0x4000) ^ (noise >> 1);
+	}
+
+	// KON and KOFF are only looked at every other sample.
+	everyOtherSample = !everyOtherSample;
+	if (everyOtherSample)
+	{
+		for (int v = 0; v < 8; v++)
+		{
+			if (newKon & (1 << v))
+				_keyOn(v);
+			else if ((regs[R_KOFF] & (1 << v)) && voices[v].konDelay == 0)
+				voices[v].envMode = EnvelopeMode::Release;
+		}
+		newKon = 0;
+	}
+
+	if (regs[R_FLG] & 0x80)
+		for (Voice& voice : voices)
+		{
+			voice.envMode = EnvelopeMode::Release;
+			voice.env = 0;
+		}
+
+	int mainL = 0, mainR = 0, echoL = 0, echoR = 0;
+	int prevOutput = 0;
+
+	for (int v = 0; v < 8; v++)
+	{
+		Voice& voice = voices[v];
+		uint8_t* vregs = regs + (v << 4);
+		int output = 0;
+
+		if (voice.konDelay > 0)
+		{
+			voice.konDelay--;
+			voice.output = 0;
+			vregs[V_ENVX] = 0;
+			vregs[V_OUTX] = 0;
+			prevOutput = 0;
+			continue;
+		}
+
+		int pitch = (vregs[V_PITCHL] | (vregs[V_PITCHH] << 8)) & 0x3FFF;
+		if (v > 0 && (regs[R_PMON] & (1 << v)))
+			pitch += ((prevOutput >> 5) * pitch) >> 10;
+
+		// Interpolation between the last four samples.
+		int sample;
+		if (regs[R_NON] & (1 << v))
+			sample = (int16_t)(noise * 2);
+		else
+		{
+			const int offset = (voice.interpPos >> 4) & 0xFF;
+			const int16_t* fwd = GAUSS + 255 - offset;
+			const int16_t* rev = GAUSS + offset;
+			sample = (fwd[0] * voice.history[0]) >> 11;
+			sample += (fwd[256] * voice.history[1]) >> 11;
+			sample += (rev[256] * voice.history[2]) >> 11;
+			sample = (int16_t)sample;
+			sample += (rev[0] * voice.history[3]) >> 11;
+			sample = clamp16(sample) & ~1;
+		}
+
+		_runEnvelope(v);
+		output = ((sample * voice.env) >> 11) & ~1;
+		voice.output = output;
+		prevOutput = output;
+		vregs[V_ENVX] = voice.env >> 4;
+		vregs[V_OUTX] = output >> 8;
+
+		int l = (output * (int8_t)vregs[V_VOLL]) >> 7;
+		int r = (output * (int8_t)vregs[V_VOLR]) >> 7;
+		mainL = clamp16(mainL + l);
+		mainR = clamp16(mainR + r);
+		if (regs[R_EON] & (1 << v))
+		{
+			echoL = clamp16(echoL + l);
+			echoR = clamp16(echoR + r);
+		}
+
+		// Move forward through the sample.
+		voice.interpPos = (voice.interpPos & 0xFFF) + std::min(pitch, 0x7FFF);
+		for (int step = voice.interpPos >> 12; step > 0; step--)
+		{
+			voice.history[0] = voice.history[1];
+			voice.history[1] = voice.history[2];
+			voice.history[2] = voice.history[3];
+			voice.history[3] = _nextSample(v);
+		}
+	}
+
+	// Echo: read what was written EDL samples ago and run it through the FIR filter.
+	const int echoAddr = ((regs[R_ESA] << 8) + echoOffset) & 0xFFFF;
+	if (echoOffset == 0)
+		echoLength = (regs[R_EDL] & 0x0F) * 0x800;
+
+	auto readEcho = [&](int addr) { return (int16_t)(ram[addr & 0xFFFF] | (ram[(addr + 1) & 0xFFFF] << 8)) >> 1; };
+	firPos = (firPos + 1) & 7;
+	firBuffer[firPos][0] = readEcho(echoAddr);
+	firBuffer[firPos][1] = readEcho(echoAddr + 2);
+
+	int echoOut[2];
+	for (int ch = 0; ch < 2; ch++)
+	{
+		int sum = 0;
+		for (int tap = 0; tap < 7; tap++)
+			sum += (firBuffer[(firPos + tap + 1) & 7][ch] * (int8_t)regs[R_FIR + (tap << 4)]) >> 6;
+		sum = (int16_t)sum;
+		sum += (firBuffer[firPos][ch] * (int8_t)regs[R_FIR + 0x70]) >> 6;
+		echoOut[ch] = clamp16(sum) & ~1;
+	}
+
+	// Echo feedback goes back into the buffer, unless echo writes are disabled.
+	if (!(regs[R_FLG] & 0x20))
+	{
+		int inL = clamp16(echoL + ((echoOut[0] * (int8_t)regs[R_EFB]) >> 7)) & ~1;
+		int inR = clamp16(echoR + ((echoOut[1] * (int8_t)regs[R_EFB]) >> 7)) & ~1;
+		ram[echoAddr] = inL & 0xFF;
+		ram[(echoAddr + 1) & 0xFFFF] = (inL >> 8) & 0xFF;
+		ram[(echoAddr + 2) & 0xFFFF] = inR & 0xFF;
+		ram[(echoAddr + 3) & 0xFFFF] = (inR >> 8) & 0xFF;
+	}
+
+	echoOffset += 4;
+	if (echoOffset >= echoLength)
+		echoOffset = 0;
+
+	// Final mix.
+	int outL = clamp16(((mainL * (int8_t)regs[R_MVOLL]) >> 7) + ((echoOut[0] * (int8_t)regs[R_EVOLL]) >> 7));
+	int outR = clamp16(((mainR * (int8_t)regs[R_MVOLR]) >> 7) + ((echoOut[1] * (int8_t)regs[R_EVOLR]) >> 7));
+	if (regs[R_FLG] & 0x40)
+		outL = outR = 0;
+
+	left = outL;
+	right = outR;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+
+namespace AddMusic
+{
+
+/**
+ * @brief The S-DSP: eight BRR voices with ADSR/GAIN envelopes, Gaussian
+ * interpolation, pitch modulation, noise and the echo unit with its FIR filter.
+ *
+ * It works a whole output sample at a time instead of emulating every DSP
+ * clock. That is enough for the register writes of a sound driver, which only
+ * change between samples, and it keeps rendering far faster than realtime.
+ * Output is deterministic: the same ARAM and registers always render the same
+ * samples.
+ */
+class SDSP
+{
+public:
+	/**
+	 * @brief ram is the 64 KB of ARAM shared with the SPC700.
+	 */
+	SDSP(uint8_t* ram);
+
+	/**
+	 * @brief Power-on state: every voice off, echo writes and output muted.
+	 */
+	void reset();
+
+	/**
+	 * @brief Loads all 128 registers at once, as an SPC file stores them.
+	 * Voices only start playing once they are keyed on.
+	 */
+	void loadRegisters(const uint8_t* regs);
+
+	uint8_t read(uint8_t addr) const;
+	void write(uint8_t addr, uint8_t data);
+
+	/**
+	 * @brief Runs the DSP for one 32 kHz sample and returns it.
+	 */
+	void run(int16_t& left, int16_t& right);
+
+private:
+	enum class EnvelopeMode { Release, Attack, Decay, Sustain };
+
+	struct Voice
+	{
+		int brrAddr {0};				// Block being played.
+		int brrOffset {0};				// Next sample of the block (0-15).
+		int16_t decoded[16] {};			// Samples of the block being played.
+		int16_t history[4] {};			// Last four samples, oldest first, for the interpolation.
+		int prev1 {0}, prev2 {0};		// Last two decoded samples, for the BRR filters.
+		int interpPos {0};				// 12-bit fraction of the position between history[2] and history[3].
+		int konDelay {0};				// Samples left before a keyed on voice starts playing.
+		int env {0};
+		int hiddenEnv {0};
+		EnvelopeMode envMode {EnvelopeMode::Release};
+		int output {0};					// Last output before the volume, for pitch modulation.
+	};
+
+	void _keyOn(int v);
+	void _decodeBlock(Voice& voice);
+	int16_t _nextSample(int v);
+	void _runEnvelope(int v);
+	bool _counterPoll(int rate) const;
+
+	uint8_t* ram;
+	uint8_t regs[128] {};
+	Voice voices[8];
+
+	int counter {0};					// Global envelope/noise clock.
+	int noise {0x4000};
+	bool everyOtherSample {false};		// KON and KOFF are polled every other sample.
+	uint8_t newKon {0};
+
+	int echoOffset {0};
+	int echoLength {0};
+	int firPos {0};
+	int firBuffer[8][2] {};
+};
+
+}
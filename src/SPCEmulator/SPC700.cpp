@@ -0,0 +1,706 @@
+#include "SPC700.h"
+
+using namespace AddMusic;
+
+// The 64 bytes the SPC700 boots from, mapped at $FFC0 while bit 7 of CONTROL is set.
+static constexpr uint8_t IPL_ROM[64] {
+	0xCD, 0xEF, 0xBD, 0xE8, 0x00, 0xC6, 0x1D, 0xD0, 0xFC, 0x8F, 0xAA, 0xF4, 0x8F, 0xBB, 0xF5, 0x78,
+	0xCC, 0xF4, 0xD0, 0xFB, 0x2F, 0x19, 0xEB, 0xF4, 0xD0, 0xFC, 0x7E, 0xF4, 0xD0, 0x0B, 0xE4, 0xF5,
+	0xCB, 0xF4, 0xD7, 0x00, 0xFC, 0xD0, 0xF3, 0xAB, 0x01, 0x10, 0xEF, 0x7E, 0xF4, 0x10, 0xEB, 0xBA,
+	0xF6, 0xDA, 0x00, 0xBA, 0xF4, 0xC4, 0xF4, 0xDD, 0x5D, 0xD0, 0xDB, 0x1F, 0x00, 0x00, 0xC0, 0xFF,
+};
+
+// Cycles taken by each opcode. Branches take two more when taken.
+static constexpr uint8_t CYCLES[256] {
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 5, 4, 5, 4, 6, 8,
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 6, 5, 2, 2, 4, 6,
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 5, 4, 5, 4, 5, 4,
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 6, 5, 2, 2, 3, 8,
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 4, 4, 5, 4, 6, 6,
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 4, 5, 2, 2, 4, 3,
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 4, 4, 5, 4, 5, 5,
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 5, 5, 2, 2, 3, 6,
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 5, 4, 5, 2, 4, 5,
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 5, 5, 2, 2, 12, 5,
+	3, 8, 4, 5, 3, 4, 3, 6, 2, 6, 4, 4, 5, 2, 4, 4,
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 5, 5, 2, 2, 3, 4,
+	3, 8, 4, 5, 4, 5, 4, 7, 2, 5, 6, 4, 5, 2, 4, 9,
+	2, 8, 4, 5, 5, 6, 6, 7, 4, 5, 5, 5, 2, 2, 6, 3,
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 4, 5, 3, 4, 3, 4, 3,
+	2, 8, 4, 5, 4, 5, 5, 6, 3, 4, 5, 4, 2, 2, 4, 3,
+};
+
+SPC700::SPC700(uint8_t* ram, SDSP& dsp) : ram(ram), dsp(dsp)
+{
+	reset();
+}
+
+void SPC700::reset()
+{
+	a = x = y = 0;
+	sp = 0xEF;
+	psw = 0x02;
+	halted = false;
+	control = 0x80;
+	dspAddr = 0;
+	for (int i = 0; i < 4; i++)
+		inputPorts[i] = outputPorts[i] = 0;
+	timers[0] = Timer();
+	timers[1] = Timer();
+	timers[2] = Timer();
+	timers[0].period = timers[1].period = 128;
+	timers[2].period = 16;
+	pc = IPL_ROM[62] | (IPL_ROM[63] << 8);
+}
+
+void SPC700::setInputPort(int port, uint8_t value)
+{
+	inputPorts[port & 3] = value;
+}
+
+uint8_t SPC700::outputPort(int port) const
+{
+	return outputPorts[port & 3];
+}
+
+void SPC700::loadIORegisters(const uint8_t* io)
+{
+	// Writing CONTROL would reset the timers and ports, so restore it directly.
+	control = io[0x01];
+	for (int t = 0; t < 3; t++)
+	{
+		timers[t].enabled = control & (1 << t);
+		timers[t].target = io[0x0A + t];
+		timers[t].counter = io[0x0D + t] & 0x0F;
+		timers[t].stage = 0;
+		timers[t].cycles = 0;
+	}
+	dspAddr = io[0x02];
+	for (int i = 0; i < 4; i++)
+		inputPorts[i] = io[0x04 + i];
+}
+
+int SPC700::timerPeriod(int timer) const
+{
+	const Timer& t = timers[timer];
+	return t.period * (t.target ? t.target : 256);
+}
+
+uint8_t SPC700::_read(uint16_t addr)
+{
+	if (addr >= 0xF0 && addr <= 0xFF)
+	{
+		switch (addr)
+		{
+		case 0xF2: return dspAddr;
+		case 0xF3: return dsp.read(dspAddr);
+		case 0xF4: case 0xF5: case 0xF6: case 0xF7: return inputPorts[addr - 0xF4];
+		case 0xF8: case 0xF9: return ram[addr];
+		case 0xFD: case 0xFE: case 0xFF:
+		{
+			Timer& timer = timers[addr - 0xFD];
+			uint8_t value = timer.counter;
+			timer.counter = 0;
+			return value;
+		}
+		default: return 0;		// Write-only registers.
+		}
+	}
+	if (addr >= 0xFFC0 && (control & 0x80))
+		return IPL_ROM[addr - 0xFFC0];
+	return ram[addr];
+}
+
+void SPC700::_write(uint16_t addr, uint8_t data)
+{
+	if (addr >= 0xF0 && addr <= 0xFF)
+	{
+		switch (addr)
+		{
+		case 0xF1:
+			for (int t = 0; t < 3; t++)
+			{
+				bool enable = data & (1 << t);
+				if (enable && !timers[t].enabled)
+				{
+					timers[t].stage = 0;
+					timers[t].counter = 0;
+				}
+				timers[t].enabled = enable;
+			}
+			if (data & 0x10)
+				inputPorts[0] = inputPorts[1] = 0;
+			if (data & 0x20)
+				inputPorts[2] = inputPorts[3] = 0;
+			control = data;
+			break;
+		case 0xF2: dspAddr = data; break;
+		case 0xF3: dsp.write(dspAddr, data); break;
+		case 0xF4: case 0xF5: case 0xF6: case 0xF7: outputPorts[addr - 0xF4] = data; break;
+		case 0xFA: case 0xFB: case 0xFC: timers[addr - 0xFA].target = data; break;
+		default: break;
+		}
+	}
+	ram[addr] = data;
+}
+
+void SPC700::_runTimers(int cycles)
+{
+	for (Timer& timer : timers)
+	{
+		timer.cycles += cycles;
+		while (timer.cycles >= timer.period)
+		{
+			timer.cycles -= timer.period;
+			if (!timer.enabled)
+				continue;
+			if (++timer.stage == (timer.target ? timer.target : 256))
+			{
+				timer.stage = 0;
+				timer.counter = (timer.counter + 1) & 0x0F;
+			}
+		}
+	}
+}
+
+int SPC700::run(int cycles)
+{
+	int ran = 0;
+	while (ran < cycles)
+	{
+		int taken;
+		if (halted)
+			taken = cycles - ran;
+		else
+		{
+			uint16_t at = pc;
+			taken = _step();
+			if (tracer)
+				tracer->instruction(at, taken);
+		}
+		_runTimers(taken);
+		ran += taken;
+	}
+	return ran;
+}
+
+uint16_t SPC700::_fetchWord()
+{
+	uint16_t low = _fetch();
+	return low | (_fetch() << 8);
+}
+
+uint16_t SPC700::_readDPWord(uint8_t offset)
+{
+	uint16_t low = _read(_dp(offset));
+	return low | (_read(_dp(offset + 1)) << 8);
+}
+
+void SPC700::_writeDPWord(uint8_t offset, uint16_t value)
+{
+	_write(_dp(offset), value & 0xFF);
+	_write(_dp(offset + 1), value >> 8);
+}
+
+void SPC700::_push(uint8_t data)
+{
+	_write(0x100 | sp--, data);
+}
+
+uint8_t SPC700::_pop()
+{
+	return _read(0x100 | ++sp);
+}
+
+void SPC700::_setNZ(uint8_t value)
+{
+	psw = (psw & ~(N_FLAG | Z_FLAG)) | (value & N_FLAG) | (value ? 0 : Z_FLAG);
+}
+
+uint8_t SPC700::_or(uint8_t l, uint8_t r) { l |= r; _setNZ(l); return l; }
+uint8_t SPC700::_and(uint8_t l, uint8_t r) { l &= r; _setNZ(l); return l; }
+uint8_t SPC700::_eor(uint8_t l, uint8_t r) { l ^= r; _setNZ(l); return l; }
+
+uint8_t SPC700::_adc(uint8_t l, uint8_t r)
+{
+	int result = l + r + (psw & C_FLAG);
+	psw &= ~(V_FLAG | H_FLAG | C_FLAG);
+	if (result > 0xFF) psw |= C_FLAG;
+	if ((l ^ r ^ result) & 0x10) psw |= H_FLAG;
+	if (~(l ^ r) & (l ^ result) & 0x80) psw |= V_FLAG;
+	_setNZ(result);
+	return result;
+}
+
+uint8_t SPC700::_sbc(uint8_t l, uint8_t r)
+{
+	return _adc(l, ~r);
+}
+
+uint8_t SPC700::_cmp(uint8_t l, uint8_t r)
+{
+	int result = l - r;
+	psw = (psw & ~C_FLAG) | (result >= 0 ? C_FLAG : 0);
+	_setNZ(result);
+	return l;
+}
+
+uint8_t SPC700::_asl(uint8_t value)
+{
+	psw = (psw & ~C_FLAG) | (value >> 7);
+	value <<= 1;
+	_setNZ(value);
+	return value;
+}
+
+uint8_t SPC700::_lsr(uint8_t value)
+{
+	psw = (psw & ~C_FLAG) | (value & 1);
+	value >>= 1;
+	_setNZ(value);
+	return value;
+}
+
+uint8_t SPC700::_rol(uint8_t value)
+{
+	uint8_t carry = psw & C_FLAG;
+	psw = (psw & ~C_FLAG) | (value >> 7);
+	value = (value << 1) | carry;
+	_setNZ(value);
+	return value;
+}
+
+uint8_t SPC700::_ror(uint8_t value)
+{
+	uint8_t carry = (psw & C_FLAG) << 7;
+	psw = (psw & ~C_FLAG) | (value & 1);
+	value = (value >> 1) | carry;
+	_setNZ(value);
+	return value;
+}
+
+uint8_t SPC700::_inc(uint8_t value) { _setNZ(++value); return value; }
+uint8_t SPC700::_dec(uint8_t value) { _setNZ(--value); return value; }
+
+int SPC700::_step()
+{
+	const uint8_t opcode = _fetch();
+	int cycles = CYCLES[opcode];
+
+	auto branch = [&](bool condition)
+	{
+		int8_t offset = _fetch();
+		if (condition)
+		{
+			pc += offset;
+			cycles += 2;
+		}
+	};
+	auto indexedIndirect = [&]()		// [d+X]
+	{
+		uint8_t d = _fetch() + x;
+		return _readDPWord(d);
+	};
+	auto indirectIndexed = [&]()		// [d]+Y
+	{
+		return (uint16_t)(_readDPWord(_fetch()) + y);
+	};
+	auto memBit = [&](uint16_t& addr)	// m.b
+	{
+		uint16_t word = _fetchWord();
+		addr = word & 0x1FFF;
+		return word >> 13;
+	};
+	auto yaWord = [&]() { return (uint16_t)(a | (y << 8)); };
+	auto setYA = [&](uint16_t value) { a = value & 0xFF; y = value >> 8; };
+	auto setNZ16 = [&](uint16_t value)
+	{
+		psw = (psw & ~(N_FLAG | Z_FLAG)) | ((value >> 8) & N_FLAG) | (value ? 0 : Z_FLAG);
+	};
+
+	const int hi = opcode >> 4;
+	const int lo = opcode & 0x0F;
+
+	// OR, AND, EOR, CMP, ADC and SBC share their addressing modes.
+	if (hi < 0xC && lo >= 0x4 && lo <= 0x9)
+	{
+		const int op = hi >> 1;
+		auto alu = [&](uint8_t l, uint8_t r) -> uint8_t
+		{
+			switch (op)
+			{
+			case 0: return _or(l, r);
+			case 1: return _and(l, r);
+			case 2: return _eor(l, r);
+			case 3: return _cmp(l, r);
+			case 4: return _adc(l, r);
+			default: return _sbc(l, r);
+			}
+		};
+		const bool store = op != 3;
+
+		if ((hi & 1) == 0)
+		{
+			switch (lo)
+			{
+			case 0x4: { uint8_t v = _read(_dp(_fetch())); a = alu(a, v); break; }
+			case 0x5: { uint8_t v = _read(_fetchWord()); a = alu(a, v); break; }
+			case 0x6: { uint8_t v = _read(_dp(x)); a = alu(a, v); break; }
+			case 0x7: { uint8_t v = _read(indexedIndirect()); a = alu(a, v); break; }
+			case 0x8: { uint8_t v = _fetch(); a = alu(a, v); break; }
+			case 0x9:
+			{
+				uint8_t src = _read(_dp(_fetch()));
+				uint16_t dst = _dp(_fetch());
+				uint8_t result = alu(_read(dst), src);
+				if (store) _write(dst, result);
+				break;
+			}
+			}
+		}
+		else
+		{
+			switch (lo)
+			{
+			case 0x4: { uint8_t v = _read(_dp(_fetch() + x)); a = alu(a, v); break; }
+			case 0x5: { uint8_t v = _read(_fetchWord() + x); a = alu(a, v); break; }
+			case 0x6: { uint8_t v = _read(_fetchWord() + y); a = alu(a, v); break; }
+			case 0x7: { uint8_t v = _read(indirectIndexed()); a = alu(a, v); break; }
+			case 0x8:
+			{
+				uint8_t imm = _fetch();
+				uint16_t dst = _dp(_fetch());
+				uint8_t result = alu(_read(dst), imm);
+				if (store) _write(dst, result);
+				break;
+			}
+			case 0x9:
+			{
+				uint8_t src = _read(_dp(y));
+				uint16_t dst = _dp(x);
+				uint8_t result = alu(_read(dst), src);
+				if (store) _write(dst, result);
+				break;
+			}
+			}
+		}
+		return cycles;
+	}
+
+	switch (opcode)
+	{
+	// ASL, ROL, LSR, ROR, DEC and INC share their addressing modes too.
+	case 0x0B: case 0x2B: case 0x4B: case 0x6B: case 0x8B: case 0xAB:
+	case 0x0C: case 0x2C: case 0x4C: case 0x6C: case 0x8C: case 0xAC:
+	case 0x1B: case 0x3B: case 0x5B: case 0x7B: case 0x9B: case 0xBB:
+	case 0x1C: case 0x3C: case 0x5C: case 0x7C: case 0x9C: case 0xBC:
+	{
+		auto shift = [&](uint8_t value) -> uint8_t
+		{
+			switch (hi >> 1)
+			{
+			case 0: return _asl(value);
+			case 1: return _rol(value);
+			case 2: return _lsr(value);
+			case 3: return _ror(value);
+			case 4: return _dec(value);
+			default: return _inc(value);
+			}
+		};
+		if (lo == 0xC && (hi & 1))
+			a = shift(a);
+		else
+		{
+			uint16_t addr;
+			if (lo == 0xB)
+				addr = (hi & 1) ? _dp(_fetch() + x) : _dp(_fetch());
+			else
+				addr = _fetchWord();
+			_write(addr, shift(_read(addr)));
+		}
+		break;
+	}
+
+	// Branches
+	case 0x10: branch(!(psw & N_FLAG)); break;
+	case 0x30: branch(psw & N_FLAG); break;
+	case 0x50: branch(!(psw & V_FLAG)); break;
+	case 0x70: branch(psw & V_FLAG); break;
+	case 0x90: branch(!(psw & C_FLAG)); break;
+	case 0xB0: branch(psw & C_FLAG); break;
+	case 0xD0: branch(!(psw & Z_FLAG)); break;
+	case 0xF0: branch(psw & Z_FLAG); break;
+	case 0x2F: { int8_t offset = _fetch(); pc += offset; break; }
+
+	// BBS, BBC, SET1, CLR1
+	case 0x03: case 0x23: case 0x43: case 0x63: case 0x83: case 0xA3: case 0xC3: case 0xE3:
+	case 0x13: case 0x33: case 0x53: case 0x73: case 0x93: case 0xB3: case 0xD3: case 0xF3:
+	{
+		uint8_t value = _read(_dp(_fetch()));
+		bool set = value & (1 << (hi >> 1));
+		branch((hi & 1) ? !set : set);
+		break;
+	}
+	case 0x02: case 0x22: case 0x42: case 0x62: case 0x82: case 0xA2: case 0xC2: case 0xE2:
+	case 0x12: case 0x32: case 0x52: case 0x72: case 0x92: case 0xB2: case 0xD2: case 0xF2:
+	{
+		uint16_t addr = _dp(_fetch());
+		uint8_t mask = 1 << (hi >> 1);
+		uint8_t value = _read(addr);
+		_write(addr, (hi & 1) ? (value & ~mask) : (value | mask));
+		break;
+	}
+
+	// CBNE, DBNZ
+	case 0x2E: { uint8_t value = _read(_dp(_fetch())); branch(a != value); break; }
+	case 0xDE: { uint8_t value = _read(_dp(_fetch() + x)); branch(a != value); break; }
+	case 0x6E:
+	{
+		uint16_t addr = _dp(_fetch());
+		uint8_t value = _read(addr) - 1;
+		_write(addr, value);
+		branch(value != 0);
+		break;
+	}
+	case 0xFE: y--; branch(y != 0); break;
+
+	// TCALL, PCALL, CALL, BRK, RET, RETI, JMP
+	case 0x01: case 0x11: case 0x21: case 0x31: case 0x41: case 0x51: case 0x61: case 0x71:
+	case 0x81: case 0x91: case 0xA1: case 0xB1: case 0xC1: case 0xD1: case 0xE1: case 0xF1:
+	{
+		uint16_t vector = 0xFFDE - (hi << 1);
+		_push(pc >> 8);
+		_push(pc & 0xFF);
+		pc = _read(vector) | (_read(vector + 1) << 8);
+		break;
+	}
+	case 0x4F: { uint8_t offset = _fetch(); _push(pc >> 8); _push(pc & 0xFF); pc = 0xFF00 | offset; break; }
+	case 0x3F: { uint16_t target = _fetchWord(); _push(pc >> 8); _push(pc & 0xFF); pc = target; break; }
+	case 0x0F:
+		_push(pc >> 8);
+		_push(pc & 0xFF);
+		_push(psw);
+		psw = (psw | B_FLAG) & ~I_FLAG;
+		pc = _read(0xFFDE) | (_read(0xFFDF) << 8);
+		break;
+	case 0x6F: { uint16_t low = _pop(); pc = low | (_pop() << 8); break; }
+	case 0x7F: { psw = _pop(); uint16_t low = _pop(); pc = low | (_pop() << 8); break; }
+	case 0x5F: pc = _fetchWord(); break;
+	case 0x1F:
+	{
+		uint16_t addr = _fetchWord() + x;
+		pc = _read(addr) | (_read(addr + 1) << 8);
+		break;
+	}
+
+	// Stack
+	case 0x0D: _push(psw); break;
+	case 0x2D: _push(a); break;
+	case 0x4D: _push(x); break;
+	case 0x6D: _push(y); break;
+	case 0x8E: psw = _pop(); break;
+	case 0xAE: a = _pop(); break;
+	case 0xCE: x = _pop(); break;
+	case 0xEE: y = _pop(); break;
+
+	// Flags
+	case 0x20: psw &= ~P_FLAG; break;
+	case 0x40: psw |= P_FLAG; break;
+	case 0x60: psw &= ~C_FLAG; break;
+	case 0x80: psw |= C_FLAG; break;
+	case 0xA0: psw |= I_FLAG; break;
+	case 0xC0: psw &= ~I_FLAG; break;
+	case 0xE0: psw &= ~(V_FLAG | H_FLAG); break;
+	case 0xED: psw ^= C_FLAG; break;
+
+	// Compares with X and Y
+	case 0x1E: { uint8_t v = _read(_fetchWord()); _cmp(x, v); break; }
+	case 0x3E: { uint8_t v = _read(_dp(_fetch())); _cmp(x, v); break; }
+	case 0x5E: { uint8_t v = _read(_fetchWord()); _cmp(y, v); break; }
+	case 0x7E: { uint8_t v = _read(_dp(_fetch())); _cmp(y, v); break; }
+	case 0xAD: _cmp(y, _fetch()); break;
+	case 0xC8: _cmp(x, _fetch()); break;
+
+	// Test and set/clear
+	case 0x0E: case 0x4E:
+	{
+		uint16_t addr = _fetchWord();
+		uint8_t value = _read(addr);
+		_setNZ(a - value);
+		_write(addr, opcode == 0x0E ? (value | a) : (value & ~a));
+		break;
+	}
+
+	// Bit operations on m.b
+	case 0x0A: case 0x2A: case 0x4A: case 0x6A: case 0x8A: case 0xAA:
+	{
+		uint16_t addr;
+		int bit = memBit(addr);
+		bool value = (_read(addr) >> bit) & 1;
+		bool carry = psw & C_FLAG;
+		switch (opcode)
+		{
+		case 0x0A: carry = carry || value; break;
+		case 0x2A: carry = carry || !value; break;
+		case 0x4A: carry = carry && value; break;
+		case 0x6A: carry = carry && !value; break;
+		case 0x8A: carry = carry != value; break;
+		case 0xAA: carry = value; break;
+		}
+		psw = (psw & ~C_FLAG) | (carry ? C_FLAG : 0);
+		break;
+	}
+	case 0xCA:
+	{
+		uint16_t addr;
+		int bit = memBit(addr);
+		uint8_t value = _read(addr) & ~(1 << bit);
+		_write(addr, value | ((psw & C_FLAG) << bit));
+		break;
+	}
+	case 0xEA:
+	{
+		uint16_t addr;
+		int bit = memBit(addr);
+		_write(addr, _read(addr) ^ (1 << bit));
+		break;
+	}
+
+	// 16-bit operations
+	case 0x1A: case 0x3A:
+	{
+		uint8_t d = _fetch();
+		uint16_t value = _readDPWord(d) + (opcode == 0x3A ? 1 : -1);
+		_writeDPWord(d, value);
+		setNZ16(value);
+		break;
+	}
+	case 0x5A:
+	{
+		uint16_t value = _readDPWord(_fetch());
+		int result = yaWord() - value;
+		psw = (psw & ~C_FLAG) | (result >= 0 ? C_FLAG : 0);
+		setNZ16(result);
+		break;
+	}
+	case 0x7A: case 0x9A:
+	{
+		uint16_t value = _readDPWord(_fetch());
+		uint16_t ya = yaWord();
+		psw &= ~(V_FLAG | H_FLAG | C_FLAG);
+		int result;
+		if (opcode == 0x7A)
+		{
+			result = ya + value;
+			if (result > 0xFFFF) psw |= C_FLAG;
+			if ((ya ^ value ^ result) & 0x1000) psw |= H_FLAG;
+			if (~(ya ^ value) & (ya ^ result) & 0x8000) psw |= V_FLAG;
+		}
+		else
+		{
+			result = ya - value;
+			if (result >= 0) psw |= C_FLAG;
+			if (!((ya ^ value ^ result) & 0x1000)) psw |= H_FLAG;
+			if ((ya ^ value) & (ya ^ result) & 0x8000) psw |= V_FLAG;
+		}
+		setYA(result);
+		setNZ16(result);
+		break;
+	}
+	case 0xBA: { uint16_t value = _readDPWord(_fetch()); setYA(value); setNZ16(value); break; }
+	case 0xDA: _writeDPWord(_fetch(), yaWord()); break;
+
+	// Multiplication and division
+	case 0xCF: { uint16_t result = y * a; setYA(result); _setNZ(y); break; }
+	case 0x9E:
+	{
+		uint16_t ya = yaWord();
+		psw &= ~(V_FLAG | H_FLAG);
+		if (y >= x) psw |= V_FLAG;
+		if ((y & 0x0F) >= (x & 0x0F)) psw |= H_FLAG;
+		if (y < (x << 1))
+		{
+			a = ya / x;
+			y = ya % x;
+		}
+		else
+		{
+			a = 255 - (ya - (x << 9)) / (256 - x);
+			y = x + (ya - (x << 9)) % (256 - x);
+		}
+		_setNZ(a);
+		break;
+	}
+
+	// Decimal adjust, nibble swap
+	case 0xDF:
+		if ((psw & C_FLAG) || a > 0x99) { a += 0x60; psw |= C_FLAG; }
+		if ((psw & H_FLAG) || (a & 0x0F) > 0x09) a += 0x06;
+		_setNZ(a);
+		break;
+	case 0xBE:
+		if (!(psw & C_FLAG) || a > 0x99) { a -= 0x60; psw &= ~C_FLAG; }
+		if (!(psw & H_FLAG) || (a & 0x0F) > 0x09) a -= 0x06;
+		_setNZ(a);
+		break;
+	case 0x9F: a = (a >> 4) | (a << 4); _setNZ(a); break;
+
+	// Register increments
+	case 0x1D: x = _dec(x); break;
+	case 0x3D: x = _inc(x); break;
+	case 0xDC: y = _dec(y); break;
+	case 0xFC: y = _inc(y); break;
+
+	// Loads
+	case 0xE4: a = _read(_dp(_fetch())); _setNZ(a); break;
+	case 0xE5: a = _read(_fetchWord()); _setNZ(a); break;
+	case 0xE6: a = _read(_dp(x)); _setNZ(a); break;
+	case 0xE7: a = _read(indexedIndirect()); _setNZ(a); break;
+	case 0xE8: a = _fetch(); _setNZ(a); break;
+	case 0xF4: a = _read(_dp(_fetch() + x)); _setNZ(a); break;
+	case 0xF5: a = _read(_fetchWord() + x); _setNZ(a); break;
+	case 0xF6: a = _read(_fetchWord() + y); _setNZ(a); break;
+	case 0xF7: a = _read(indirectIndexed()); _setNZ(a); break;
+	case 0xBF: a = _read(_dp(x++)); _setNZ(a); break;
+	case 0xCD: x = _fetch(); _setNZ(x); break;
+	case 0xE9: x = _read(_fetchWord()); _setNZ(x); break;
+	case 0xF8: x = _read(_dp(_fetch())); _setNZ(x); break;
+	case 0xF9: x = _read(_dp(_fetch() + y)); _setNZ(x); break;
+	case 0x8D: y = _fetch(); _setNZ(y); break;
+	case 0xEB: y = _read(_dp(_fetch())); _setNZ(y); break;
+	case 0xEC: y = _read(_fetchWord()); _setNZ(y); break;
+	case 0xFB: y = _read(_dp(_fetch() + x)); _setNZ(y); break;
+
+	// Stores
+	case 0xC4: _write(_dp(_fetch()), a); break;
+	case 0xC5: _write(_fetchWord(), a); break;
+	case 0xC6: _write(_dp(x), a); break;
+	case 0xC7: _write(indexedIndirect(), a); break;
+	case 0xD4: _write(_dp(_fetch() + x), a); break;
+	case 0xD5: _write(_fetchWord() + x, a); break;
+	case 0xD6: _write(_fetchWord() + y, a); break;
+	case 0xD7: _write(indirectIndexed(), a); break;
+	case 0xAF: _write(_dp(x++), a); break;
+	case 0xC9: _write(_fetchWord(), x); break;
+	case 0xD8: _write(_dp(_fetch()), x); break;
+	case 0xD9: _write(_dp(_fetch() + y), x); break;
+	case 0xCB: _write(_dp(_fetch()), y); break;
+	case 0xCC: _write(_fetchWord(), y); break;
+	case 0xDB: _write(_dp(_fetch() + x), y); break;
+	case 0x8F: { uint8_t imm = _fetch(); _write(_dp(_fetch()), imm); break; }
+	case 0xFA: { uint8_t value = _read(_dp(_fetch())); _write(_dp(_fetch()), value); break; }
+
+	// Transfers
+	case 0x5D: x = a; _setNZ(x); break;
+	case 0x7D: a = x; _setNZ(a); break;
+	case 0x9D: x = sp; _setNZ(x); break;
+	case 0xBD: sp = x; break;
+	case 0xDD: a = y; _setNZ(a); break;
+	case 0xFD: y = a; _setNZ(y); break;
+
+	case 0x00: break;
+	case 0xEF: case 0xFF: halted = true; break;
+	}
+
+	return cycles;
+}
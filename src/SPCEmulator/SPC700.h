@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SDSP.h"
+
+namespace AddMusic
+{
+
+/**
+ * @brief The SPC700 CPU of the sound module, with its timers, I/O ports and
+ * the IPL ROM.
+ *
+ * Instructions run whole, each one taking its documented number of cycles.
+ * The CPU ports read back whatever the SNES side was given last with
+ * setInputPort(), since there is no SNES here.
+ */
+class SPC700
+{
+public:
+	/**
+	 * @brief Receives every instruction the CPU runs, with the address it
+	 * was fetched from and the cycles it took.
+	 */
+	class Tracer
+	{
+	public:
+		virtual ~Tracer() = default;
+		virtual void instruction(uint16_t pc, int cycles) = 0;
+	};
+
+	SPC700(uint8_t* ram, SDSP& dsp);
+
+	/**
+	 * @brief Power-on state, with the IPL ROM mapped and the PC at its entry point.
+	 */
+	void reset();
+
+	/**
+	 * @brief Runs at least the given number of cycles and returns how many were run.
+	 */
+	int run(int cycles);
+
+	/**
+	 * @brief Value the SPC700 reads from port (0-3).
+	 */
+	void setInputPort(int port, uint8_t value);
+
+	/**
+	 * @brief Last value the SPC700 wrote to port (0-3).
+	 */
+	uint8_t outputPort(int port) const;
+
+	/**
+	 * @brief Restores the I/O registers ($F0-$FF) from an ARAM snapshot,
+	 * as an SPC file stores them.
+	 */
+	void loadIORegisters(const uint8_t* io);
+
+	/**
+	 * @brief CPU cycles between two increments of a timer's counter (0-2).
+	 */
+	int timerPeriod(int timer) const;
+
+	/**
+	 * @brief Sets the tracer called after every instruction, or stops tracing if null.
+	 */
+	void setTracer(Tracer* newTracer) { tracer = newTracer; }
+
+	// Registers
+	uint16_t pc {0};
+	uint8_t a {0}, x {0}, y {0}, sp {0};
+	uint8_t psw {0};
+
+	/**
+	 * @brief The CPU ran into an instruction that stops it (SLEEP or STOP).
+	 */
+	bool halted {false};
+
+private:
+	struct Timer
+	{
+		int period {0};					// CPU cycles per tick.
+		int cycles {0};
+		int stage {0};
+		uint8_t target {0};
+		uint8_t counter {0};			// 4-bit output counter, cleared when read.
+		bool enabled {false};
+	};
+
+	uint8_t _read(uint16_t addr);
+	void _write(uint16_t addr, uint8_t data);
+	void _runTimers(int cycles);
+
+	uint8_t _fetch() { return _read(pc++); }
+	uint16_t _fetchWord();
+	uint16_t _dp(uint8_t offset) const { return (psw & P_FLAG ? 0x100 : 0) | offset; }
+	uint16_t _readDPWord(uint8_t offset);
+	void _writeDPWord(uint8_t offset, uint16_t value);
+	void _push(uint8_t data);
+	uint8_t _pop();
+	void _setNZ(uint8_t value);
+
+	// ALU
+	uint8_t _or(uint8_t x, uint8_t y);
+	uint8_t _and(uint8_t x, uint8_t y);
+	uint8_t _eor(uint8_t x, uint8_t y);
+	uint8_t _adc(uint8_t x, uint8_t y);
+	uint8_t _sbc(uint8_t x, uint8_t y);
+	uint8_t _cmp(uint8_t x, uint8_t y);
+	uint8_t _asl(uint8_t x);
+	uint8_t _lsr(uint8_t x);
+	uint8_t _rol(uint8_t x);
+	uint8_t _ror(uint8_t x);
+	uint8_t _inc(uint8_t x);
+	uint8_t _dec(uint8_t x);
+
+	int _step();
+
+	static constexpr uint8_t N_FLAG {0x80}, V_FLAG {0x40}, P_FLAG {0x20}, B_FLAG {0x10};
+	static constexpr uint8_t H_FLAG {0x08}, I_FLAG {0x04}, Z_FLAG {0x02}, C_FLAG {0x01};
+
+	uint8_t* ram;
+	SDSP& dsp;
+	Tracer* tracer {nullptr};
+
+	uint8_t control {0};
+	uint8_t dspAddr {0};
+	uint8_t inputPorts[4] {};
+	uint8_t outputPorts[4] {};
+	Timer timers[3];
+};
+
+}
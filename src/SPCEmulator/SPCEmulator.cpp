@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "SPCEmulator.h"
+
+using namespace AddMusic;
+
+// Layout of an SPC file.
+static constexpr size_t SPC_PC {0x25};
+static constexpr size_t SPC_A {0x27};
+static constexpr size_t SPC_X {0x28};
+static constexpr size_t SPC_Y {0x29};
+static constexpr size_t SPC_PSW {0x2A};
+static constexpr size_t SPC_SP {0x2B};
+static constexpr size_t SPC_RAM {0x100};
+static constexpr size_t SPC_DSP {0x10100};
+static constexpr size_t SPC_EXTRA_RAM {0x101C0};		// RAM hidden under the IPL ROM.
+static constexpr size_t SPC_MIN_SIZE {0x10180};
+static const char SPC_SIGNATURE[] {"SNES-SPC700 Sound File Data"};
+
+SPCEmulator::SPCEmulator() :
+	aram(0x10000, 0),
+	sdsp(aram.data()),
+	spc700(aram.data(), sdsp)
+{
+}
+
+bool SPCEmulator::loadSPC(const std::vector<uint8_t>& image)
+{
+	if (image.size() < SPC_MIN_SIZE || std::memcmp(image.data(), SPC_SIGNATURE, sizeof(SPC_SIGNATURE) - 1) != 0)
+		return false;
+
+	std::copy(image.begin() + SPC_RAM, image.begin() + SPC_RAM + 0x10000, aram.begin());
+
+	// The IPL area holds the ROM in the RAM dump. The real RAM below it is stored apart.
+	if (image.size() >= SPC_EXTRA_RAM + 0x40)
+		std::copy(image.begin() + SPC_EXTRA_RAM, image.begin() + SPC_EXTRA_RAM + 0x40, aram.begin() + 0xFFC0);
+
+	sdsp.reset();
+	sdsp.loadRegisters(&image[SPC_DSP]);
+
+	spc700.reset();
+	spc700.loadIORegisters(&aram[0xF0]);
+	spc700.pc = image[SPC_PC] | (image[SPC_PC + 1] << 8);
+	spc700.a = image[SPC_A];
+	spc700.x = image[SPC_X];
+	spc700.y = image[SPC_Y];
+	spc700.psw = image[SPC_PSW];
+	spc700.sp = image[SPC_SP];
+
+	cycleDebt = 0;
+	return true;
+}
+
+void SPCEmulator::render(size_t frames, std::vector<int16_t>& out)
+{
+	out.reserve(out.size() + frames * 2);
+	for (size_t i = 0; i < frames; i++)
+	{
+		cycleDebt += spc700.run(CYCLES_PER_SAMPLE - cycleDebt) - CYCLES_PER_SAMPLE;
+
+		int16_t left, right;
+		sdsp.run(left, right);
+		out.push_back(left);
+		out.push_back(right);
+	}
+}
+
+bool SPCEmulator::writeWAV(const std::string& path, const std::vector<int16_t>& samples)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	auto put16 = [&](uint16_t value) { file.put(value & 0xFF); file.put(value >> 8); };
+	auto put32 = [&](uint32_t value) { put16(value & 0xFFFF); put16(value >> 16); };
+
+	const uint32_t dataSize = samples.size() * 2;
+	file.write("RIFF", 4);
+	put32(36 + dataSize);
+	file.write("WAVEfmt ", 8);
+	put32(16);
+	put16(1);						// PCM
+	put16(2);						// Stereo
+	put32(SAMPLE_RATE);
+	put32(SAMPLE_RATE * 4);			// Bytes per second
+	put16(4);						// Bytes per frame
+	put16(16);						// Bits per sample
+	file.write("data", 4);
+	put32(dataSize);
+	for (int16_t sample : samples)
+		put16(sample);
+
+	return file.good();
+}
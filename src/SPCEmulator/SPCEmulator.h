@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SDSP.h"
+#include "SPC700.h"
+
+namespace AddMusic
+{
+
+/**
+ * @brief Plays SPC files without a SNES: the SPC700 runs the sound driver
+ * stored in the image and the S-DSP turns its register writes into 16-bit
+ * stereo samples at 32 kHz.
+ *
+ * It is meant for listening to compiled songs offline and for comparing
+ * renders between builds, not for accuracy tests: the CPU runs instruction
+ * by instruction and the DSP sample by sample, so timing is exact to the
+ * sample but not to the cycle.
+ */
+class SPCEmulator
+{
+public:
+	static constexpr int SAMPLE_RATE {32000};
+	static constexpr int CYCLES_PER_SAMPLE {32};		// 1.024 MHz SPC700 clock.
+
+	SPCEmulator();
+
+	/**
+	 * @brief Loads the CPU, ARAM and DSP state from an SPC file image.
+	 * Returns false if the image isn't an SPC file.
+	 */
+	bool loadSPC(const std::vector<uint8_t>& image);
+
+	/**
+	 * @brief Runs the given number of stereo frames and appends them to out,
+	 * interleaved left then right.
+	 */
+	void render(size_t frames, std::vector<int16_t>& out);
+
+	/**
+	 * @brief Writes interleaved stereo samples as a 16-bit PCM WAV file.
+	 * Returns false if the file can't be written.
+	 */
+	static bool writeWAV(const std::string& path, const std::vector<int16_t>& samples);
+
+	SPC700& cpu() { return spc700; }
+	SDSP& dsp() { return sdsp; }
+	uint8_t* ram() { return aram.data(); }
+
+private:
+	std::vector<uint8_t> aram;
+	SDSP sdsp;
+	SPC700 spc700;
+	int cycleDebt {0};			// Cycles the CPU ran ahead of the DSP.
+};
+
+}
@@ -46,11 +46,12 @@ endif
 ;!MusicBackup		= !FreeRAM+$08
 !SampleCount		= !FreeRAM+$09
 !SRCNTableBuffer	= !FreeRAM+$0A
+!ResidentGroup		= !FreeRAM+$040A	; Only used with !ResidentSamples.
 
 !Trick   = !FreeRAM+$08
 !Tricker = !BonusEnd
 
-; FREERAM requires anywhere between 2 to potentially 1032 bytes of unused RAM (though somewhere in the range of, say, 100 is much more likely).
+; FREERAM requires anywhere between 2 to potentially 1037 bytes of unused RAM with !ResidentSamples, 1034 without (though somewhere in the range of, say, 100 is much more likely).
 ; Normally you shouldn't need to change this.
 ;
 ; Format:
@@ -64,6 +65,7 @@ endif
 ; FREERAM+$0007: Echo buffer location.  Recommended that you don't touch this unless necessary.  It's modified every time sample upload occurs, and referenced every time music upload occurs.
 ; FREERAM+$0008: Number of samples in current song (between 0 and 255)
 ; FREERAM+$0009: Used as a buffer for the sample pointer/loop table.  Could be up to 1024 bytes long, but this is unlikely (4 bytes per sample; do the math).
+; FREERAM+$040A-$040C: With !ResidentSamples, long pointer to the sample group of the samples currently in ARAM.  Bank $00 means none.
 
 ; 1DFB: Use this to request a song to play (more or less default behavior).
 ; 0DDA: Song to play once star/P-switch runs out.  If $FF, don't restore.
@@ -103,6 +105,14 @@ endif
 !SongCount = $00	; How many songs exist.  Used by the fading routine; changed automatically.
 
 incsrc "tweaks.asm"			
+
+if !FastSPCUpload		; Songs and samples are only uploaded once the engine is running,
+	!UploadSong = UploadSPCDataFast			; so they can use its fast receiver.
+	!UploadBlock = UploadSPCDataDynamicFast
+else
+	!UploadSong = UploadSPCData
+	!UploadBlock = UploadSPCDataDynamic
+endif
 			
 			
 org $0E8000		; Clear out what parts of bank E we can (Lunar Magic install some hacks there).
@@ -410,7 +420,7 @@ endif
 	LDX #!ExpARAMRet
 +	STX $03
 	SEP #$10
-	JSL UploadSPCData
+	JSL !UploadSong
 	
 	
 	;STZ $2140		; $1080a1
@@ -419,6 +429,10 @@ endif
 	
 	LDA !NoUploadSamples
 	BEQ +
+if !ResidentSamples
+	LDA #$00		; \ The song may have been uploaded over the resident samples.
+	STA !ResidentGroup+2	; /
+endif
 	NOP #3			; Missing waiting cycles after UploadSPCData added
 	JMP SPCNormal
 +
@@ -472,6 +486,81 @@ NoAdd:	STA $09			; /
 	ADC $09				; $09 contains the location of the ARAM SRCN table (positions and loop positions).
 	STA $07				; $07 contains where each sample should go in ARAM.
 	
+if !ResidentSamples
+	REP #$30
+	LDX #$0000			; X counts the samples.
+	LDY #$0001			; Y is the position in the sample group. Entries start after the sample count.
+
+.residentLoop
+	CPX $0B
+	BNE +
+	JMP NoMoreSamples
++	PHX				; We use x for indexing as well; push it.
+
+	LDA [$0D],y			; \ Get the next sample. Bit 15 is set if an earlier
+	STA $00				; / entry of this group uploads the same sample.
+	INY : INY			;
+	LDA [$0D],y			; \ Resident samples come with their position in ARAM.
+	STA $07				; /
+	INY : INY			;
+	PHY				; Save the position in the sample group.
+
+	TXA				; \
+	ASL				; |
+	ASL				; | Get index for the SRCN buffer table
+	TAX				; | and save it in Y.
+	TAY				; |
+	INY : INY			; /
+
+	LDA $07
+	STA !SRCNTableBuffer,x
+
+	LDA $00				; \
+	ASL				; | A contains the sample loop position table index (bit 15 is shifted out)
+	TAX				; | X contains the sample loop position table index
+	LDA SampleLoopPtrs,x		; | A contains this sample's loop position
+	CLC				; |
+	ADC $07				; | A contains this sample's loop position relative to its position in ARAM.
+	TYX				; | Copy y (the SRCN buffer table index) to x.
+	STA !SRCNTableBuffer,x		; / Store the loop position to the SRCN table buffer.
+
+	LDA $00				; \ Already uploaded by an earlier entry.
+	BMI .residentNext		; /
+	JSR IsSampleResident		; \ Left at this very address by the last song.
+	BCS .residentNext		; /
+
+	LDA $00				; \
+	ASL				; |
+	CLC				; | Multiply by 3 to index the sample table data.
+	ADC $00				; |
+	TAX				; /
+
+	LDA SamplePtrs,x
+	STA $00
+	INX
+	INX
+
+	SEP #$20
+	LDA SamplePtrs,x
+	STA $02
+
+	REP #$20
+	LDA #!ExpARAMRet
+	STA $03
+	LDA [$00]
+	STA $05
+	BEQ .residentNext		; If the sample's position in the ROM is 0 (which is invalid), skip it; it's empty.
+	INC $00
+	INC $00
+	SEP #$30
+	JSL !UploadBlock
+.residentNext
+	REP #$30
+	PLY
+	PLX
+	INX
+	JMP .residentLoop
+else
 	REP #$30
 	LDX #$0000			; Clear out x and y.
 	LDY #$0000
@@ -535,7 +624,7 @@ NoAdd:	STA $09			; /
 	INC $00
 	INC $00
 	SEP #$30
-	JSL UploadSPCDataDynamic
+	JSL !UploadBlock
 .empty
 	REP #$30			; 10814f
 	LDA $07
@@ -545,8 +634,17 @@ NoAdd:	STA $09			; /
 	PLX
 	INX
 	BRA .loop
+endif
 NoMoreSamples:
 					; $108166
+if !ResidentSamples
+	LDA $0D				; \ Whatever the next song finds in ARAM
+	STA !ResidentGroup		; | is laid out as this song's sample group says.
+	SEP #$20			; |
+	LDA $0F				; |
+	STA !ResidentGroup+2		; |
+	REP #$20			; /
+endif
 	
 	LDA $09				; \ $09 is the address of the ARAM SRCN table.
 	STA $07				; |
@@ -556,10 +654,12 @@ NoMoreSamples:
 	STA $05				; |
 	LDA.w #!SRCNTableBuffer		; |
 	STA $00				; | Upload the ARAM SRCN table.
+	LDA #!ExpARAMRet		; | The sample loop may not have left
+	STA $03				; | this in $03 if it uploaded nothing.
 	SEP #$20			; |
 	LDA.b #!SRCNTableBuffer>>16	; |
 	STA $02				; |
-	JSL UploadSPCDataDynamic	; /
+	JSL !UploadBlock		; /
 
 	LDA $08				; \
 	STA $0C				; | Set the DIR DSP register.
@@ -577,7 +677,7 @@ NoMoreSamples:
 	STA $07				; | 
 	LDA #!DefARAMRet		; |
 	STA $03				; |
-	JSL UploadSPCDataDynamic	; /
+	JSL !UploadBlock		; /
 	SEP #$20
 	NOP #11				; Needed to waste time. 10817b
 					; On ZSNES it works with only 4 NOPs because...ZSNES.
@@ -734,8 +834,167 @@ SkipPowStar:
 	beq +
 	clc
 +	rts
-endif
-	
+endif
+
+if !ResidentSamples
+IsSampleResident:			; Sets the carry if the last song's sample group put sample $00 at ARAM address $07.
+					; A, X and Y must be 16-bit. Clobbers X and Y.
+	LDA $03				; \ $03-$04 hold the ARAM address the SPC jumps to after
+	PHA				; | the next upload, so keep $03-$06 for the caller.
+	LDA $05				; |
+	PHA				; /
+	SEP #$20
+	LDA !ResidentGroup+2		; \ Bank $00: nothing is resident.
+	BEQ .no				; |
+	STA $05				; |
+	REP #$20			; | [$03] is the last song's sample group.
+	LDA !ResidentGroup		; |
+	STA $03				; /
+	LDA [$03]			; \ X counts the entries left to look at.
+	AND #$00FF			; |
+	BEQ .no				; |
+	TAX				; /
+	LDY #$0001
+.scan
+	LDA [$03],y			; \ Same sample...
+	CMP $00				; |
+	BNE .next			; /
+	INY : INY			; \ ...at the same address?
+	LDA [$03],y			; |
+	DEY : DEY			; |
+	CMP $07				; |
+	BEQ .yes			; /
+.next
+	INY : INY : INY : INY
+	DEX
+	BNE .scan
+.no
+	REP #$20
+	CLC
+	BRA .done
+.yes
+	SEC
+.done
+	PLA				; \ Pulling leaves the carry alone.
+	STA $05				; |
+	PLA				; |
+	STA $03				; /
+	RTS
+endif
+
+if !FastSPCUpload
+UploadSPCDataFast:			; Same as UploadSPCData, but sends three bytes per handshake to the
+					; receiver in the engine, so it can't be used to upload the engine itself.
+					; $05-$08 get the size and ARAM address of the block.
+	PHP
+	REP #$30
+	LDA [$00]			; \ The size and the ARAM address
+	STA $05				; | come before the data.
+	LDY #$0002			; |
+	LDA [$00],y			; |
+	STA $07				; |
+	LDY #$0004			; /
+	BRA UploadSPCDataDynamicFast_start
+
+UploadSPCDataDynamicFast:		; Same as UploadSPCDataDynamic, but sends three bytes per handshake.
+					; $05-$08 are not clobbered.
+	PHP
+	REP #$30
+	LDY #$0000
+.start
+	LDA #$BBAA			; \ Wait until SPC700 is ready to recive data
+-	CMP $2140			; |
+	BNE -				; /
+	LDA $07				; \ Mode 2 sends three bytes per handshake.
+	STA $2142			; |
+	SEP #$20			; |
+	LDA #$02			; |
+	STA $2141			; |
+	LDA #$CC			; |
+	STA $2140			; |
+-	CMP $2140			; | Wait until the SPC700 echoes it back.
+	BNE -				; /
+	PHA				; The last counter sent is kept on the stack.
+	LDX $05				; X counts the bytes left.
+	CPX #$0003
+	BCC .tail
+
+.group
+	REP #$20			; \ Bytes 0 and 1 go to $2141-$2142...
+	LDA [$00],y			; |
+	STA $2141			; |
+	INY				; |
+	INY				; |
+	SEP #$20			; |
+	LDA [$00],y			; | ...and byte 2 to $2143.
+	STA $2143			; |
+	INY				; /
+	LDA $01,s			; \ The next counter tells the SPC700 they're ready.
+	INC				; |
+	STA $01,s			; |
+	STA $2140			; |
+-	CMP $2140			; | Wait until it has read them.
+	BNE -				; /
+	DEX
+	DEX
+	DEX
+	CPX #$0003
+	BCS .group
+
+.tail
+	INC				; \ Anything but the next counter ends the fast block.
+	INC				; | It must not be 0 either, or the byte by byte
+	BNE +				; | transfer below would start right away.
+	INC				; |
++	STA $01,s			; /
+	CPX #$0000
+	BEQ .finish
+	REP #$20			; \ The last one or two bytes go byte by byte,
+	TXA				; | right after the others.
+	EOR #$FFFF			; |
+	SEC				; |
+	ADC $05				; |
+	CLC				; |
+	ADC $07				; |
+	STA $2142			; |
+	SEP #$20			; |
+	LDA #$01			; |
+	STA $2141			; |
+	LDA $01,s			; |
+	STA $2140			; |
+-	CMP $2140			; |
+	BNE -				; /
+	LDA #$00			; \ Same handshake as UploadSPCData.
+.byte					; |
+	XBA				; |
+	LDA [$00],y			; |
+	INY				; |
+	STA $2141			; |
+	XBA				; |
+	STA $2140			; |
+-	CMP $2140			; |
+	BNE -				; |
+	INC				; |
+	DEX				; |
+	BNE .byte			; /
+	INC				; \ The counter after the next one ends the block.
+	STA $01,s			; /
+
+.finish
+	REP #$20			; \ Jump to $03 once the upload is done.
+	LDA $03				; |
+	STA $2142			; |
+	SEP #$20			; |
+	STZ $2141			; |
+	LDA $01,s			; |
+	STA $2140			; |
+-	CMP $2140			; |
+	BNE -				; /
+	PLA
+	PLP
+	RTL
+endif
+	
 pushpc
 
 incsrc "SongSampleList.asm"
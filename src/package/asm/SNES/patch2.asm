@@ -155,6 +155,9 @@ UploadSPCEngine:
 		STA !FreeRAM+6
 		STA !FreeRAM+8
 		STA !FreeRAM+10
+if !ResidentSamples
+		STA !ResidentGroup+1		; Nothing is resident in a freshly uploaded engine.
+endif
 		SEP #$20
 		RTS                     	;
 		;print pc
@@ -228,6 +228,33 @@ includeonce
 ; or collecting another star).
 ;=======================================
 
+;=======================================
+;---------------
+!ResidentSamples = !false
+
+;Default setting: !false
+;---------------
+; SNES-side only. If you set this to true, every local song's samples get a
+; fixed ARAM address, with the samples shared by the most songs first. When
+; the song changes, samples that the previous song left at the same address
+; are not uploaded again, which shortens level transitions with big sample
+; sets. AddmusicK reads this setting to lay out the sample groups, so it
+; needs to be run again after changing it. It takes 3 more bytes of FreeRAM,
+; up to !FreeRAM+$040C (see asm/SNES/patch.asm).
+;=======================================
+
+;=======================================
+;---------------
+!FastSPCUpload = !false
+
+;Default setting: !false
+;---------------
+; If you set this to true, song data and samples are sent to the SPC700
+; three bytes per handshake instead of one, which makes loading a song
+; quicker. The engine itself is still uploaded the normal way. Both the SNES
+; side and the engine change, so don't mix it with a custom upload routine.
+;=======================================
+
 ;=======================================
 ; If you've changed list.txt and plan on using the original SMW songs
 ; change these constants to whatever they are in list.txt
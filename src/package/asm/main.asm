@@ -1674,14 +1674,18 @@ if !PSwitchIsSFX = !true
 	cmp	$03, #$81			;
 	bcs	.PSwitchSFX
 endif
+	print "RelocSFXTable1: $",pc
 	mov	a, SFXTable1-1+y		; \
 	push	a				; | Move the pointer to the current SFX to the correct pointer.
+	print "RelocSFXTable1: $",pc
 	mov	a, SFXTable1-2+y		; |
 	bra	.gottenPointer			;
 						;
 .loadFromSFXTable0				;
+	print "RelocSFXTable0: $",pc
 	mov	a, SFXTable0-1+y		; \
 	push	a				; |
+	print "RelocSFXTable0: $",pc
 	mov	a, SFXTable0-2+y		; /
 if !PSwitchIsSFX = !true
 	bra	.gottenPointer
@@ -2087,9 +2091,11 @@ L_0B5A:
 	mov	$0c,#$02		;
 	asl	a			; Turn A from a song number into a pointer
 	mov	y, a		
+	print "RelocSongPointers: $",pc
 	mov	a, SongPointers-$02+y	; Get the pointer for the current song
 	push	a				; MODIFIED
 	mov	$40, a
+	print "RelocSongPointers: $",pc
 	mov	a, SongPointers-$01+y
 	push	a				; MODIFIED
 	mov	$41, a		; $40.w now points to the current song.
@@ -3559,6 +3565,11 @@ Start:
 	movw	$14, ya		; Get address from 5A22's $2142-3, 
 	movw	ya, $F4		; mode from $2141, and echo $2140 back
 	mov	$F4, a
+if !FastSPCUpload = !true
+	mov	x, a		; Keep the echoed value: FastTrans counts from it.
+	cmp	y, #$02
+	beq	FastTrans	; Mode 2: three bytes per handshake.
+endif
 	mov	a, y
 	mov	x, a
 	bne	Trans		; Mode non-0: begin transfer	
@@ -3609,6 +3620,40 @@ endif
 JumpToUploadLocation:
 	jmp	($0014+x)		; Jump to address	
 
+if !FastSPCUpload = !true
+FastTrans:
+	mov	y, #$00		; *** FAST TRANSFER ROUTINE ***
+FastWait:			; The 5A22 puts three bytes in $2141-3, then the next counter in $2140.
+	cmp	x, $F4		; X is the last counter echoed back.
+	beq	FastWait
+	inc	x
+	cmp	x, $F4		; Any other value ends the block: $2141-3 already hold
+	bne	Start		; the next block's mode and address.
+	mov	a, $F5
+	mov	($14)+y, a
+	inc	y
+	beq	FastPage0
+FastByte1:
+	mov	a, $F6
+	mov	($14)+y, a
+	inc	y
+	beq	FastPage1
+FastByte2:
+	mov	a, $F7
+	mov	$F4, x		; All three bytes are read: let the 5A22 send the next ones.
+	mov	($14)+y, a
+	inc	y
+	bne	FastWait
+	inc	$15
+	bra	FastWait
+FastPage0:
+	inc	$15		; (handle $xxFF->$xx00 overflow case on increment)
+	bra	FastByte1
+FastPage1:
+	inc	$15
+	bra	FastByte2
+endif
+
 	incsrc "InstrumentData.asm"
 	
 
@@ -3624,6 +3669,9 @@ APU1GirderClickSFXSequence:
 	db $DA,$07,$0C,$28,$A4,$A4,$00
 endif
 
+	; The SFX tables, SFX data and song pointers are appended after this point by AddmusicK.
+	; Any instruction that reads one of these labels must be preceded by a
+	; print "Reloc<label>: $",pc line, so the appended data can be linked without reassembling.
 	SFXTable0:
 	SFXTable1:
 endif
@@ -0,0 +1,201 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "MMLBase.h"
+#include "Music.h"
+#include "ROMEnvironment.h"
+#include "SPCEnvironment.h"
+#include "SyntheticROM.h"
+#include "Utility.h"
+
+// Timings of the compile pipeline hot paths. Run with "-r xml" (or the
+// run_benchmarks target) to get the results in a machine-readable form.
+
+using namespace AddMusic;
+namespace fs = std::filesystem;
+
+const fs::path WORK_DIR {"../boilerplate"};
+const fs::path BENCH_OUTPUT_DIR {"bench_output"};
+
+/**
+ * Opens up the stages of SPCEnvironment::generateSPCFiles() so that they can
+ * be timed one by one.
+ */
+class BenchmarkEnvironment : public SPCEnvironment
+{
+public:
+    using SPCEnvironment::SPCEnvironment;
+    using SPCEnvironment::_compileMusic;
+    using SPCEnvironment::_fixMusicPointers;
+    using SPCEnvironment::_generateSPCs;
+
+    /**
+     * Everything generateSPCFiles() does before compiling the songs.
+     */
+    void prepare(const std::vector<fs::path>& localSongs)
+    {
+        fs::create_directories(BENCH_OUTPUT_DIR);
+        _prepareBuild(localSongs, BENCH_OUTPUT_DIR);
+    }
+
+    /**
+     * Fills the sample table with unique samples, so that every sample a song
+     * adds is checked for duplicates against all of them.
+     */
+    void padSamples(size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            Sample sample;
+            sample.name = "padding/" + std::to_string(i) + ".brr";
+            sample.data.assign(9 * (1 + i % 64), 0);
+            sample.data.back() = i & 0xFF;
+            sample.exists = true;
+            samples.push_back(std::move(sample));
+        }
+    }
+};
+
+/**
+ * Runs only the preprocessor of a MML file.
+ */
+class Preprocessor : public MMLBase
+{
+public:
+    void compile(SPCEnvironment*) override {}
+
+    void run(const std::string& source)
+    {
+        text = source;
+        preprocess();
+    }
+};
+
+static std::vector<fs::path> originalSongs()
+{
+    std::vector<fs::path> songs;
+    for (const auto& entry : fs::directory_iterator(WORK_DIR / "music" / "originals"))
+        if (entry.path().extension() == ".txt")
+            songs.push_back(fs::absolute(entry.path()));
+    std::sort(songs.begin(), songs.end());
+    return songs;
+}
+
+TEST_CASE("MMLBase::preprocess", "[benchmark][preprocess]")
+{
+    std::vector<std::string> sources;
+    for (const fs::path& song : originalSongs())
+    {
+        sources.emplace_back();
+        readTextFile(song, sources.back());
+    }
+    REQUIRE(!sources.empty());
+
+    BENCHMARK("Preprocess every original song")
+    {
+        Preprocessor preprocessor;
+        for (const std::string& source : sources)
+            preprocessor.run(source);
+        return sources.size();
+    };
+}
+
+TEST_CASE("Music::compile", "[benchmark][compile]")
+{
+    BenchmarkEnvironment spc (WORK_DIR);
+    spc.prepare(originalSongs());
+
+    BENCHMARK("Compile every original song")
+    {
+        return spc._compileMusic();
+    };
+}
+
+TEST_CASE("addSample with duplicate checking", "[benchmark][samples]")
+{
+    const std::vector<fs::path> songs = originalSongs();
+
+    for (size_t padding : {0, 1024, 4096})
+    {
+        BenchmarkEnvironment spc (WORK_DIR);
+        spc.options.dupCheck = true;
+        spc.prepare(songs);
+        spc.padSamples(padding);
+
+        BENCHMARK("Compile every original song with " + std::to_string(padding) + " other samples loaded")
+        {
+            return spc._compileMusic();
+        };
+    }
+}
+
+/**
+ * Lets a cleanup run again on the ROM as it was loaded.
+ */
+class BenchmarkROMEnvironment : public ROMEnvironment
+{
+public:
+    using ROMEnvironment::ROMEnvironment;
+    using ROMEnvironment::rom;
+};
+
+TEST_CASE("ROMEnvironment::findFreeSpace", "[benchmark][rom]")
+{
+    const fs::path romFile = BENCH_OUTPUT_DIR / "synthetic.sfc";
+    fs::create_directories(BENCH_OUTPUT_DIR);
+
+    for (unsigned int megabytes : {1, 2, 4, 8})
+    {
+        SyntheticROM fixture ({1, megabytes, false, megabytes == 8, ROMState::Clean, 75});
+        fixture.write(romFile);
+
+        ROMEnvironment env (romFile, WORK_DIR);
+        std::vector<uint8_t> scratch = fixture.image();
+        REQUIRE(env.findFreeSpace(0x7FF0, 0x080000, scratch) != -1);
+
+        BENCHMARK_ADVANCED("Find a free bank in a fragmented " + std::to_string(megabytes) + " MB ROM")(Catch::Benchmark::Chronometer meter)
+        {
+            std::vector<std::vector<uint8_t>> roms (meter.runs(), fixture.image());
+            meter.measure([&](int i) { return env.findFreeSpace(0x7FF0, 0x080000, roms[i]); });
+        };
+    }
+}
+
+TEST_CASE("ROMEnvironment::_cleanROM", "[benchmark][rom]")
+{
+    const fs::path romFile = BENCH_OUTPUT_DIR / "synthetic.sfc";
+    fs::create_directories(BENCH_OUTPUT_DIR);
+
+    for (ROMState state : {ROMState::AddmusicK, ROMState::SampleTool})
+    {
+        SyntheticROM fixture ({1, 4, false, false, state, 50});
+        fixture.write(romFile);
+
+        BenchmarkROMEnvironment env (romFile, WORK_DIR);
+
+        BENCHMARK(std::string("Clean a 4 MB ROM patched by ") + (state == ROMState::AddmusicK ? "AddmusicK" : "Sample Tool"))
+        {
+            env.rom = fixture.image();
+            return env._cleanROM();
+        };
+    }
+}
+
+TEST_CASE("SPCEnvironment::_generateSPCs", "[benchmark][spc]")
+{
+    BenchmarkEnvironment spc (WORK_DIR);
+    spc.prepare(originalSongs());
+    spc._compileMusic();
+    spc._fixMusicPointers();
+
+    BENCHMARK("Dump the SPC of every original song")
+    {
+        return spc._generateSPCs();
+    };
+}
@@ -1,16 +1,34 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 
+#include <algorithm>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 #include <filesystem>
 #include <iostream>
 #include <type_traits>
 
+#include "ARAMVisualizer.h"
 #include "asarBinding.h"
+#include "CompileServer.h"
+#include "DriverProfiler.h"
+#include "InMemoryProject.h"
 #include "Utility.h"
 #include "Package.h"
+#include "ROMEnvironment.h"
+#include "SampleCache.h"
+#include "SampleLayout.h"
+#include "SPCEmulator.h"
 #include "SPCEnvironment.h"
+#include "SPCPack.h"
+#include "SyntheticCorpus.h"
+#include "SyntheticROM.h"
+#include "SongObject.h"
+#include "SongWatcher.h"
+#include "TimeReport.h"
+#include "ZipArchive.h"
 
 using namespace AddMusic;
 namespace fs = std::filesystem;
@@ -142,6 +160,649 @@ TEST_CASE("hexDump testing", "[utility][hexdump]")
     REQUIRE(t_32 == "00000025");
 }
 
+TEST_CASE("CRC-32 and store-only ZIP archives", "[utility][zip]")
+{
+    const std::string check {"123456789"};
+    REQUIRE(crc32(reinterpret_cast<const uint8_t*>(check.data()), check.size()) == 0xCBF43926);
+
+    const fs::path ZIP_FILENAME = "archive.zip";
+    std::vector<uint8_t> payload(0x10200, 0x55);
+    {
+        ZipWriter zip (ZIP_FILENAME);
+        zip.addFile("song.spc", payload);
+        zip.addFile("1DF9/sfx.spc", check);
+        REQUIRE(zip.entryCount() == 2);
+        zip.close();
+    }
+
+    std::vector<uint8_t> zipdata;
+    readBinaryFile(ZIP_FILENAME, zipdata);
+
+    // Two local headers, two central directory entries and the end record.
+    const size_t expected = (30 + 8 + payload.size()) + (30 + 12 + check.size()) + (46 + 8) + (46 + 12) + 22;
+    REQUIRE(zipdata.size() == expected);
+    REQUIRE(zipdata[0] == 'P');
+    REQUIRE(zipdata[1] == 'K');
+    REQUIRE(zipdata[expected - 22] == 'P');
+    REQUIRE(zipdata[expected - 22 + 10] == 2);      // Entry count
+
+    // An archive abandoned before close(), e.g. by an exception, is not left behind.
+    const fs::path PARTIAL_FILENAME = "partial.zip";
+    try
+    {
+        ZipWriter zip (PARTIAL_FILENAME);
+        zip.addFile("song.spc", payload);
+        throw std::runtime_error("interrupted");
+    }
+    catch (const std::runtime_error&) {}
+    REQUIRE_FALSE(fs::exists(PARTIAL_FILENAME));
+}
+
+TEST_CASE("SPC packs expand bit-exact images", "[spcpack]")
+{
+    const fs::path PACK_FILENAME = "test.spcpack";
+
+    std::vector<uint8_t> base(0x10200);
+    for (size_t i = 0; i < base.size(); i++)
+        base[i] = (i * 7) & 0xFF;
+
+    std::vector<uint8_t> sample(900, 0xA5);
+    std::vector<std::vector<uint8_t>> images {base, base};
+    std::vector<SPCSamplePlacement> placements {{3, 0x4100}};
+
+    // First image: a sample, a song and a header field. Second one: only a few scattered bytes.
+    std::copy(sample.begin(), sample.end(), images[0].begin() + 0x4100);
+    std::fill(images[0].begin() + 0x2100, images[0].begin() + 0x2500, 0x11);
+    images[0][0x2E] = 'A';
+    images[1][0x1F6] = 1;
+    images[1][0x1F9] = 2;
+    images[1][0x10100] = 3;
+    {
+        SPCPackWriter pack (PACK_FILENAME, base);
+        pack.addSample(3, sample);
+        pack.addSPC("song.spc", images[0], placements);
+        pack.addSPC("1DF9/sfx.spc", images[1], {});
+        REQUIRE(pack.packedSize() < base.size() + sample.size() + 0x600);
+        pack.close();
+    }
+
+    SPCPackReader pack (PACK_FILENAME);
+    REQUIRE(pack.size() == 2);
+    REQUIRE(pack.name(1) == "1DF9/sfx.spc");
+
+    std::vector<uint8_t> expanded;
+    for (size_t i = 0; i < pack.size(); i++)
+    {
+        pack.expand(i, expanded);
+        REQUIRE(expanded == images[i]);
+    }
+
+    // Names that would escape the output folder are refused.
+    for (const std::string& name : {"../escape.spc", "1DF9/../../escape.spc", "/escape.spc"})
+    {
+        {
+            SPCPackWriter crafted (PACK_FILENAME, base);
+            crafted.addSPC(name, images[1], {});
+            crafted.close();
+        }
+        REQUIRE_THROWS(SPCPackReader(PACK_FILENAME).expandAll("spcpack_output"));
+        REQUIRE_FALSE(fs::exists("escape.spc"));
+    }
+
+    // A pack that was never closed does not stay behind.
+    {
+        SPCPackWriter unfinished (PACK_FILENAME, base);
+        unfinished.addSPC("song.spc", images[0], {});
+    }
+    REQUIRE_FALSE(fs::exists(PACK_FILENAME));
+}
+
+TEST_CASE("Sample cache persistence and invalidation", "[samplecache]")
+{
+    const fs::path BRR_FILENAME = "cached.brr",
+        CACHE_FILENAME = "samples.cache";
+
+    std::vector<uint8_t> brr {0x09, 0x00, 0xB0, 1, 2, 3, 4, 5, 6, 7, 8};
+    writeBinaryFile(BRR_FILENAME, brr);
+    fs::remove(CACHE_FILENAME);
+
+    {
+        SampleCache cache;
+        REQUIRE_FALSE(cache.load(CACHE_FILENAME));
+        REQUIRE(cache.find(BRR_FILENAME) == nullptr);
+
+        SampleCache::CachedSample parsed;
+        parsed.loopPoint = 9;
+        parsed.data.assign(brr.begin() + 2, brr.end());
+        cache.store(BRR_FILENAME, {parsed});
+        cache.save(CACHE_FILENAME);
+    }
+
+    SampleCache cache;
+    REQUIRE(cache.load(CACHE_FILENAME));
+    const auto* cached = cache.find(BRR_FILENAME);
+    REQUIRE(cached != nullptr);
+    REQUIRE(cached->size() == 1);
+    REQUIRE(cached->front().loopPoint == 9);
+    REQUIRE(cached->front().data == std::vector<uint8_t>(brr.begin() + 2, brr.end()));
+
+    // A corrupt sample count is refused instead of allocated.
+    std::vector<uint8_t> corrupt;
+    readBinaryFile(CACHE_FILENAME, corrupt);
+    std::fill_n(corrupt.begin() + 8 + 4 + 4 + BRR_FILENAME.string().size() + 8 + 8, 4, 0xFF);
+    writeBinaryFile(CACHE_FILENAME, corrupt);
+    SampleCache corrupted;
+    REQUIRE_FALSE(corrupted.load(CACHE_FILENAME));
+    REQUIRE(corrupted.find(BRR_FILENAME) == nullptr);
+
+    // A file of a different size is a different sample.
+    brr.insert(brr.end(), 9, 0);
+    writeBinaryFile(BRR_FILENAME, brr);
+    REQUIRE(cache.find(BRR_FILENAME) == nullptr);
+}
+
+TEST_CASE("Song objects link anywhere and survive a round trip to disk", "[songobject]")
+{
+    const fs::path OBJECT_FILENAME = "song.obj";
+
+    SongObject object;
+    object.code.resize(8, 0x11);
+    object.setPointer(0, 0x0004);
+    object.setWord(2, 0x00FF);
+    object.setPointer(4, 0x0006);
+    object.symbols["phrases"] = 4;
+
+    std::vector<uint8_t> linked {'S', 'T', 'A', 'R'};
+    object.link(0x2000, linked);
+    REQUIRE(linked == std::vector<uint8_t> {'S', 'T', 'A', 'R', 0x04, 0x20, 0xFF, 0x00, 0x06, 0x20, 0x11, 0x11});
+    REQUIRE(object.symbolAddress("phrases", 0x2000) == 0x2004);
+    REQUIRE(object.symbolAddress("missing", 0x2000) == -1);
+
+    object.save(OBJECT_FILENAME);
+    SongObject loaded;
+    REQUIRE(loaded.load(OBJECT_FILENAME));
+    REQUIRE(loaded.code == object.code);
+    REQUIRE(loaded.relocations.size() == 2);
+    REQUIRE(loaded.symbols == object.symbols);
+
+    // Linking the same object somewhere else only moves the relocated words.
+    std::vector<uint8_t> moved;
+    loaded.link(0x3100, moved);
+    REQUIRE(moved == std::vector<uint8_t> {0x04, 0x31, 0xFF, 0x00, 0x06, 0x31, 0x11, 0x11});
+
+    // A corrupt relocation count is refused instead of allocated.
+    std::vector<uint8_t> corrupt;
+    readBinaryFile(OBJECT_FILENAME, corrupt);
+    std::fill_n(corrupt.begin() + 8 + 4 + object.code.size(), 4, 0xFF);
+    writeBinaryFile(OBJECT_FILENAME, corrupt);
+    REQUIRE_FALSE(loaded.load(OBJECT_FILENAME));
+    REQUIRE(loaded.relocations.empty());
+}
+
+TEST_CASE("Compiled songs are move-only", "[songobject][compiledsong]")
+{
+    REQUIRE_FALSE(std::is_copy_constructible_v<CompiledSong>);
+    REQUIRE(std::is_nothrow_move_constructible_v<CompiledSong>);
+
+    CompiledSong song;
+    song.exists = true;
+    song.object.code.assign(0x100, 0);
+    song.mySamples = {0, 1, 2};
+
+    std::vector<CompiledSong> songs(2);
+    songs[1] = std::move(song);
+    REQUIRE(songs[1].exists);
+    REQUIRE(songs[1].object.code.size() == 0x100);
+    REQUIRE(songs[1].mySamples.size() == 3);
+}
+
+TEST_CASE("Resident sample layout keeps shared samples in place", "[samplelayout]")
+{
+    // Samples 1 and 2 are shared, 0, 3 and 4 are used by one song each.
+    SampleLayoutOptimizer optimizer ({0x100, 0x200, 0x50, 0x300, 0x80});
+    optimizer.addSong({0, 1, 2});
+    optimizer.addSong({2, 1, 1});
+    optimizer.addSong({2, 3});
+    optimizer.addSong({4, 2});
+
+    std::vector<unsigned short> order = optimizer.optimize();
+    REQUIRE(order.size() == 5);
+    REQUIRE(std::is_permutation(order.begin(), order.end(), std::vector<unsigned short> {0, 1, 2, 3, 4}.begin()));
+    REQUIRE(std::vector<unsigned short>(order.begin() + 2, order.end()) == std::vector<unsigned short> {0, 3, 4});
+
+    // No order does better than the one found.
+    std::vector<unsigned short> permutation {0, 1, 2, 3, 4};
+    long long best = optimizer.uploadBytes(order);
+    do
+        REQUIRE(optimizer.uploadBytes(permutation) >= best);
+    while (std::next_permutation(permutation.begin(), permutation.end()));
+
+    // Sample 2 goes first, so every song change keeps it.
+    REQUIRE(order.front() == 2);
+    REQUIRE(best == optimizer.fullUploadBytes() - 12 * 0x50 - 2 * 0x200);
+    REQUIRE(optimizer.fullUploadBytes() == 3 * (0x350 + 0x250 + 0x350 + 0xD0));
+}
+
+TEST_CASE("ARAM map of a local song", "[aramvisualizer]")
+{
+    SpaceInfo space;
+    space.songStartPos = 0x1800;
+    space.songEndPos = 0x2000;
+    space.sampleTableStartPos = 0x2000;
+    space.sampleTableEndPos = 0x2008;
+    space.individualSampleStartPositions = {0x2008, 0x2100};
+    space.individualSampleEndPositions = {0x2100, 0x2200};
+    space.individialSampleIsImportant = {true, false};
+    space.importantSampleCount = 1;
+    space.echoBufferStartPos = 0xF800;
+    space.echoBufferEndPos = 0x10000;
+
+    // Every byte of ARAM gets a pixel of its own.
+    std::vector<bool> used (ARAMVisualizer::WIDTH * ARAMVisualizer::HEIGHT, false);
+    for (int address = 0; address < 0x10000; address++)
+        used.at(ARAMVisualizer::pixelOf(address)) = true;
+    REQUIRE(std::count(used.begin(), used.end(), true) == 0x10000);
+    REQUIRE(ARAMVisualizer::pixelOf(15) == 15 * ARAMVisualizer::WIDTH);
+    REQUIRE(ARAMVisualizer::pixelOf(16) == 1);
+
+    const std::vector<uint8_t> image = ARAMVisualizer::render(space, 0x400);
+    auto color = [&](int address)
+    {
+        const size_t pixel = ARAMVisualizer::pixelOf(address) * 3;
+        return std::vector<uint8_t> {image[pixel], image[pixel + 1], image[pixel + 2]};
+    };
+    REQUIRE(color(0x0000) == std::vector<uint8_t> {0xFF, 0x00, 0x00});
+    REQUIRE(color(0x0400) == std::vector<uint8_t> {0xFF, 0xFF, 0x00});
+    REQUIRE(color(0x1FFF) == std::vector<uint8_t> {0x00, 0x80, 0x00});
+    REQUIRE(color(0x2004) == std::vector<uint8_t> {0x80, 0xFF, 0x80});
+    REQUIRE(color(0x2008) == std::vector<uint8_t> {0x00, 0xFF, 0xFF});
+    REQUIRE(color(0x21FF) == std::vector<uint8_t> {0x00, 0x00, 0xA0});
+    REQUIRE(color(0x2200) == std::vector<uint8_t> {0x00, 0x00, 0x00});
+    REQUIRE(color(0xFFFF) == std::vector<uint8_t> {0x80, 0x00, 0x80});
+}
+
+TEST_CASE("In-memory project compiles like its work directory", "[inmemoryproject]")
+{
+    auto project = std::make_shared<InMemoryProject>();
+    readTextFile(TEST_WORKDIR / DEFAULT_SONGLIST_FILENAME, project->songList);
+    readTextFile(TEST_WORKDIR / DEFAULT_SAMPLELIST_FILENAME, project->sampleGroups);
+    readTextFile(TEST_WORKDIR / DEFAULT_SFXLIST_FILENAME, project->soundEffects);
+    for (auto& file_i : fs::recursive_directory_iterator(TEST_WORKDIR))
+    {
+        const fs::path key = file_i.path().lexically_relative(TEST_WORKDIR);
+        const std::string extension = file_i.path().extension().string();
+        if (extension == ".txt" && key.begin()->string() != "stats")
+            readTextFile(file_i.path(), project->texts[key]);
+        else if (extension == ".brr" || extension == ".bnk")
+            readBinaryFile(file_i.path(), project->binaries[key]);
+    }
+
+    fs::path song;
+    for (auto& file_i : fs::directory_iterator(TEST_WORKDIR / "music"))
+        if (file_i.path().extension().string() == ".txt")
+            song = file_i.path().lexically_relative(TEST_WORKDIR);
+    REQUIRE_FALSE(song.empty());
+
+    EnvironmentOptions opts;
+    opts.verbose = false;
+
+    // Only one environment can have the driver extracted at a time.
+    std::vector<uint8_t> fromDisk;
+    {
+        SPCEnvironment spc (TEST_WORKDIR, opts);
+        fromDisk = spc.compileSPC(fs::absolute(TEST_WORKDIR / song));
+    }
+
+    // The work directory of the project does not exist.
+    const fs::path work = "in_memory_project";
+    REQUIRE_FALSE(fs::exists(work));
+    SPCEnvironment spc (work, project, opts);
+    const std::vector<uint8_t> fromMemory = spc.compileSPC(work / song);
+
+    // The header carries the dump date.
+    REQUIRE(fromMemory.size() == fromDisk.size());
+    REQUIRE(std::equal(fromMemory.begin() + 0x100, fromMemory.end(), fromDisk.begin() + 0x100));
+    REQUIRE_FALSE(fs::exists(work));
+}
+
+TEST_CASE("Watch mode rebuilds the songs a change affects", "[songwatcher]")
+{
+    const fs::path work = "watch_env";
+    SongDependencies dependencies (work);
+    dependencies.setSong(work / "music" / "a.txt", {work / "samples" / "a" / "kick.brr", work / "samples" / "shared.brr"}, true);
+    dependencies.setSong(work / "music" / "b.txt", {work / "samples" / "./shared.brr"}, true);
+    dependencies.setSong(fs::path("elsewhere") / "c.txt", {}, false);
+
+    auto songs = [](const SongDependencies::Rebuild& rebuild)
+    {
+        std::set<std::string> names;
+        for (const fs::path& song : rebuild.songs)
+            names.insert(song.filename().string());
+        return names;
+    };
+
+    SongDependencies::Rebuild rebuild = dependencies.affectedBy({work / "music" / "a.txt"});
+    REQUIRE_FALSE(rebuild.reload);
+    REQUIRE(songs(rebuild) == std::set<std::string> {"a.txt"});
+
+    // c.txt failed to compile, so any new or changed sample is worth a retry.
+    rebuild = dependencies.affectedBy({work / "samples" / "shared.brr"});
+    REQUIRE(rebuild.reload);
+    REQUIRE(songs(rebuild) == std::set<std::string> {"a.txt", "b.txt", "c.txt"});
+
+    rebuild = dependencies.affectedBy({work / "samples" / "new.BRR"});
+    REQUIRE_FALSE(rebuild.reload);
+    REQUIRE(songs(rebuild) == std::set<std::string> {"c.txt"});
+
+    rebuild = dependencies.affectedBy({work / "music" / "a.txt.swp", work / "out" / "a.spc"});
+    REQUIRE_FALSE(rebuild.reload);
+    REQUIRE(rebuild.songs.empty());
+
+    rebuild = dependencies.affectedBy({work / DEFAULT_SAMPLELIST_FILENAME});
+    REQUIRE(rebuild.reload);
+    REQUIRE(rebuild.songs.size() == 3);
+
+    const std::set<fs::path> folders = dependencies.folders();
+    REQUIRE(folders.count(fs::absolute(work / "samples" / "a")) == 1);
+    REQUIRE(folders.count(fs::absolute("elsewhere")) == 1);
+}
+
+TEST_CASE("Synthetic corpus is deterministic", "[corpus]")
+{
+    SyntheticCorpus small ({7, 10, 0});
+    SyntheticCorpus large ({7, 1000, 20});
+    SyntheticCorpus other ({8, 10, 0});
+
+    REQUIRE(small.song(3) == SyntheticCorpus({7, 10, 0}).song(3));
+    REQUIRE(small.song(3) == large.song(3));
+    REQUIRE(small.song(3) != other.song(3));
+    REQUIRE(small.sampleCount() == 20);
+
+    for (unsigned int i = 0; i < small.sampleCount(); i++)
+    {
+        std::vector<uint8_t> brr = small.sample(i);
+        REQUIRE((brr.size() - 2) % 9 == 0);
+        REQUIRE(brr == large.sample(i));
+        REQUIRE((brr[brr.size() - 9] & 1) == 1);     // End flag on the last block.
+    }
+}
+
+/**
+ * Exposes the ROM of a ROMEnvironment once it has been cleaned.
+ */
+class CleanedROM : public ROMEnvironment
+{
+public:
+    using ROMEnvironment::ROMEnvironment;
+    using ROMEnvironment::rom;
+    using ROMEnvironment::usingSA1;
+};
+
+TEST_CASE("ROM cleanup on synthetic ROMs", "[romenvironment][cleanup]")
+{
+    const fs::path romFile {"synthetic.sfc"};
+
+    for (unsigned int megabytes : {1, 2, 4, 8})
+    {
+        for (ROMState state : {ROMState::Clean, ROMState::AddmusicK, ROMState::SampleTool})
+        {
+            SyntheticROM fixture ({5, megabytes, megabytes == 2, megabytes == 8, state, 50});
+            fixture.write(romFile);
+
+            CleanedROM env (romFile, WORK_DIR);
+            REQUIRE(env.usingSA1 == (megabytes == 8));
+            REQUIRE(env.rom.size() == megabytes * 0x100000);
+
+            // The previous tool's data is gone, nobody else's is touched.
+            for (int tag : fixture.toolBlocks())
+                REQUIRE(!env.findRATS(tag));
+            for (int tag : fixture.foreignBlocks())
+                REQUIRE(env.findRATS(tag));
+            if (state == ROMState::Clean)
+                REQUIRE(env.rom == fixture.image());
+        }
+    }
+
+    // Addmusic 4.05 and AddmusicM can only be removed from headered ROMs.
+    for (ROMState state : {ROMState::AM405, ROMState::AddmusicM})
+    {
+        SyntheticROM({5, 2, false, false, state, 50}).write(romFile);
+        REQUIRE_THROWS(ROMEnvironment(romFile, WORK_DIR));
+    }
+}
+
+TEST_CASE("SPC700 instructions, timers and ports", "[spcemulator][spc700]")
+{
+    SPCEmulator emulator;
+    const std::vector<uint8_t> program {
+        0xE8, 0x12,             // mov a, #$12
+        0x88, 0x34,             // adc a, #$34
+        0xC4, 0xF4,             // mov $F4, a
+        0x8D, 0x05,             // mov y, #$05
+        0xE8, 0x07,             // mov a, #$07
+        0xCF,                   // mul ya
+        0xC4, 0xF5,             // mov $F5, a
+        0x8F, 0x01, 0xFA,       // mov $FA, #$01
+        0x8F, 0x01, 0xF1,       // mov $F1, #$01
+        0xE4, 0xFD,             // -: mov a, $FD
+        0xF0, 0xFC,             // beq -
+        0xC4, 0xF6,             // mov $F6, a
+        0xEF,                   // sleep
+    };
+    std::copy(program.begin(), program.end(), emulator.ram() + 0x200);
+    emulator.cpu().pc = 0x200;
+    emulator.cpu().psw = 0;
+
+    // Timer 0 ticks every 128 cycles, so its counter needs a few samples to move.
+    std::vector<int16_t> pcm;
+    emulator.render(8, pcm);
+    REQUIRE(pcm.size() == 16);
+    REQUIRE(emulator.cpu().outputPort(0) == 0x46);
+    REQUIRE(emulator.cpu().outputPort(1) == 35);
+    REQUIRE(emulator.cpu().outputPort(2) == 1);
+    REQUIRE(emulator.cpu().halted);
+}
+
+TEST_CASE("S-DSP plays a looped BRR sample deterministically", "[spcemulator][sdsp]")
+{
+    auto play = []()
+    {
+        SPCEmulator emulator;
+        uint8_t* ram = emulator.ram();
+        ram[0x200] = 0xEF;              // sleep
+        emulator.cpu().pc = 0x200;
+
+        // A square wave in a single looped block, at $0400.
+        ram[0x300] = ram[0x302] = 0x00;
+        ram[0x301] = ram[0x303] = 0x04;
+        const uint8_t block[9] {0xB3, 0x77, 0x77, 0x77, 0x77, 0x99, 0x99, 0x99, 0x99};
+        std::copy(block, block + 9, ram + 0x400);
+
+        SDSP& dsp = emulator.dsp();
+        dsp.write(0x5D, 0x03);          // DIR
+        dsp.write(0x6C, 0x20);          // FLG: no echo writes
+        dsp.write(0x0C, 0x7F);          // MVOL
+        dsp.write(0x1C, 0x7F);
+        dsp.write(0x00, 0x7F);          // Voice 0: VOL, pitch, ADSR
+        dsp.write(0x01, 0x7F);
+        dsp.write(0x03, 0x10);
+        dsp.write(0x05, 0x8F);
+        dsp.write(0x06, 0xE0);
+        dsp.write(0x4C, 0x01);          // KON
+
+        std::vector<int16_t> pcm;
+        emulator.render(SPCEmulator::SAMPLE_RATE / 10, pcm);
+        return pcm;
+    };
+
+    std::vector<int16_t> first = play();
+    REQUIRE(first.size() == SPCEmulator::SAMPLE_RATE / 10 * 2);
+    REQUIRE(std::any_of(first.begin(), first.end(), [](int16_t sample) { return sample > 1000; }));
+    REQUIRE(std::any_of(first.begin(), first.end(), [](int16_t sample) { return sample < -1000; }));
+    REQUIRE(first == play());
+}
+
+TEST_CASE("Driver profiler charges cycles to routines, pass by pass", "[spcemulator][profiler]")
+{
+    SPCEmulator emulator;
+    const std::vector<uint8_t> program {
+        0x8F, 0x01, 0xFA,       // mov $FA, #$01
+        0x8F, 0x01, 0xF1,       // mov $F1, #$01
+        0xEB, 0xFD,             // MainLoop: mov y, $FD
+        0xF0, 0xFC,             // beq MainLoop
+        0x3F, 0x10, 0x02,       // call Work
+        0x2F, 0xF7,             // bra MainLoop
+        0x00,
+        0x00, 0x00, 0x00, 0x00, // Work: nop x4
+        0x6F,                   // ret
+    };
+    std::copy(program.begin(), program.end(), emulator.ram() + 0x200);
+    emulator.cpu().pc = 0x200;
+
+    DriverProfiler profiler ({{"Init", 0x200}, {"MainLoop", 0x206}, {"Work", 0x210}, {":macro_1", 0x212}});
+    emulator.cpu().setTracer(&profiler);
+    std::vector<int16_t> pcm;
+    emulator.render(4 * 128 / SPCEmulator::CYCLES_PER_SAMPLE * 10, pcm);
+
+    // A pass is call + bra in MainLoop and four nops + ret in Work.
+    REQUIRE(emulator.cpu().timerPeriod(0) == 128);
+    REQUIRE(profiler.passes() >= 30);
+    REQUIRE(profiler.worstPass() == 8 + 4 + 4 * 2 + 5);
+    REQUIRE(profiler.passesOver(128) == 0);
+    REQUIRE(profiler.passesOver(20) == profiler.passes());
+
+    const auto& routines = profiler.routines();
+    REQUIRE(routines.size() == 4);
+    REQUIRE(routines[2].name == "MainLoop");
+    REQUIRE(routines[2].worstPass == 12);
+    REQUIRE(routines[3].name == "Work");
+    REQUIRE(routines[3].worstPass == 13);
+    REQUIRE(routines[3].cycles >= profiler.passes() * 13);
+    REQUIRE(routines[1].cycles == 10);
+    REQUIRE(profiler.report(128).find("WORST PASS HEADROOM IN CYCLES:\t\t103") != std::string::npos);
+}
+
+TEST_CASE("FastTrans receives blocks of any length across pages", "[spcemulator][fasttrans]")
+{
+    // The receiver is only assembled with !FastSPCUpload, so a copy of the driver gets it turned on.
+    const fs::path FAST_DRIVER_DIR {"fasttrans_asm"};
+    deleteDir(FAST_DRIVER_DIR);
+    copyDir(DRIVER_DIR, FAST_DRIVER_DIR);
+    std::string defines;
+    readTextFile(FAST_DRIVER_DIR / "UserDefines.asm", defines);
+    const std::string option {"!FastSPCUpload = !false"};
+    REQUIRE(defines.find(option) != std::string::npos);
+    defines.replace(defines.find(option), option.size(), "!FastSPCUpload = !true");
+    writeTextFile(FAST_DRIVER_DIR / "UserDefines.asm", defines);
+
+    AsarBinding asar (FAST_DRIVER_DIR / "main.asm");
+    REQUIRE(asar.compileToBin());
+    REQUIRE(asar.getLabelValue("FastTrans") != -1);
+    const int start = asar.getLabelValue("Start");
+    REQUIRE(start != -1);
+
+    SPCEmulator emulator;
+    const std::vector<uint8_t> driver = asar.getCompiledBin();
+    std::copy(driver.begin(), driver.end(), emulator.ram() + 0x400);
+    std::fill_n(emulator.ram() + 0x8000, 0x800, 0xEE);
+    SPC700& cpu = emulator.cpu();
+    cpu.pc = start;
+    cpu.psw = 0;
+    cpu.sp = 0xCF;
+
+    // The SNES side of UploadSPCDataDynamicFast (asm/SNES/patch.asm), one port at a time.
+    auto handshake = [&](uint8_t counter)
+    {
+        cpu.setInputPort(0, counter);
+        for (int i = 0; i < 100 && cpu.outputPort(0) != counter; i++)
+            cpu.run(8);
+        return cpu.outputPort(0) == counter;
+    };
+    auto header = [&](uint8_t counter, uint8_t mode, uint16_t address)
+    {
+        cpu.setInputPort(1, mode);
+        cpu.setInputPort(2, address & 0xFF);
+        cpu.setInputPort(3, address >> 8);
+        return handshake(counter);
+    };
+
+    // Y wraps on the first, second and third byte of a group in the first block.
+    const std::vector<std::pair<uint16_t, size_t>> blocks {{0x8010, 768}, {0x8380, 301}, {0x857F, 302}};
+    std::vector<std::vector<uint8_t>> payloads;
+    uint8_t counter = 0xCC;
+    for (const auto& [address, size] : blocks)
+    {
+        std::vector<uint8_t> payload (size);
+        for (size_t i = 0; i < size; i++)
+            payload[i] = (i * 37 + size) & 0xFF;
+
+        REQUIRE(header(counter, 2, address));
+        size_t sent = 0;
+        for (; size - sent >= 3; sent += 3)
+        {
+            cpu.setInputPort(1, payload[sent]);
+            cpu.setInputPort(2, payload[sent + 1]);
+            cpu.setInputPort(3, payload[sent + 2]);
+            REQUIRE(handshake(++counter));
+        }
+
+        // The last one or two bytes go byte by byte.
+        counter += 2;
+        if (counter == 0)
+            counter++;
+        if (sent < size)
+        {
+            REQUIRE(header(counter, 1, address + sent));
+            uint8_t index = 0;
+            for (; sent < size; sent++, index++)
+            {
+                cpu.setInputPort(1, payload[sent]);
+                REQUIRE(handshake(index));
+            }
+            counter = index + 1;
+        }
+        payloads.push_back(payload);
+    }
+
+    // The last byte is stored before the next header is read.
+    REQUIRE(header(counter, 2, 0x8800));
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        const uint8_t* aram = emulator.ram() + blocks[b].first;
+        REQUIRE(std::equal(payloads[b].begin(), payloads[b].end(), aram));
+        REQUIRE(aram[-1] == 0xEE);
+        REQUIRE(aram[payloads[b].size()] == 0xEE);
+    }
+
+    deleteDir(FAST_DRIVER_DIR);
+}
+
+TEST_CASE("Time report of nested and threaded phases", "[timereport]")
+{
+    TimeReport report;
+    {
+        TimeReport::Scope build (&report, "build");
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 2; t++)
+            workers.emplace_back([&report, t]() { TimeReport::Scope scope (&report, "song", "song" + std::to_string(t) + ".txt"); });
+        for (std::thread& t : workers)
+            t.join();
+    }
+    TimeReport::Scope ignored (nullptr, "never reported");
+
+    const std::string summary = report.summary();
+    REQUIRE(summary.find("Phase") == 0);
+    REQUIRE(summary.find("build") != std::string::npos);
+    REQUIRE(summary.find("song") != std::string::npos);
+    REQUIRE(summary.find("never reported") == std::string::npos);
+
+    const std::string trace = report.chromeTrace();
+    REQUIRE(trace.find("\"traceEvents\"") != std::string::npos);
+    REQUIRE(trace.find("\"name\": \"song: song1.txt\"") != std::string::npos);
+    REQUIRE(std::count(trace.begin(), trace.end(), '\n') == 5);
+    REQUIRE(TimeReport::peakRSS() > 0);
+}
+
 TEST_CASE("SPCEnvironment creation of a set of SPC files", "[spcenvironment][spc][generation]")
 {
     const fs::path testset = TEST_WORKDIR / "music";
@@ -157,4 +818,76 @@ TEST_CASE("SPCEnvironment creation of a set of SPC files", "[spcenvironment][spc
     SPCEnvironment spc (TEST_WORKDIR);
     spc.generateSPCFiles(input_files);
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("Songs compiled one after the other match a full build", "[spcenvironment][compilespc]")
+{
+    std::vector<fs::path> songs;
+    for (auto& file_i : fs::directory_iterator(TEST_WORKDIR / "music"))
+        if (file_i.path().extension().string() == ".txt")
+            songs.push_back(fs::absolute(file_i.path()));
+    std::sort(songs.begin(), songs.end());
+    REQUIRE(songs.size() >= 2);
+    songs.resize(2);
+
+    EnvironmentOptions opts;
+    opts.verbose = false;
+    const fs::path reference = "compilespc_reference";
+
+    // Only one environment can have the driver extracted at a time.
+    {
+        SPCEnvironment spc (TEST_WORKDIR, opts);
+        REQUIRE(spc.generateSPCFiles(songs, reference));
+    }
+
+    // The second song and a second go at the first are linked again on a warm environment.
+    SPCEnvironment spc (TEST_WORKDIR, opts);
+    for (const fs::path& song : {songs[0], songs[1], songs[0]})
+    {
+        std::vector<uint8_t> expected;
+        readBinaryFile(reference / (song.stem().string() + ".spc"), expected);
+        const std::vector<uint8_t> compiled = spc.compileSPC(song);
+
+        // The header carries the dump date.
+        REQUIRE(compiled.size() == expected.size());
+        REQUIRE(std::equal(compiled.begin() + 0x100, compiled.end(), expected.begin() + 0x100));
+    }
+    deleteDir(reference);
+}
+
+TEST_CASE("Compile server keeps the environment warm between songs", "[compileserver]")
+{
+    fs::path song;
+    for (auto& file_i : fs::directory_iterator(TEST_WORKDIR / "music"))
+        if (file_i.path().extension().string() == ".txt")
+            song = fs::absolute(file_i.path());
+    REQUIRE_FALSE(song.empty());
+
+    EnvironmentOptions opts;
+    opts.verbose = false;
+    CompileServer server (TEST_WORKDIR, opts);
+
+    bool stop = false;
+    auto noPayload = [](size_t) { return std::string(); };
+    REQUIRE(server.handle("PING", noPayload, stop) == "OK 0 0\n");
+
+    // The same song, from its file and from memory, twice in a row.
+    const std::string expected = "OK " + std::to_string(SPC_FILE_SIZE) + " ";
+    const std::string fromFile = server.handle("COMPILE " + song.string(), noPayload, stop);
+    REQUIRE(fromFile.compare(0, expected.size(), expected) == 0);
+
+    std::string mml;
+    readTextFile(song, mml);
+    auto payload = [&mml](size_t length) { return mml.substr(0, length); };
+    const std::string fromText = server.handle("COMPILE_TEXT " + std::to_string(mml.size()) + " " + song.string(), payload, stop);
+    REQUIRE(fromText.substr(fromText.size() - SPC_FILE_SIZE + 0x100) == fromFile.substr(fromFile.size() - SPC_FILE_SIZE + 0x100));
+
+    REQUIRE(server.handle("COMPILE_TEXT 5 " + song.string(), noPayload, stop).rfind("ERROR", 0) == 0);
+    REQUIRE_FALSE(server.closesConnection());
+    REQUIRE(server.handle("COMPILE_TEXT many " + song.string(), noPayload, stop).rfind("ERROR", 0) == 0);
+    REQUIRE(server.closesConnection());
+    REQUIRE(server.handle("HELLO", noPayload, stop) == "ERROR 1\nUnknown request: HELLO\n");
+    REQUIRE_FALSE(stop);
+    server.handle("SHUTDOWN", noPayload, stop);
+    REQUIRE(stop);
+}
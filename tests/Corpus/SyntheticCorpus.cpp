@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#include "Package.h"
+#include "SyntheticCorpus.h"
+#include "Utility.h"
+
+using namespace AddMusic;
+
+enum : uint32_t { SONG_STREAM = 1, SAMPLE_STREAM = 2 };
+
+// Highest song number in Addmusic_list.txt.
+static constexpr unsigned int LAST_SONG {0xFF};
+
+SyntheticCorpus::Random::Random(uint32_t seed, uint32_t stream, uint32_t index)
+{
+    std::seed_seq sequence {seed, stream, index};
+    engine.seed(sequence);
+}
+
+SyntheticCorpus::SyntheticCorpus(const CorpusOptions& opts) :
+    options(opts)
+{
+}
+
+unsigned int SyntheticCorpus::sampleCount() const
+{
+    unsigned int count = options.samples ? options.samples : options.songs * 2;
+    return std::max(count, GROUP_SIZE + 4);
+}
+
+std::string SyntheticCorpus::songFilename(unsigned int index)
+{
+    std::stringstream name;
+    name << "Synthetic " << std::setw(4) << std::setfill('0') << index << ".txt";
+    return name.str();
+}
+
+std::string SyntheticCorpus::sampleFilename(unsigned int index)
+{
+    std::stringstream name;
+    name << "s" << std::setw(4) << std::setfill('0') << index << ".brr";
+    return name.str();
+}
+
+std::vector<uint8_t> SyntheticCorpus::sample(unsigned int index) const
+{
+    Random random (options.seed, SAMPLE_STREAM, index);
+
+    const unsigned int blocks = 4 + random.below(61);
+    const bool loops = random.chance(70);
+    const unsigned int loopBlock = loops ? random.below(blocks) : 0;
+
+    std::vector<uint8_t> brr {(uint8_t)(loopBlock * 9 & 0xFF), (uint8_t)(loopBlock * 9 >> 8)};
+    for (unsigned int block = 0; block < blocks; block++)
+    {
+        // The first block has no previous samples to filter with.
+        uint8_t range = random.below(12);
+        uint8_t filter = block == 0 ? 0 : random.below(4);
+        uint8_t flags = block + 1 == blocks ? (loops ? 3 : 1) : 0;
+        brr.push_back((range << 4) | (filter << 2) | flags);
+        for (int i = 0; i < 8; i++)
+            brr.push_back(random.below(256));
+    }
+    return brr;
+}
+
+std::string SyntheticCorpus::_phrase(Random& random, int& octave, bool repeated) const
+{
+    const int startOctave = octave;
+    static const char* const NOTES[] {"c", "c+", "d", "d+", "e", "f", "f+", "g", "g+", "a", "a+", "b"};
+    static const char* const LENGTHS[] {"4", "8", "8", "16", "16", "8.", "2"};
+
+    std::string phrase;
+    const unsigned int notes = 3 + random.below(6);
+    for (unsigned int n = 0; n < notes; n++)
+    {
+        if (random.chance(15) && octave < 6)
+        {
+            phrase += ">";
+            octave++;
+        }
+        else if (random.chance(15) && octave > 2)
+        {
+            phrase += "<";
+            octave--;
+        }
+
+        if (random.chance(10))
+            phrase += "r";
+        else
+            phrase += NOTES[random.below(12)];
+        phrase += LENGTHS[random.below(7)];
+        if (random.chance(10))
+            phrase += "^16";
+        phrase += " ";
+    }
+
+    // Repeated phrases have to end in the octave they start in.
+    for (; repeated && octave > startOctave; octave--)
+        phrase += "<";
+    for (; repeated && octave < startOctave; octave++)
+        phrase += ">";
+    return phrase;
+}
+
+std::string SyntheticCorpus::song(unsigned int index) const
+{
+    Random random (options.seed, SONG_STREAM, index);
+    std::stringstream mml;
+
+    mml << "#amk 2\n\n";
+    mml << "#spc\n{\n";
+    mml << "\t#author \"AddmusicK synthetic corpus\"\n";
+    mml << "\t#title \"Synthetic " << index << "\"\n";
+    mml << "\t#game \"Seed " << options.seed << "\"\n";
+    mml << "}\n\n";
+
+    // Samples: maybe a whole group, then a few of the song's own.
+    static const char* const GROUPS[] {"#default", "#optimized", "#synthetic"};
+    const unsigned int ownSamples = 1 + random.below(4);
+    std::vector<unsigned int> samples;
+    while (samples.size() < ownSamples)
+    {
+        unsigned int sample = GROUP_SIZE + random.below(sampleCount() - GROUP_SIZE);
+        if (std::find(samples.begin(), samples.end(), sample) == samples.end())
+            samples.push_back(sample);
+    }
+
+    mml << "#path \"synthetic\"\n\n";
+    mml << "#samples\n{\n";
+    if (random.chance(75))
+        mml << "\t" << GROUPS[random.below(3)] << "\n";
+    for (unsigned int sample : samples)
+        mml << "\t\"" << sampleFilename(sample) << "\"\n";
+    mml << "}\n\n";
+
+    mml << "#instruments\n{\n";
+    for (unsigned int sample : samples)
+        mml << "\t\"" << sampleFilename(sample) << "\" $" << hex<2>(0x80 | random.below(0x80)) << " $" << hex<2>(random.below(0x100))
+            << " $00 $0" << 2 + random.below(6) << " $" << hex<2>(random.below(0x100)) << "\n";
+    mml << "}\n\n";
+
+    // Every instrument gets a replacement with its volume and pan.
+    for (unsigned int i = 0; i < samples.size(); i++)
+        mml << "\"SYN_I" << i << "=@" << 30 + i << " v" << 160 + random.below(80) << " y" << 5 + random.below(11) << "\"\n";
+    mml << "\n";
+
+    const bool remote = random.chance(50);
+    if (remote)
+        mml << "(!1)[$ED $" << hex<2>(random.below(0x80)) << " $E0]\n\n";
+
+    const unsigned int channels = 2 + random.below(7);
+    unsigned int nextLabel = 1;
+    for (unsigned int channel = 0; channel < channels; channel++)
+    {
+        int octave = 3 + random.below(2);
+        mml << "#" << channel << " ";
+        if (channel == 0)
+        {
+            mml << "w" << 180 + random.below(76) << " t" << 36 + random.below(30) << " ";
+            if (random.chance(30))
+                mml << "$EF $" << hex<2>(random.below(0x100)) << " $20 $20 $F1 $02 $40 $01 ";
+        }
+        mml << "SYN_I" << random.below(samples.size()) << " o" << octave << " q7f\n";
+
+        std::vector<unsigned int> labels;
+        const unsigned int bars = 4 + random.below(9);
+        for (unsigned int bar = 0; bar < bars; bar++)
+        {
+            switch (random.below(9))
+            {
+            case 0:
+                mml << "[" << _phrase(random, octave, true) << "]" << 2 + random.below(3);
+                break;
+            case 1:
+                if (!labels.empty() && random.chance(50))
+                    mml << "(" << labels[random.below(labels.size())] << ")" << 1 + random.below(3);
+                else
+                {
+                    labels.push_back(nextLabel++);
+                    mml << "(" << labels.back() << ")[" << _phrase(random, octave, true) << "]" << 1 + random.below(2);
+                }
+                break;
+            case 2:
+            {
+                std::string length = random.chance(50) ? "8" : "16";
+                mml << "{c" << length << " e" << length << " g" << length << "}";
+                break;
+            }
+            case 3:
+                mml << "$DE $" << hex<2>(random.below(0x40)) << " $" << hex<2>(1 + random.below(0x20)) << " $" << hex<2>(random.below(0x80)) << " "
+                    << _phrase(random, octave) << "$DF";
+                break;
+            case 4:
+                mml << "$E8 $" << hex<2>(1 + random.below(0x60)) << " $" << hex<2>(random.below(0x100)) << " " << _phrase(random, octave);
+                break;
+            case 5:
+                mml << "$DC $" << hex<2>(1 + random.below(0x60)) << " $" << hex<2>(random.below(0x15)) << " " << _phrase(random, octave);
+                break;
+            case 6:
+                if (remote)
+                    mml << "(!1, -1) ";
+                mml << _phrase(random, octave);
+                break;
+            case 7:
+                mml << "SYN_I" << random.below(samples.size()) << " " << _phrase(random, octave);
+                break;
+            default:
+                mml << _phrase(random, octave);
+                break;
+            }
+            mml << "\n";
+
+            if (bar == 0 && random.chance(50))
+                mml << "/\n";
+        }
+        mml << "\n";
+    }
+
+    return mml.str();
+}
+
+std::vector<fs::path> SyntheticCorpus::writeWorkDir(const fs::path& workDir) const
+{
+    if (!fs::exists(workDir / "Addmusic_list.txt"))
+        boilerplate_package.extract(workDir);
+
+    const fs::path sampleDir = workDir / "samples" / "synthetic";
+    fs::create_directories(sampleDir);
+    for (unsigned int i = 0; i < sampleCount(); i++)
+    {
+        std::vector<uint8_t> brr = sample(i);
+        writeBinaryFile(sampleDir / sampleFilename(i), brr);
+    }
+
+    std::string groups;
+    readTextFile(workDir / "Addmusic_sample groups.txt", groups);
+    if (groups.find("#synthetic") == std::string::npos)
+    {
+        groups += "\n\n#synthetic\n{\n";
+        for (unsigned int i = 0; i < GROUP_SIZE; i++)
+            groups += "\t\"synthetic/" + sampleFilename(i) + "\"\n";
+        groups += "}\n";
+        writeTextFile(workDir / "Addmusic_sample groups.txt", groups);
+    }
+
+    std::vector<fs::path> songs;
+    fs::create_directories(workDir / "music");
+    for (unsigned int i = 0; i < options.songs; i++)
+    {
+        songs.push_back(workDir / "music" / songFilename(i));
+        writeTextFile(songs.back(), song(i));
+    }
+
+    // The synthetic songs replace the local songs of the list, as far as song numbers go.
+    std::string list;
+    readTextFile(workDir / "Addmusic_list.txt", list);
+    const std::string eol = list.find("\r\n") != std::string::npos ? "\r\n" : "\n";
+    size_t locals = list.find("Locals:");
+    if (locals == std::string::npos)
+        list += eol + "Locals:" + eol;
+    else if (list.find('\n', locals) == std::string::npos)
+        list += eol;
+    else
+        list.erase(list.find('\n', locals) + 1);
+
+    unsigned int firstLocal = 1;
+    std::istringstream globals (list.substr(0, locals));
+    for (std::string line; std::getline(globals, line);)
+    {
+        unsigned int number;
+        if (std::sscanf(line.c_str(), "%x", &number) == 1)
+            firstLocal = std::max(firstLocal, number + 1);
+    }
+    for (unsigned int i = 0; i < options.songs && firstLocal + i <= LAST_SONG; i++)
+        list += hex<2>(firstLocal + i) + "  " + songFilename(i) + eol;
+    writeTextFile(workDir / "Addmusic_list.txt", list);
+
+    return songs;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace AddMusic
+{
+
+namespace fs = std::filesystem;
+
+struct CorpusOptions
+{
+    uint32_t seed {1};
+    unsigned int songs {10};
+    unsigned int samples {0};           // Synthetic BRRs shared by the songs. 0 = two per song.
+};
+
+/**
+ * @brief Generates AddmusicK songs and BRR samples out of a seed, so tests and
+ * benchmarks can run offline, at any scale and always on the same input.
+ *
+ * Songs use loops, label loops, remote code, replacements, hex commands,
+ * triplets, echo and custom instruments over a mix of the default sample
+ * groups, a "#synthetic" group and samples of their own. Every song only
+ * depends on the seed, its own number and the number of samples, so with the
+ * same samples a corpus of 1000 songs starts with the same 10 songs as a
+ * corpus of 10. Samples only depend on the seed and their number.
+ */
+class SyntheticCorpus
+{
+public:
+    static constexpr unsigned int GROUP_SIZE {4};      // Samples in the "#synthetic" sample group.
+
+    SyntheticCorpus(const CorpusOptions& opts);
+
+    /**
+     * @brief MML text of a song.
+     */
+    std::string song(unsigned int index) const;
+
+    /**
+     * @brief A valid BRR file, with its two-byte loop header.
+     */
+    std::vector<uint8_t> sample(unsigned int index) const;
+
+    static std::string songFilename(unsigned int index);
+    static std::string sampleFilename(unsigned int index);     // Relative to the "synthetic" sample folder.
+
+    unsigned int sampleCount() const;
+
+    /**
+     * @brief Builds a work directory: the boilerplate, plus every sample in
+     * samples/synthetic, the "#synthetic" group, every song in music/ and as
+     * many of them as fit in Addmusic_list.txt as local songs. Returns the
+     * paths of the songs.
+     */
+    std::vector<fs::path> writeWorkDir(const fs::path& workDir) const;
+
+private:
+    /**
+     * @brief Draws numbers the same way on every platform, unlike the
+     * standard distributions.
+     */
+    class Random
+    {
+    public:
+        Random(uint32_t seed, uint32_t stream, uint32_t index);
+        unsigned int below(unsigned int n) { return engine() % n; }
+        bool chance(unsigned int percent) { return below(100) < percent; }
+
+    private:
+        std::mt19937 engine;
+    };
+
+    std::string _phrase(Random& random, int& octave, bool repeated = false) const;
+
+    CorpusOptions options;
+};
+
+}
@@ -0,0 +1,278 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "SyntheticROM.h"
+#include "Utility.h"
+
+using namespace AddMusic;
+
+// Size of the original game, before any expansion.
+static constexpr int ORIGINAL_SIZE {0x80000};
+
+// Where AddmusicK looks for its own data, and the marker of an untouched ROM.
+static constexpr int AMK_DATA {0x70000};
+static constexpr int AMK_POINTER_TABLE {AMK_DATA + 0x10};
+
+static constexpr char SAMPLE_TOOL_SIGNATURE[] {"New Super Mario World Sample Utility 2.0 by smkdan"};
+
+SyntheticROM::SyntheticROM(const ROMOptions& opts) :
+    options(opts)
+{
+    if (opts.megabytes != 1 && opts.megabytes != 2 && opts.megabytes != 4 && opts.megabytes != 8)
+        throw std::invalid_argument("Synthetic ROMs can only be 1, 2, 4 or 8 MB.");
+
+    // The state is left out of the seed, so every state shares the same
+    // game and the same data of other tools.
+    std::seed_seq sequence {opts.seed, (uint32_t)opts.megabytes, (uint32_t)opts.fragmentation};
+    engine.seed(sequence);
+
+    rom.assign(opts.megabytes * 0x100000, 0);
+    _fillOriginalGame();
+    _fillExpandedBanks();
+
+    switch (options.state)
+    {
+    case ROMState::Clean:       break;
+    case ROMState::AddmusicK:   _addAddmusicK(); break;
+    case ROMState::SampleTool:  _addSampleTool(); break;
+    case ROMState::AM405:       _addAM405(); break;
+    case ROMState::AddmusicM:   _addAddmusicM(); break;
+    }
+
+    _writeInternalHeader();
+}
+
+std::vector<uint8_t> SyntheticROM::file() const
+{
+    std::vector<uint8_t> data;
+    if (options.header)
+        data.assign(0x200, 0);
+    data.insert(data.end(), rom.begin(), rom.end());
+    return data;
+}
+
+void SyntheticROM::write(const fs::path& filename) const
+{
+    std::vector<uint8_t> data = file();
+    writeBinaryFile(filename, data);
+}
+
+int SyntheticROM::PCToSNES(int addr) const
+{
+    if (addr < 0 || addr >= 0x400000)
+        return -1;
+
+    addr = ((addr << 1) & 0x7F0000) | (addr & 0x7FFF) | 0x8000;
+
+    if (!options.sa1 && (addr & 0xF00000) == 0x700000)
+        addr |= 0x800000;
+
+    if (options.sa1 && addr >= 0x400000)
+        addr += 0x400000;
+    return addr;
+}
+
+int SyntheticROM::_protect(int offset, unsigned int size)
+{
+    const unsigned int field = size - 1;
+    const uint8_t tag[8] {'S', 'T', 'A', 'R', (uint8_t)(field & 0xFF), (uint8_t)(field >> 8), (uint8_t)(~field & 0xFF), (uint8_t)((~field >> 8) & 0xFF)};
+    std::copy(tag, tag + 8, rom.begin() + offset);
+
+    for (unsigned int i = 0; i < size; i++)
+        rom[offset + 8 + i] = 1 + _below(255);
+    return offset;
+}
+
+unsigned int SyntheticROM::_takeBank()
+{
+    if (freeBanks.empty())
+        throw std::runtime_error("The synthetic ROM has no free banks left. Use a bigger ROM or less fragmentation.");
+
+    const unsigned int index = _below(freeBanks.size());
+    const unsigned int bank = freeBanks[index];
+    freeBanks.erase(freeBanks.begin() + index);
+    return bank;
+}
+
+int SyntheticROM::_allocate(unsigned int size)
+{
+    if (allocBank < 0 || allocPos + 8 + (int)size > (allocBank + 1) * 0x8000)
+    {
+        allocBank = _takeBank();
+        allocPos = allocBank * 0x8000 + _below(4) * 0x10;
+    }
+
+    const int offset = _protect(allocPos, size);
+    allocPos += 8 + size + _below(0x40);
+    tool.push_back(offset);
+    return offset;
+}
+
+void SyntheticROM::_writePointer(int offset, int pcAddr)
+{
+    const int addr = PCToSNES(pcAddr);
+    rom[offset] = addr & 0xFF;
+    rom[offset + 1] = (addr >> 8) & 0xFF;
+    rom[offset + 2] = (addr >> 16) & 0xFF;
+}
+
+void SyntheticROM::_fillOriginalGame()
+{
+    for (int i = 0; i < ORIGINAL_SIZE; i++)
+        rom[i] = _below(256);
+
+    rom[AMK_DATA] = 0x3E;
+    rom[AMK_DATA + 1] = 0x0E;
+
+    rom[0x1740] = 0xA9;         // Not the JSL Addmusic 4.05 puts there.
+    rom[0x78000] = 0x00;        // Nor the RATS tag AddmusicM puts there.
+}
+
+void SyntheticROM::_fillExpandedBanks()
+{
+    const unsigned int banks = rom.size() / 0x8000;
+
+    for (unsigned int bank = ORIGINAL_SIZE / 0x8000; bank < banks; bank++)
+    {
+        const int start = bank * 0x8000;
+        const int end = start + 0x8000;
+
+        if (_below(100) >= options.fragmentation)
+        {
+            // Only banks with a SNES address can hold music data.
+            if (PCToSNES(start) != -1)
+                freeBanks.push_back(bank);
+            continue;
+        }
+
+        switch (_below(4))
+        {
+        case 0:
+            // A whole bank.
+            foreign.push_back(_protect(start, 0x8000 - 8));
+            break;
+
+        case 1:
+            // Small blocks with holes of any size in between.
+            for (int pos = start + _below(0x400); pos + 8 + 0x800 < end; )
+            {
+                const unsigned int size = 0x10 + _below(0x7F0);
+                foreign.push_back(_protect(pos, size));
+                pos += 8 + size + _below(0x800);
+            }
+            break;
+
+        case 2:
+        {
+            // Data nobody protected.
+            const int begin = start + _below(0x4000);
+            const int length = 0x100 + _below(0x3F00);
+            for (int i = begin; i < begin + length; i++)
+                rom[i] = 1 + _below(255);
+            break;
+        }
+
+        case 3:
+        {
+            // A RATS tag whose size doesn't match its complement.
+            const int pos = start + _below(0x4000);
+            _protect(pos, 0x100 + _below(0x3000));
+            rom[pos + 6] ^= 0x01;
+            break;
+        }
+        }
+    }
+}
+
+void SyntheticROM::_addAddmusicK()
+{
+    std::memcpy(&rom[AMK_DATA], "@AMK", 4);
+    rom[AMK_DATA + 4] = 0;                          // DATA_VERSION
+    std::fill(rom.begin() + AMK_DATA + 11, rom.begin() + AMK_POINTER_TABLE, 0);
+
+    const unsigned int songs = 0x20 + _below(0x60);
+    const unsigned int globalSongs = 10;
+    const unsigned int samples = 0x10 + _below(0x40);
+
+    // Sample groups of every song.
+    _writePointer(AMK_DATA + 5, _allocate(songs * 2 + 0x40) + 8);
+    _writePointer(AMK_DATA + 8, AMK_POINTER_TABLE);
+
+    // Songs, then samples, each list ending with $FFFFFF.
+    int entry = AMK_POINTER_TABLE;
+    for (unsigned int i = 0; i < songs; i++, entry += 3)
+    {
+        if (i < globalSongs)
+            rom[entry] = rom[entry + 1] = rom[entry + 2] = 0;
+        else
+            _writePointer(entry, _allocate(0x100 + _below(0x700)) + 8);
+    }
+    rom[entry] = rom[entry + 1] = rom[entry + 2] = 0xFF;
+    entry += 3;
+
+    for (unsigned int i = 0; i < samples; i++, entry += 3)
+    {
+        if (_below(10) == 0)
+            rom[entry] = rom[entry + 1] = rom[entry + 2] = 0;
+        else
+            _writePointer(entry, _allocate(9 * (4 + _below(0x100)) + 2) + 8);
+    }
+    rom[entry] = rom[entry + 1] = rom[entry + 2] = 0xFF;
+}
+
+void SyntheticROM::_addSampleTool()
+{
+    // The hack itself, followed 0x36 bytes later by the bank of each of its 0x207 samples.
+    const int hack = _allocate(0x36 + 0x207 + 0x40);
+    std::memcpy(&rom[hack + 8], SAMPLE_TOOL_SIGNATURE, sizeof(SAMPLE_TOOL_SIGNATURE) - 1);
+
+    std::vector<unsigned int> banks (2 + _below(6));
+    for (unsigned int& bank : banks)
+    {
+        bank = _takeBank();
+        tool.push_back(_protect(bank * 0x8000, 0x100 * (1 + _below(0x7F))));
+    }
+
+    for (unsigned int j = 0; j < 0x207; j++)
+    {
+        const unsigned int bank = j < banks.size() ? banks[j] : banks[_below(banks.size())];
+        rom[hack + 8 + 0x36 + j] = PCToSNES(bank * 0x8000) >> 16;
+    }
+}
+
+void SyntheticROM::_addAM405()
+{
+    rom[0x1740] = 0x22;                             // JSL to its hack.
+    _writePointer(0x1741, _allocate(0x400 + _below(0x400)) + 8);
+}
+
+void SyntheticROM::_addAddmusicM()
+{
+    // A RATS tag in the original game's banks, where nothing else puts one.
+    tool.push_back(_protect(0x78000, 0x200 + _below(0x600)));
+}
+
+void SyntheticROM::_writeInternalHeader()
+{
+    const char title[] {"SUPER MARIOWORLD     "};
+    std::memcpy(&rom[0x7FC0], title, 21);
+
+    rom[0x7FD5] = options.sa1 ? 0x23 : 0x20;       // Map mode
+    rom[0x7FD6] = options.sa1 ? 0x35 : 0x02;       // Cartridge type
+    rom[0x7FD7] = options.megabytes == 1 ? 0x0A : options.megabytes == 2 ? 0x0B : options.megabytes == 4 ? 0x0C : 0x0D;
+    rom[0x7FD8] = 0x01;                             // SRAM size
+    rom[0x7FD9] = 0x01;                             // Region
+    rom[0x7FDA] = 0x01;                             // Developer
+    rom[0x7FDB] = 0x00;                             // Version
+
+    // Checksum and its complement, over the finished image.
+    rom[0x7FDC] = rom[0x7FDD] = 0xFF;
+    rom[0x7FDE] = rom[0x7FDF] = 0x00;
+    uint16_t checksum = 0;
+    for (uint8_t byte : rom)
+        checksum += byte;
+    rom[0x7FDC] = ~checksum & 0xFF;
+    rom[0x7FDD] = (~checksum >> 8) & 0xFF;
+    rom[0x7FDE] = checksum & 0xFF;
+    rom[0x7FDF] = checksum >> 8;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+namespace AddMusic
+{
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief What has been done to a synthetic ROM before AddmusicK gets it.
+ */
+enum class ROMState
+{
+    Clean,              // Expanded, but never touched by a music tool.
+    AddmusicK,          // Patched by a previous AddmusicK: "@AMK" block, songs and samples.
+    SampleTool,         // Patched by smkdan's Sample Tool.
+    AM405,              // Patched by Addmusic 4.05 (detection signature only).
+    AddmusicM           // Patched by AddmusicM (detection signature only).
+};
+
+struct ROMOptions
+{
+    uint32_t seed {1};
+    unsigned int megabytes {4};         // 1, 2, 4 or 8.
+    bool header {false};                // Prepend a 512-byte copier header to the file.
+    bool sa1 {false};                   // Mark the ROM as SA-1.
+    ROMState state {ROMState::Clean};
+    unsigned int fragmentation {50};    // Percentage of expanded banks used by other tools.
+};
+
+/**
+ * @brief Builds a ROM image laid out like an expanded Super Mario World ROM,
+ * so ROMEnvironment can be tested and benchmarked without a copyrighted ROM.
+ *
+ * The first 512 KB stand in for the original game: pseudo-random code, the
+ * internal header and the "clean ROM" marker AddmusicK checks for. Expanded
+ * banks are either free or used by other tools in several ways: full banks
+ * and scattered blocks protected by RATS tags, unprotected data and broken
+ * RATS tags. On top of that, the data and signatures of a previous music
+ * tool can be added. The same options always give the same image.
+ *
+ * Throws std::runtime_error if the data of the previous tool doesn't fit in
+ * the free banks, which can happen on small and very fragmented ROMs.
+ */
+class SyntheticROM
+{
+public:
+    SyntheticROM(const ROMOptions& opts);
+
+    /**
+     * @brief The ROM image, without the copier header.
+     */
+    const std::vector<uint8_t>& image() const { return rom; }
+
+    /**
+     * @brief Contents of the ROM file, with the copier header if asked for.
+     */
+    std::vector<uint8_t> file() const;
+
+    void write(const fs::path& filename) const;
+
+    /**
+     * @brief PC offsets (without header) of the RATS tags protecting the data
+     * of the previous music tool, which its cleanup has to erase.
+     */
+    const std::vector<int>& toolBlocks() const { return tool; }
+
+    /**
+     * @brief PC offsets (without header) of the RATS tags protecting the data
+     * of other tools, which have to survive any cleanup.
+     */
+    const std::vector<int>& foreignBlocks() const { return foreign; }
+
+    /**
+     * @brief Same mapping as SPCEnvironment::PCToSNES().
+     */
+    int PCToSNES(int addr) const;
+
+private:
+    unsigned int _below(unsigned int n) { return engine() % n; }
+
+    int _protect(int offset, unsigned int size);
+    int _allocate(unsigned int size);
+    unsigned int _takeBank();
+    void _writePointer(int offset, int pcAddr);
+
+    void _fillOriginalGame();
+    void _fillExpandedBanks();
+    void _addAddmusicK();
+    void _addSampleTool();
+    void _addAM405();
+    void _addAddmusicM();
+    void _writeInternalHeader();
+
+    ROMOptions options;
+    std::mt19937 engine;
+
+    std::vector<uint8_t> rom;
+    std::vector<int> tool;
+    std::vector<int> foreign;
+
+    std::vector<unsigned int> freeBanks;
+    int allocBank {-1};                 // Bank the previous tool's blocks are being placed in.
+    int allocPos {0};
+};
+
+}
@@ -0,0 +1,53 @@
+#include <iostream>
+#include <filesystem>
+
+#include <cxxopts.hpp>
+
+#include "SyntheticCorpus.h"
+#include "SyntheticROM.h"
+
+namespace fs = std::filesystem;
+
+int main(int argc, char** argv)
+{
+    cxxopts::Options options("corpus_generator", "Generates a seeded AddmusicK work directory with synthetic songs and samples.");
+    options.add_options()
+        ("seed", "Seed of the corpus", cxxopts::value<uint32_t>()->default_value("1"), "<n>")
+        ("songs", "Number of songs", cxxopts::value<unsigned int>()->default_value("10"), "<n>")
+        ("samples", "Number of synthetic samples (0 = two per song)", cxxopts::value<unsigned int>()->default_value("0"), "<n>")
+        ("rom", "Also write a clean synthetic ROM of this size in MB (1, 2, 4 or 8) as smw.sfc", cxxopts::value<unsigned int>()->default_value("0"), "<MB>")
+        ("fragmentation", "Percentage of the ROM's expanded banks used by other tools", cxxopts::value<unsigned int>()->default_value("50"), "<n>")
+        ("h,help", "Print usage")
+        ("output", "Work directory to create", cxxopts::value<std::string>(), "<folder>");
+
+    options.parse_positional({"output"});
+    auto argp = options.parse(argc, argv);
+
+    if (argp.count("help") || !argp.count("output"))
+    {
+        std::cout << options.help() << std::endl;
+        return argp.count("help") ? 0 : 1;
+    }
+
+    AddMusic::CorpusOptions opts;
+    opts.seed = argp["seed"].as<uint32_t>();
+    opts.songs = argp["songs"].as<unsigned int>();
+    opts.samples = argp["samples"].as<unsigned int>();
+
+    AddMusic::SyntheticCorpus corpus (opts);
+    fs::path output = argp["output"].as<std::string>();
+    auto songs = corpus.writeWorkDir(output);
+
+    std::cout << songs.size() << " songs and " << corpus.sampleCount() << " samples generated at " << fs::absolute(output).string() << std::endl;
+
+    if (argp["rom"].as<unsigned int>())
+    {
+        AddMusic::ROMOptions romOpts;
+        romOpts.seed = opts.seed;
+        romOpts.megabytes = argp["rom"].as<unsigned int>();
+        romOpts.sa1 = romOpts.megabytes == 8;
+        romOpts.fragmentation = argp["fragmentation"].as<unsigned int>();
+        AddMusic::SyntheticROM(romOpts).write(output / "smw.sfc");
+    }
+    return 0;
+}
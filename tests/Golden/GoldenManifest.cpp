@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+#include "GoldenManifest.h"
+#include "Utility.h"
+
+using namespace AddMusic;
+
+/**
+ * Runs task(0) to task(count - 1) on one thread per core.
+ */
+template<typename Task>
+static void parallelFor(size_t count, Task task)
+{
+    std::atomic<size_t> next {0};
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+            task(i);
+    };
+
+    const unsigned int workerCount = std::max(1u, std::min<unsigned int>(std::thread::hardware_concurrency(), count));
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < workerCount; t++)
+        workers.emplace_back(worker);
+    for (std::thread& t : workers)
+        t.join();
+}
+
+std::string GoldenArtifact::regionAt(size_t offset) const
+{
+    auto region = regions.upper_bound(offset);
+    if (region == regions.begin())
+        return "";
+    return std::prev(region)->second;
+}
+
+GoldenManifest::Entry GoldenManifest::_hash(const std::vector<uint8_t>& data)
+{
+    Entry entry;
+    entry.size = data.size();
+    entry.crc = crc32(data.data(), data.size());
+
+    entry.blockSize = 64;
+    while (entry.blockSize * MAX_BLOCKS < data.size())
+        entry.blockSize *= 2;
+    for (size_t pos = 0; pos < data.size(); pos += entry.blockSize)
+        entry.blocks.push_back(crc32(data.data() + pos, std::min(entry.blockSize, data.size() - pos)));
+    return entry;
+}
+
+GoldenManifest GoldenManifest::hash(const std::vector<GoldenArtifact>& artifacts)
+{
+    std::vector<Entry> hashed (artifacts.size());
+    parallelFor(artifacts.size(), [&](size_t i) { hashed[i] = _hash(artifacts[i].data); });
+
+    GoldenManifest manifest;
+    for (size_t i = 0; i < artifacts.size(); i++)
+        manifest.entries[artifacts[i].name] = std::move(hashed[i]);
+    return manifest;
+}
+
+bool GoldenManifest::load(const fs::path& manifestFile)
+{
+    entries.clear();
+    if (!fs::exists(manifestFile))
+        return false;
+
+    std::string text;
+    readTextFile(manifestFile, text);
+
+    std::stringstream lines (text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        // name, size, CRC, block size and block CRCs, separated by tabs.
+        std::stringstream fields (line);
+        std::string name, blocks;
+        Entry entry;
+        std::getline(fields, name, '\t');
+        fields >> std::hex >> entry.size >> entry.crc >> entry.blockSize >> blocks;
+
+        std::stringstream blockList (blocks);
+        std::string block;
+        while (std::getline(blockList, block, ','))
+            entry.blocks.push_back(std::stoul(block, nullptr, 16));
+
+        entries[name] = std::move(entry);
+    }
+    return true;
+}
+
+void GoldenManifest::save(const fs::path& manifestFile) const
+{
+    std::stringstream text;
+    text << "# name\tsize\tCRC-32\tblock size\tblock CRC-32s (all in hex)\n";
+    for (const auto& [name, entry] : entries)
+    {
+        text << name << '\t' << hex<1>(entry.size) << '\t' << hex<8>(entry.crc) << '\t' << hex<1>(entry.blockSize) << '\t';
+        for (size_t i = 0; i < entry.blocks.size(); i++)
+            text << (i ? "," : "") << hex<8>(entry.blocks[i]);
+        text << '\n';
+    }
+
+    if (manifestFile.has_parent_path())
+        fs::create_directories(manifestFile.parent_path());
+    writeTextFile(manifestFile, text.str());
+}
+
+std::string GoldenManifest::_describe(const GoldenArtifact& artifact, size_t offset, size_t end)
+{
+    std::stringstream description;
+    description << artifact.name;
+    if (!artifact.source.empty())
+        description << " (" << artifact.source << ")";
+
+    if (end == offset + 1)
+        description << ": first difference at byte 0x" << hex<4>(offset);
+    else
+        description << ": first difference in bytes 0x" << hex<4>(offset) << "-0x" << hex<4>(end - 1);
+
+    const std::string region = artifact.regionAt(offset);
+    const std::string lastRegion = artifact.regionAt(end - 1);
+    if (!region.empty() && lastRegion != region)
+        description << ", somewhere from " << region << " to " << (lastRegion.empty() ? "past its end" : lastRegion);
+    else if (!region.empty())
+        description << ", in " << region;
+    return description.str();
+}
+
+std::vector<std::string> GoldenManifest::compare(const GoldenManifest& expected, const std::vector<GoldenArtifact>& artifacts, const fs::path& referenceDir) const
+{
+    std::vector<std::string> changed (artifacts.size());
+    parallelFor(artifacts.size(), [&](size_t i)
+    {
+        const GoldenArtifact& artifact = artifacts[i];
+        auto wanted = expected.entries.find(artifact.name);
+        const Entry& got = entries.at(artifact.name);
+        if (wanted == expected.entries.end() || (wanted->second.size == got.size && wanted->second.crc == got.crc))
+            return;
+
+        const Entry& want = wanted->second;
+        const size_t common = std::min(want.size, got.size);
+        std::string sizes;
+        if (want.size != got.size)
+            sizes = " (" + std::to_string(got.size) + " bytes instead of " + std::to_string(want.size) + ")";
+
+        // Exact, if the expected file is still around.
+        std::vector<uint8_t> reference;
+        const fs::path referenceFile = referenceDir / artifact.name;
+        if (fs::exists(referenceFile))
+            readBinaryFile(referenceFile, reference);
+        if (reference.size() == want.size && crc32(reference.data(), reference.size()) == want.crc)
+        {
+            auto mismatch = std::mismatch(reference.begin(), reference.begin() + common, artifact.data.begin());
+            const size_t offset = mismatch.first - reference.begin();
+            changed[i] = _describe(artifact, offset, offset + 1) + sizes;
+            return;
+        }
+
+        // Down to a block otherwise.
+        for (size_t block = 0; block * want.blockSize < common; block++)
+        {
+            const size_t offset = block * want.blockSize;
+            const size_t length = std::min(want.blockSize, want.size - offset);
+            if (block >= want.blocks.size() || offset + length > got.size || crc32(artifact.data.data() + offset, length) != want.blocks[block])
+            {
+                changed[i] = _describe(artifact, offset, std::min(offset + length, common)) + sizes;
+                return;
+            }
+        }
+        changed[i] = _describe(artifact, common, common + 1) + sizes;
+    });
+
+    std::vector<std::string> differences;
+    for (std::string& difference : changed)
+        if (!difference.empty())
+            differences.push_back(std::move(difference));
+
+    for (const auto& [name, entry] : expected.entries)
+        if (entries.count(name) == 0)
+            differences.push_back(name + ": missing");
+    for (const auto& [name, entry] : entries)
+        if (expected.entries.count(name) == 0)
+            differences.push_back(name + ": not in the manifest");
+    return differences;
+}
+
+void GoldenManifest::saveReferences(const std::vector<GoldenArtifact>& artifacts, const fs::path& referenceDir)
+{
+    for (const GoldenArtifact& artifact : artifacts)
+    {
+        const fs::path referenceFile = referenceDir / artifact.name;
+        fs::create_directories(referenceFile.parent_path());
+        std::vector<uint8_t> data = artifact.data;
+        writeBinaryFile(referenceFile, data);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace AddMusic
+{
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief A file produced by a build, with named regions to tell where in it
+ * a difference is (e.g. the channels of a song).
+ */
+struct GoldenArtifact
+{
+    std::string name;                           // Unique path-like name, used as the manifest key.
+    std::string source;                         // What it was built from, e.g. the MML file of a song.
+    std::vector<uint8_t> data;
+    std::map<size_t, std::string> regions;      // Region names by start offset.
+
+    /**
+     * @brief Name of the region offset falls in, or an empty string.
+     */
+    std::string regionAt(size_t offset) const;
+};
+
+/**
+ * @brief Size, CRC-32 and block CRC-32s of every artifact of a build. Block
+ * CRCs locate a difference even when no copy of the expected file is around.
+ *
+ * Manifests are plain text, one artifact per line, sorted by name, so they
+ * can be checked in and diffed.
+ */
+class GoldenManifest
+{
+public:
+    static constexpr size_t MAX_BLOCKS {64};            // Per artifact. Blocks are a power of two, 64 bytes at least.
+
+    /**
+     * @brief Hashes every artifact, in parallel.
+     */
+    static GoldenManifest hash(const std::vector<GoldenArtifact>& artifacts);
+
+    /**
+     * @brief Returns false if the file doesn't exist.
+     */
+    bool load(const fs::path& manifestFile);
+    void save(const fs::path& manifestFile) const;
+
+    /**
+     * @brief Describes every way this manifest differs from expected, in
+     * order: changed, missing and new artifacts. A changed artifact is
+     * located down to the byte if referenceDir holds the copy expected was
+     * made from, and down to a block otherwise.
+     */
+    std::vector<std::string> compare(const GoldenManifest& expected, const std::vector<GoldenArtifact>& artifacts, const fs::path& referenceDir) const;
+
+    /**
+     * @brief Stores a copy of every artifact under referenceDir, for
+     * compare() to locate differences exactly later on.
+     */
+    static void saveReferences(const std::vector<GoldenArtifact>& artifacts, const fs::path& referenceDir);
+
+private:
+    struct Entry
+    {
+        size_t size {0};
+        uint32_t crc {0};
+        size_t blockSize {0};
+        std::vector<uint32_t> blocks;
+    };
+
+    static Entry _hash(const std::vector<uint8_t>& data);
+    static std::string _describe(const GoldenArtifact& artifact, size_t offset, size_t end);
+
+    std::map<std::string, Entry> entries;
+};
+
+}
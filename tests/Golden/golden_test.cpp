@@ -0,0 +1,255 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <filesystem>
+
+#include "GoldenManifest.h"
+#include "ROMEnvironment.h"
+#include "SPCEnvironment.h"
+#include "SyntheticCorpus.h"
+#include "SyntheticROM.h"
+#include "Utility.h"
+
+// Byte-exact regression tests: builds a synthetic corpus, hashes everything
+// the build produces and compares it against the manifests checked in next to
+// this file. Set AMK_GOLDEN_UPDATE=1 (or build the update_golden target) to
+// record new manifests after an intended change of the output.
+
+using namespace AddMusic;
+namespace fs = std::filesystem;
+
+const fs::path MANIFEST_DIR {GOLDEN_MANIFEST_DIR};
+const fs::path GOLDEN_WORKDIR {"golden_env"};
+const fs::path GOLDEN_OUTPUT_DIR {"golden_output"};
+const fs::path REFERENCE_DIR {"golden_reference"};
+
+const CorpusOptions GOLDEN_CORPUS {1, 24, 0};
+const ROMOptions GOLDEN_ROM {1, 4, false, false, ROMState::Clean, 50};
+
+// Where the date is stored in an SPC, which changes every day.
+constexpr size_t SPC_DATE_OFFSET {0x9E};
+constexpr size_t SPC_DATE_LENGTH {10};
+
+static bool updating()
+{
+    const char* update = std::getenv("AMK_GOLDEN_UPDATE");
+    return update && *update && std::string(update) != "0";
+}
+
+static std::vector<fs::path> goldenSongs()
+{
+    std::vector<fs::path> songs = SyntheticCorpus(GOLDEN_CORPUS).writeWorkDir(GOLDEN_WORKDIR);
+    for (fs::path& song : songs)
+        song = fs::absolute(song);
+    return songs;
+}
+
+/**
+ * Names the parts of a song (pointers, instruments, channels and loops)
+ * placed at base in an artifact.
+ */
+static void addSongRegions(GoldenArtifact& artifact, const CompiledSong& song, size_t base, const std::string& prefix = "")
+{
+    artifact.regions[base] = prefix + "phrase list";
+    for (const auto& [symbol, offset] : song.object.symbols)
+        artifact.regions[base + offset] = prefix + symbol;
+    artifact.regions.emplace(base + song.object.code.size(), "");
+}
+
+/**
+ * Compares the artifacts of a build against a manifest, or records the
+ * manifest when updating. References are refreshed whenever the build matches, so that the
+ * next difference can be located down to the byte.
+ */
+static void checkAgainstManifest(const std::string& name, const std::vector<GoldenArtifact>& artifacts)
+{
+    const fs::path manifestFile = MANIFEST_DIR / (name + ".manifest");
+    const fs::path referenceDir = REFERENCE_DIR / name;
+
+    GoldenManifest actual = GoldenManifest::hash(artifacts);
+    if (updating())
+    {
+        actual.save(manifestFile);
+        GoldenManifest::saveReferences(artifacts, referenceDir);
+        return;
+    }
+
+    // A missing manifest is a failure: otherwise a fresh checkout could never fail.
+    GoldenManifest expected;
+    INFO("Record " + manifestFile.string() + " with AMK_GOLDEN_UPDATE=1 (the update_golden target) and check it in.");
+    REQUIRE(expected.load(manifestFile));
+
+    std::vector<std::string> differences = actual.compare(expected, artifacts, referenceDir);
+    for (const std::string& difference : differences)
+        FAIL_CHECK(difference);
+    if (differences.empty())
+        GoldenManifest::saveReferences(artifacts, referenceDir);
+}
+
+/**
+ * Runs the steps of SPCEnvironment::generateSPCFiles() in-process, rendering
+ * the SPCs into memory on every core instead of writing them.
+ */
+class GoldenSPCEnvironment : public SPCEnvironment
+{
+public:
+    using SPCEnvironment::SPCEnvironment;
+
+    std::vector<GoldenArtifact> build(const std::vector<fs::path>& localSongs)
+    {
+        options.sfxDump = true;
+        _prepareBuild(localSongs, GOLDEN_OUTPUT_DIR);
+
+        REQUIRE(_compileMusic());
+        REQUIRE(_fixMusicPointers());
+
+        std::vector<GoldenArtifact> artifacts;
+        artifacts.push_back(_binArtifact("main.bin"));
+        for (int i = 0; i < 256; i++)
+        {
+            if (!musics[i].exists)
+                continue;
+            artifacts.push_back(_binArtifact("music" + hex<2>(i) + ".bin"));
+            artifacts.back().source = musics[i].name.filename().string();
+            addSongRegions(artifacts.back(), musics[i], i > highestGlobalSong ? 12 : 0);
+        }
+
+        _buildSPCTemplate();
+        std::vector<SPCDumpJob> jobs = _planSPCDumps();
+        std::vector<GoldenArtifact> spcs (jobs.size());
+
+        std::atomic<size_t> nextJob {0};
+        std::exception_ptr workerError;
+        std::mutex errorMutex;
+        auto worker = [&]()
+        {
+            try
+            {
+                _renderJobs(jobs, spcs, nextJob);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!workerError)
+                    workerError = std::current_exception();
+                nextJob = jobs.size();
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < std::max(1u, std::thread::hardware_concurrency()); t++)
+            workers.emplace_back(worker);
+        for (std::thread& t : workers)
+            t.join();
+        if (workerError)
+            std::rethrow_exception(workerError);
+
+        artifacts.insert(artifacts.end(), std::make_move_iterator(spcs.begin()), std::make_move_iterator(spcs.end()));
+        return artifacts;
+    }
+
+private:
+    GoldenArtifact _binArtifact(const std::string& filename) const
+    {
+        GoldenArtifact artifact;
+        artifact.name = filename;
+        readBinaryFile(driver_builddir / "SNES" / "bin" / filename, artifact.data);
+        return artifact;
+    }
+
+    void _renderJobs(const std::vector<SPCDumpJob>& jobs, std::vector<GoldenArtifact>& spcs, std::atomic<size_t>& nextJob) const
+    {
+        for (size_t j = nextJob++; j < jobs.size(); j = nextJob++)
+        {
+            GoldenArtifact& spc = spcs[j];
+            spc.name = "spc/" + jobs[j].filename.lexically_relative(spc_output_dir).generic_string();
+            spc.data.resize(SPC_FILE_SIZE);
+            _renderSPC(jobs[j], spc.data);
+            std::fill_n(spc.data.begin() + SPC_DATE_OFFSET, SPC_DATE_LENGTH, 0);
+
+            const CompiledSong& song = musics[jobs[j].songIndex];
+            spc.source = song.name.filename().string();
+            spc.regions[0] = "SPC header";
+            spc.regions[0x100] = "ARAM";
+            if (jobs[j].mode == 0)
+                addSongRegions(spc, song, 0x100 + spcSongDataPos, "song data: ");
+            spc.regions[0x10100] = "DSP registers";
+            spc.regions[0x10180] = "extra RAM";
+        }
+    }
+};
+
+/**
+ * Patches a synthetic ROM in-process and keeps what ROMEnvironment::patchROM()
+ * leaves behind.
+ */
+class GoldenROMEnvironment : public ROMEnvironment
+{
+public:
+    using ROMEnvironment::ROMEnvironment;
+
+    std::vector<GoldenArtifact> build()
+    {
+        const fs::path patchedROM = GOLDEN_OUTPUT_DIR / "patched.sfc";
+        fs::create_directories(GOLDEN_OUTPUT_DIR);
+        REQUIRE(patchROM(patchedROM));
+
+        std::vector<GoldenArtifact> artifacts (1);
+        artifacts[0].name = "rom/patched.sfc";
+        readBinaryFile(patchedROM, artifacts[0].data);
+
+        // Tell where every song and sample ended up from the final patch.
+        std::string patch;
+        readTextFile(driver_builddir / "SNES" / "temppatch.asm", patch);
+        const std::regex incbin (R"(org \$([0-9A-Fa-f]{6})\n(music|brr)([0-9A-Fa-f]{2}): incbin \"([^\"]+)\")");
+        for (std::sregex_iterator match (patch.begin(), patch.end(), incbin), end; match != end; ++match)
+        {
+            const size_t start = SNESToPC(std::stoi((*match)[1].str(), nullptr, 16));
+            const size_t size = fs::file_size(driver_builddir / "SNES" / (*match)[4].str());
+            artifacts[0].regions.emplace(start + size, "");
+            artifacts[0].regions[start] = ((*match)[2] == "music" ? "song $" : "sample $") + (*match)[3].str();
+        }
+
+        for (int i = 0; i < 256; i++)
+        {
+            if (!musics[i].exists)
+                continue;
+            artifacts.emplace_back();
+            artifacts.back().name = "rom/music" + hex<2>(i) + ".bin";
+            artifacts.back().source = musics[i].name.filename().string();
+            readBinaryFile(driver_builddir / "SNES" / "bin" / ("music" + hex<2>(i) + ".bin"), artifacts.back().data);
+            addSongRegions(artifacts.back(), musics[i], i > highestGlobalSong ? 12 : 0);
+        }
+        return artifacts;
+    }
+};
+
+TEST_CASE("Golden output of an SPC build", "[golden][spc]")
+{
+    EnvironmentOptions opts;
+    opts.verbose = false;
+
+    const std::vector<fs::path> songs = goldenSongs();
+    GoldenSPCEnvironment spc (GOLDEN_WORKDIR, opts);
+    checkAgainstManifest("spc", spc.build(songs));
+}
+
+TEST_CASE("Golden output of a ROM build", "[golden][rom]")
+{
+    EnvironmentOptions opts;
+    opts.verbose = false;
+
+    goldenSongs();
+    const fs::path romFile = GOLDEN_OUTPUT_DIR / "synthetic.sfc";
+    fs::create_directories(GOLDEN_OUTPUT_DIR);
+    SyntheticROM(GOLDEN_ROM).write(romFile);
+
+    GoldenROMEnvironment rom (romFile, GOLDEN_WORKDIR, opts);
+    checkAgainstManifest("rom", rom.build());
+}